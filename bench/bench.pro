@@ -0,0 +1,45 @@
+# This file is part of the particle tracking software CorrTrack.
+#
+# Copyright 2019 Nicolas Bruot and CNRS
+#
+#
+# CorrTrack is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# CorrTrack is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+
+
+# Benchmarks of the computation code, used to tune the choices between the
+# correlation methods and kernels, and to compare the localization methods.
+# Build and run them with
+#
+#   qmake bench.pro && make && ./corrtrack_bench [benchmark...]
+#
+# The program runs the named benchmarks, or all of them, and prints their
+# timings with the kernels of each instruction set supported by the CPU.
+
+
+TEMPLATE = app
+TARGET = corrtrack_bench
+
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../corrtrack.pri)
+
+SOURCES += \
+    main.cpp \
+    sparsebench.cpp \
+    localizerbench.cpp \
+    rowkernelbench.cpp
+
+HEADERS += \
+    bench.h
@@ -0,0 +1,124 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "bench.h"
+#include "math/centroidlocalizer.h"
+#include "math/correlationkernels.h"
+#include "math/radialsymmetrylocalizer.h"
+#include "movie/movie.h"
+
+
+namespace
+{
+    const unsigned int FRAME_SIZE = 200;
+    const unsigned int WINDOW_SIZES[] = {15, 31, 63};
+    // Size of the filter of the reference correlation
+    const unsigned int FILTER_SIZE = 9;
+    // Centre of the particle
+    const double PARTICLE_X = 100.3;
+    const double PARTICLE_Y = 99.8;
+
+    void loadParticle(Movie &movie, const unsigned int bitDepth)
+    {
+        // Single frame with a Gaussian particle on a uniform background
+        movie.bitsPerSample = bitDepth;
+        movie.bitDepth = bitDepth;
+        movie.width = FRAME_SIZE;
+        movie.height = FRAME_SIZE;
+        movie.nFrames = 1;
+        const double scale = bitDepth == 8 ? 1.0 : 50.0;
+        std::vector<uint16_t> pixels((size_t) FRAME_SIZE * FRAME_SIZE);
+        for (unsigned int j = 0; j < FRAME_SIZE; j++)
+        {
+            for (unsigned int i = 0; i < FRAME_SIZE; i++)
+            {
+                const double dx = i - PARTICLE_X;
+                const double dy = j - PARTICLE_Y;
+                pixels[j * FRAME_SIZE + i] = (uint16_t) (scale * (10.0 + 200.0 * std::exp(-(dx * dx + dy * dy) / 6.0)));
+            }
+        }
+        if (bitDepth == 8)
+        {
+            const std::vector<uint8_t> pixels8(pixels.begin(), pixels.end());
+            movie.frames8 = std::vector<Frame<uint8_t>>(1);
+            movie.frames8[0].load(pixels8.data(), FRAME_SIZE, FRAME_SIZE, 0);
+        }
+        else
+        {
+            movie.frames16 = std::vector<Frame<uint16_t>>(1);
+            movie.frames16[0].load(pixels.data(), FRAME_SIZE, FRAME_SIZE, 0);
+        }
+    }
+}
+
+
+void benchLocalizers()
+{
+    // Time per window of the centroid and radial symmetry localizers, and
+    // their error on a Gaussian particle.  For reference, the time of the
+    // direct correlation of the window with a 9 x 9 filter by the row
+    // kernels, which the correlation localizer needs before its peak fit.
+    for (const unsigned int bitDepth : {8u, 16u})
+    {
+        Movie movie;
+        loadParticle(movie, bitDepth);
+        CentroidLocalizer centroid(&movie);
+        RadialSymmetryLocalizer radialSymmetry(&movie);
+        const Point centre((unsigned int) (PARTICLE_X + 0.5),
+                           (unsigned int) (PARTICLE_Y + 0.5));
+        for (const unsigned int windowSize : WINDOW_SIZES)
+        {
+            std::printf("%2u-bit, window %2u:", bitDepth, windowSize);
+            for (Localizer * const localizer : {(Localizer*) &centroid,
+                                                (Localizer*) &radialSymmetry})
+            {
+                PointD position;
+                const double time = timePerCall([&]()
+                {
+                    position = localizer->locate(centre, 0, windowSize, windowSize);
+                });
+                std::printf("  %s %6.0f ns (error %.4f px)",
+                            localizer == &centroid ? "centroid" : "radial symmetry",
+                            time * 1e9,
+                            std::hypot(position.x - PARTICLE_X, position.y - PARTICLE_Y));
+            }
+
+            const unsigned int patchSize = windowSize + FILTER_SIZE - 1;
+            const std::vector<double> patch((size_t) patchSize * patchSize, 1.0);
+            const std::vector<double> filter((size_t) FILTER_SIZE * FILTER_SIZE, 0.5);
+            std::vector<double> map((size_t) windowSize * windowSize);
+            const kernels::CorrelationRowKernel correlationRow
+                = kernels::correlationRowKernel(kernels::instructionSet, FILTER_SIZE);
+            const double time = timePerCall([&]()
+            {
+                for (unsigned int j = 0; j < windowSize; j++)
+                    correlationRow(patch.data() + (size_t) j * patchSize, patchSize,
+                                   filter.data(), FILTER_SIZE, FILTER_SIZE,
+                                   windowSize, map.data() + (size_t) j * windowSize);
+            });
+            std::printf("  correlation %6.0f ns\n", time * 1e9);
+        }
+    }
+}
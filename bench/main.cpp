@@ -0,0 +1,118 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <boost/filesystem.hpp>
+#include "bench.h"
+#include "math/correlationkernels.h"
+
+
+namespace
+{
+    // Minimum duration of each run of timePerCall(), in seconds
+    const double MIN_RUN_TIME = 0.02;
+
+    // Number of runs of timePerCall()
+    const unsigned int N_RUNS = 3;
+
+    struct Benchmark
+    {
+        const char *name;
+        void (*run)();
+    };
+
+    const Benchmark BENCHMARKS[] = {
+        {"sparse", benchSparse},
+        {"localizers", benchLocalizers},
+        {"rowkernels", benchRowKernels},
+    };
+}
+
+
+double timePerCall(const std::function<void()> &function)
+{
+    // The number of calls per run is doubled until a run lasts long enough.
+    function();
+    size_t nCalls = 1;
+    double best = HUGE_VAL;
+    for (unsigned int run = 0; run < N_RUNS; run++)
+    {
+        while (true)
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < nCalls; i++)
+                function();
+            const double duration = std::chrono::duration<double>(
+                                        std::chrono::steady_clock::now() - start).count();
+            if (duration >= MIN_RUN_TIME)
+            {
+                best = std::min(best, duration / nCalls);
+                break;
+            }
+            nCalls *= 2;
+        }
+    }
+    return best;
+}
+
+std::string writeFilterFile(const std::vector<double> &filter,
+                            const unsigned int width,
+                            const unsigned int height)
+{
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path()
+                                         / boost::filesystem::unique_path("corrtrack-%%%%-%%%%.dat");
+    std::ofstream file(path.string());
+    file << std::setprecision(17);
+    for (unsigned int y = 0; y < height; y++)
+    {
+        for (unsigned int x = 0; x < width; x++)
+        {
+            file << filter[y * width + x];
+            if (x + 1 < width)
+                file << "\t";
+        }
+        file << "\n";
+    }
+    return path.string();
+}
+
+int main(int argc, char *argv[])
+{
+    std::printf("Best instruction set: %s\n\n",
+                kernels::instructionSetName(kernels::instructionSet));
+    for (const Benchmark &benchmark : BENCHMARKS)
+    {
+        bool isSelected = argc == 1;
+        for (int i = 1; i < argc; i++)
+            isSelected = isSelected || std::strcmp(argv[i], benchmark.name) == 0;
+        if (!isSelected)
+            continue;
+        std::printf("Benchmark %s\n", benchmark.name);
+        benchmark.run();
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "math/correlationkernels.h"
+
+
+namespace
+{
+    const unsigned int MIN_FILTER_WIDTH = 5;
+    const unsigned int MAX_FILTER_WIDTH = 41;
+    const unsigned int WINDOW_SIZE = 41;
+}
+
+
+void benchRowKernels()
+{
+    // Time of the correlation of a window by the row kernel selected for
+    // each odd filter width, kernels::correlationRowKernel(set, width),
+    // relative to the generic kernel of the same instruction set.  The
+    // widths above kernels::MAX_SPECIALIZED_WIDTH select the generic kernel,
+    // so that their ratio is 1.  The cut-off was chosen by raising
+    // MAX_SPECIALIZED_WIDTH to 41, with SPECIALIZED_KERNELS and
+    // UNROLL_FILTER_ROW extended to match, and running this benchmark: the
+    // wider specialized kernels were no faster than the generic ones.
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    for (int set = 0; set <= (int) kernels::instructionSet; set++)
+    {
+        const kernels::InstructionSet instructionSet = (kernels::InstructionSet) set;
+        std::printf("%s kernels, %u x %u window, specialized / generic time:\n",
+                    kernels::instructionSetName(instructionSet), WINDOW_SIZE, WINDOW_SIZE);
+        const kernels::CorrelationRowKernel genericRow
+            = kernels::correlationRowKernel(instructionSet);
+        for (unsigned int filterWidth = MIN_FILTER_WIDTH; filterWidth <= MAX_FILTER_WIDTH;
+             filterWidth += 2)
+        {
+            const kernels::CorrelationRowKernel specializedRow
+                = kernels::correlationRowKernel(instructionSet, filterWidth);
+            const unsigned int patchSize = WINDOW_SIZE + filterWidth - 1;
+            std::vector<double> patch((size_t) patchSize * patchSize);
+            for (double &value : patch)
+                value = distribution(generator);
+            std::vector<double> filter((size_t) filterWidth * filterWidth);
+            for (double &value : filter)
+                value = distribution(generator);
+            std::vector<double> map((size_t) WINDOW_SIZE * WINDOW_SIZE);
+
+            const auto correlate = [&](const kernels::CorrelationRowKernel row)
+            {
+                for (unsigned int j = 0; j < WINDOW_SIZE; j++)
+                    row(patch.data() + (size_t) j * patchSize, patchSize,
+                        filter.data(), filterWidth, filterWidth,
+                        WINDOW_SIZE, map.data() + (size_t) j * WINDOW_SIZE);
+            };
+            const double specializedTime = timePerCall([&]() { correlate(specializedRow); });
+            const double genericTime = timePerCall([&]() { correlate(genericRow); });
+            std::printf("  filter %2u: %8.1f us / %8.1f us = %4.2f%s\n",
+                        filterWidth, specializedTime * 1e6, genericTime * 1e6,
+                        specializedTime / genericTime,
+                        specializedRow == genericRow ? " (generic)" : "");
+        }
+    }
+}
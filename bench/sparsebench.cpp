@@ -0,0 +1,176 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "bench.h"
+#include "math/corrfilter.h"
+#include "math/correlationkernels.h"
+
+
+namespace
+{
+    const unsigned int FILTER_SIZES[] = {11, 21, 31};
+    const unsigned int WINDOW_SIZES[] = {15, 41};
+    const unsigned int N_DENSITIES = 10;
+
+    std::vector<double> sparseFilter(const unsigned int size, const bool isRing,
+                                     const double density, std::mt19937 &generator)
+    {
+        // size x size filter with random positive coefficients at the given
+        // fraction of the positions, and zeros elsewhere.  The coefficients
+        // are either those closest to a ring of radius size / 3, or scattered
+        // at random.
+        const size_t n = (size_t) size * size;
+        std::uniform_real_distribution<double> distribution(0.0, 1.0);
+        std::vector<double> keys(n);
+        const double centre = 0.5 * (size - 1);
+        for (size_t i = 0; i < n; i++)
+        {
+            const double r = std::hypot((double) (i % size) - centre,
+                                        (double) (i / size) - centre);
+            keys[i] = isRing ? std::fabs(r - size / 3.0) : distribution(generator);
+        }
+        std::vector<size_t> order(n);
+        std::iota(order.begin(), order.end(), (size_t) 0);
+        std::sort(order.begin(), order.end(),
+                  [&keys](const size_t a, const size_t b) { return keys[a] < keys[b]; });
+        std::vector<double> filter(n, 0.0);
+        const size_t nKept = (size_t) std::lround(density * n);
+        for (size_t k = 0; k < nKept; k++)
+            filter[order[k]] = 1.0 + distribution(generator);
+        return filter;
+    }
+}
+
+
+void benchSparse()
+{
+    // Time of the correlation of a window by the sparse row kernels relative
+    // to the dense ones of the same instruction set, for filters of
+    // increasing density (fraction of non-zero coefficients), and the
+    // density at which they cost the same.  The relative time is then fitted
+    // as a cost per coefficient kept and per run of coefficients, the
+    // SPARSE_COEFFICIENT_COST and SPARSE_RUN_COST of the analyser (as
+    // fractions of the cost of the full filter).
+    std::mt19937 generator(1);
+    for (int set = 0; set <= (int) kernels::instructionSet; set++)
+    {
+        const kernels::InstructionSet instructionSet = (kernels::InstructionSet) set;
+        std::printf("%s kernels, sparse / dense time at densities 0.1 to 1:\n",
+                    kernels::instructionSetName(instructionSet));
+        const kernels::SparseCorrelationRowKernel sparseRow
+            = kernels::sparseCorrelationRowKernel(instructionSet);
+        // Normal equations of the least-squares fit of the relative time by
+        // coefficientCost * density + runCost * runs / coefficients
+        double sumDensity2 = 0.0;
+        double sumDensityRuns = 0.0;
+        double sumRuns2 = 0.0;
+        double sumDensityRatio = 0.0;
+        double sumRunsRatio = 0.0;
+        for (const unsigned int filterSize : FILTER_SIZES)
+        {
+            const kernels::CorrelationRowKernel denseRow
+                = kernels::correlationRowKernel(instructionSet, filterSize);
+            for (const unsigned int windowSize : WINDOW_SIZES)
+            {
+                const unsigned int patchSize = windowSize + filterSize - 1;
+                std::uniform_real_distribution<double> distribution(0.0, 1.0);
+                std::vector<double> patch((size_t) patchSize * patchSize);
+                for (double &value : patch)
+                    value = distribution(generator);
+                std::vector<double> map((size_t) windowSize * windowSize);
+
+                for (const bool isRing : {true, false})
+                {
+                    std::printf("  filter %2u, window %2u, %-9s",
+                                filterSize, windowSize, isRing ? "ring" : "scattered");
+                    double previousDensity = 0.0;
+                    double previousRatio = 0.0;
+                    double crossover = HUGE_VAL;
+                    for (unsigned int d = 1; d <= N_DENSITIES; d++)
+                    {
+                        const double density = (double) d / N_DENSITIES;
+                        const std::vector<double> values = sparseFilter(filterSize, isRing,
+                                                                        density, generator);
+                        CorrFilter filter;
+                        const std::string filterFile = writeFilterFile(values, filterSize,
+                                                                       filterSize);
+                        filter.setFilter(filterFile);
+                        boost::filesystem::remove(filterFile);
+                        std::vector<kernels::FilterRun> runs;
+                        std::vector<double> weights;
+                        filter.sparseRuns(0.0, runs, weights);
+
+                        const double denseTime = timePerCall([&]()
+                        {
+                            for (unsigned int j = 0; j < windowSize; j++)
+                                denseRow(patch.data() + (size_t) j * patchSize, patchSize,
+                                         filter.filter, filterSize, filterSize,
+                                         windowSize, map.data() + (size_t) j * windowSize);
+                        });
+                        const double sparseTime = timePerCall([&]()
+                        {
+                            for (unsigned int j = 0; j < windowSize; j++)
+                                sparseRow(patch.data() + (size_t) j * patchSize, patchSize,
+                                          runs.data(), (unsigned int) runs.size(),
+                                          weights.data(),
+                                          windowSize, map.data() + (size_t) j * windowSize);
+                        });
+                        const double ratio = sparseTime / denseTime;
+                        std::printf(" %4.2f", ratio);
+                        // Linear interpolation of the first crossing
+                        if (ratio >= 1.0 && crossover == HUGE_VAL)
+                            crossover = previousDensity + (1.0 - previousRatio)
+                                                          * (density - previousDensity)
+                                                          / (ratio - previousRatio);
+                        previousDensity = density;
+                        previousRatio = ratio;
+
+                        const double runFraction = (double) runs.size() / values.size();
+                        sumDensity2 += density * density;
+                        sumDensityRuns += density * runFraction;
+                        sumRuns2 += runFraction * runFraction;
+                        sumDensityRatio += density * ratio;
+                        sumRunsRatio += runFraction * ratio;
+                    }
+                    if (crossover == HUGE_VAL)
+                        std::printf("  crossover above 1\n");
+                    else
+                        std::printf("  crossover %.2f\n", crossover);
+                }
+            }
+        }
+        const double determinant = sumDensity2 * sumRuns2 - sumDensityRuns * sumDensityRuns;
+        const double coefficientCost = (sumRuns2 * sumDensityRatio
+                                        - sumDensityRuns * sumRunsRatio) / determinant;
+        const double runCost = (sumDensity2 * sumRunsRatio
+                                - sumDensityRuns * sumDensityRatio) / determinant;
+        std::printf("  fitted cost: %.2f per coefficient, %.2f per run\n",
+                    coefficientCost, runCost);
+    }
+}
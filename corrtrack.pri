@@ -0,0 +1,140 @@
+# This file is part of the particle tracking software CorrTrack.
+#
+# Copyright 2019 Nicolas Bruot and CNRS
+#
+#
+# CorrTrack is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# CorrTrack is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+
+
+# Build settings and sources shared by the application, the tests and the
+# benchmarks: everything but the user interface.
+
+
+INCLUDEPATH += $$PWD/src
+
+unix:INCLUDEPATH += \
+    /usr/include/boost \
+    /usr/include/gsl
+
+unix:LIBS += \
+    -lboost_regex \
+    -lboost_filesystem \
+    -lboost_system \
+    -lgsl \
+    -lgslcblas \
+    -ltiff
+
+contains(QT_ARCH, i386) {
+    unix:INCLUDEPATH += \
+        /usr/include/i386-linux-gnu/
+    unix:LIBS += -L/usr/lib/i386-linux-gnu
+
+    win32:INCLUDEPATH += \
+        C:\lib\msvc2015_32\include
+    win32:LIBS += \
+        C:\lib\msvc2015_32\lib\gsl\cblas.lib \
+        C:\lib\msvc2015_32\lib\gsl\gsl.lib \
+        C:\lib\msvc2015_32\lib\boost\libboost_regex-vc140-mt-1_64.lib \
+        C:\lib\msvc2015_32\lib\boost\libboost_system-vc140-mt-1_64.lib \
+        C:\lib\msvc2015_32\lib\boost\libboost_filesystem-vc140-mt-1_64.lib \
+        C:\lib\msvc2015_32\lib\tiff\tiff.lib
+} else {
+    unix:INCLUDEPATH += \
+        /usr/include/x86_64-linux-gnu/
+    unix:LIBS += -L/usr/lib/x86_64-linux-gnu
+
+    win32:INCLUDEPATH += \
+        C:\lib\msvc2015_64\include
+    win32:LIBS += \
+        C:\lib\msvc2015_64\lib\gsl\cblas.lib \
+        C:\lib\msvc2015_64\lib\gsl\gsl.lib \
+        C:\lib\msvc2015_64\lib\boost\libboost_regex-vc140-mt-1_64.lib \
+        C:\lib\msvc2015_64\lib\boost\libboost_system-vc140-mt-1_64.lib \
+        C:\lib\msvc2015_64\lib\boost\libboost_filesystem-vc140-mt-1_64.lib \
+        C:\lib\msvc2015_64\lib\tiff\tiff.lib
+}
+win32:QMAKE_LFLAGS += /NODEFAULTLIB:libcmt
+
+CONFIG += c++11 thread
+
+CONFIG(release, debug|release) {
+    # See http://stackoverflow.com/a/32807272
+    #
+    # Release variant of Boost binary libraries is compiled with
+    # disabled run-time assertion (NDEBUG is defined).
+    # To align binaries with header-only libraries and other headers
+    # it is possible to define NDEBUG for project release build.
+    # It is not defined in Qt by default.
+    DEFINES += NDEBUG
+}
+
+QT = core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+SOURCES += \
+    $$PWD/src/constants.cpp \
+    $$PWD/src/movie/base/frame.cpp \
+    $$PWD/src/math/math.cpp \
+    $$PWD/src/math/batchcorrelator.cpp \
+    $$PWD/src/math/centroidlocalizer.cpp \
+    $$PWD/src/math/corrfilter.cpp \
+    $$PWD/src/math/correlationkernels.cpp \
+    $$PWD/src/math/driftestimator.cpp \
+    $$PWD/src/math/fft2d.cpp \
+    $$PWD/src/math/fftcorrelator.cpp \
+    $$PWD/src/math/framecorrelator.cpp \
+    $$PWD/src/math/integercorrelator.cpp \
+    $$PWD/src/math/localizer.cpp \
+    $$PWD/src/math/motionpredictor.cpp \
+    $$PWD/src/math/corrtrackanalyser.cpp \
+    $$PWD/src/math/point.cpp \
+    $$PWD/src/math/quadraticfit.cpp \
+    $$PWD/src/math/radialsymmetrylocalizer.cpp \
+    $$PWD/src/math/threadpool.cpp \
+    $$PWD/src/math/upsampleddft.cpp \
+    $$PWD/src/math/imaged.cpp \
+    $$PWD/src/math/pointd.cpp \
+    $$PWD/src/io/exceptions/ioexception.cpp \
+    $$PWD/src/movie/movie.cpp \
+    $$PWD/src/movie/base/version.cpp
+
+HEADERS += \
+    $$PWD/src/constants.h \
+    $$PWD/src/movie/base/frame.h \
+    $$PWD/src/math/math.h \
+    $$PWD/src/math/batchcorrelator.h \
+    $$PWD/src/math/centroidlocalizer.h \
+    $$PWD/src/math/corrfilter.h \
+    $$PWD/src/math/correlationkernels.h \
+    $$PWD/src/math/driftestimator.h \
+    $$PWD/src/math/fft2d.h \
+    $$PWD/src/math/fftcorrelator.h \
+    $$PWD/src/math/framecorrelator.h \
+    $$PWD/src/math/imageview.h \
+    $$PWD/src/math/integercorrelator.h \
+    $$PWD/src/math/localizer.h \
+    $$PWD/src/math/motionpredictor.h \
+    $$PWD/src/math/corrtrackanalyser.h \
+    $$PWD/src/math/point.h \
+    $$PWD/src/math/quadraticfit.h \
+    $$PWD/src/math/radialsymmetrylocalizer.h \
+    $$PWD/src/math/threadpool.h \
+    $$PWD/src/math/upsampleddft.h \
+    $$PWD/src/math/imaged.h \
+    $$PWD/src/math/pointd.h \
+    $$PWD/src/io/exceptions/ioexception.h \
+    $$PWD/src/movie/movie.h \
+    $$PWD/src/movie/base/movieformats.h \
+    $$PWD/src/movie/base/version.h
@@ -31,90 +31,20 @@
 TEMPLATE = app
 TARGET = corrtrack
 
-INCLUDEPATH += src
-
-unix:INCLUDEPATH += \
-    /usr/include/boost \
-    /usr/include/gsl
-
-unix:LIBS += \
-    -lboost_regex \
-    -lboost_filesystem \
-    -lboost_system \
-    -lgsl \
-    -lgslcblas \
-    -ltiff
-
-contains(QT_ARCH, i386) {
-    unix:INCLUDEPATH += \
-        /usr/include/i386-linux-gnu/
-    unix:LIBS += -L/usr/lib/i386-linux-gnu
-
-    win32:INCLUDEPATH += \
-        C:\lib\msvc2015_32\include
-    win32:LIBS += \
-        C:\lib\msvc2015_32\lib\gsl\cblas.lib \
-        C:\lib\msvc2015_32\lib\gsl\gsl.lib \
-        C:\lib\msvc2015_32\lib\boost\libboost_regex-vc140-mt-1_64.lib \
-        C:\lib\msvc2015_32\lib\boost\libboost_system-vc140-mt-1_64.lib \
-        C:\lib\msvc2015_32\lib\boost\libboost_filesystem-vc140-mt-1_64.lib \
-        C:\lib\msvc2015_32\lib\tiff\tiff.lib
-} else {
-    unix:INCLUDEPATH += \
-        /usr/include/x86_64-linux-gnu/
-    unix:LIBS += -L/usr/lib/x86_64-linux-gnu
-
-    win32:INCLUDEPATH += \
-        C:\lib\msvc2015_64\include
-    win32:LIBS += \
-        C:\lib\msvc2015_64\lib\gsl\cblas.lib \
-        C:\lib\msvc2015_64\lib\gsl\gsl.lib \
-        C:\lib\msvc2015_64\lib\boost\libboost_regex-vc140-mt-1_64.lib \
-        C:\lib\msvc2015_64\lib\boost\libboost_system-vc140-mt-1_64.lib \
-        C:\lib\msvc2015_64\lib\boost\libboost_filesystem-vc140-mt-1_64.lib \
-        C:\lib\msvc2015_64\lib\tiff\tiff.lib
-}
-win32:QMAKE_LFLAGS += /NODEFAULTLIB:libcmt
+include(corrtrack.pri)
 
 win32:RC_ICONS += icon.ico
 
-CONFIG += c++11
-
-CONFIG(release, debug|release) {
-    # See http://stackoverflow.com/a/32807272
-    #
-    # Release variant of Boost binary libraries is compiled with
-    # disabled run-time assertion (NDEBUG is defined).
-    # To align binaries with header-only libraries and other headers
-    # it is possible to define NDEBUG for project release build.
-    # It is not defined in Qt by default.
-    DEFINES += NDEBUG
-}
-
-QT = core gui
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
 VPATH += src
 
 SOURCES += \
     main.cpp \
     corrtrackwindow.cpp \
-    constants.cpp \
     settings.cpp \
     zoomdialog.cpp \
     corrfilterdialog.cpp \
     settingsdialog.cpp \
     okcanceldialog.cpp \
-    movie/base/frame.cpp \
-    math/math.cpp \
-    math/corrfilter.cpp \
-    math/corrtrackanalyser.cpp \
-    math/point.cpp \
-    math/imaged.cpp \
-    math/pointd.cpp \
-    io/exceptions/ioexception.cpp \
-    movie/movie.cpp \
     movieintensityminmaxworker.cpp \
     nomenuiconsstyle.cpp \
     noscrollqgraphicsview.cpp \
@@ -122,26 +52,15 @@ SOURCES += \
     progresswindow.cpp \
     extracttiffsworker.cpp \
     openmovieworker.cpp \
-    intensitydialog.cpp \
-    movie/base/version.cpp
+    intensitydialog.cpp
 
 HEADERS += \
     corrtrackwindow.h \
-    constants.h \
     settings.h \
     zoomdialog.h \
     corrfilterdialog.h \
     settingsdialog.h \
     okcanceldialog.h \
-    movie/base/frame.h \
-    math/math.h \
-    math/corrfilter.h \
-    math/corrtrackanalyser.h \
-    math/point.h \
-    math/imaged.h \
-    math/pointd.h \
-    io/exceptions/ioexception.h \
-    movie/movie.h \
     movieintensityminmaxworker.h \
     nomenuiconsstyle.h \
     noscrollqgraphicsview.h \
@@ -149,9 +68,7 @@ HEADERS += \
     progresswindow.h \
     extracttiffsworker.h \
     openmovieworker.h \
-    intensitydialog.h \
-    movie/base/movieformats.h \
-    movie/base/version.h
+    intensitydialog.h
 
 RESOURCES += \
     resources.qrc
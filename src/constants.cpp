@@ -72,4 +72,16 @@ namespace constants
     const int FILTER_HEIGHT_MAX_VALUE = std::numeric_limits<int>::max();
     const double FILTER_FIT_RADIUS_MAX_VALUE = std::numeric_limits<double>::max();
     const int FILTER_FIT_RADIUS_MAX_DECIMALS = 1000;
+    const int UPSAMPLING_FACTOR_MAX_VALUE = 1000000;
+    const int CHUNK_LENGTH_MAX_VALUE = std::numeric_limits<int>::max();
+    const int PYRAMID_LEVELS_MAX_VALUE = 8;
+    const double SEPARABLE_ENERGY_MAX_VALUE = 1.0;
+    const int SEPARABLE_ENERGY_MAX_DECIMALS = 1000;
+    const double SPARSE_THRESHOLD_MAX_VALUE = 1.0;
+    const int SPARSE_THRESHOLD_MAX_DECIMALS = 1000;
+    const double UNCHANGED_THRESHOLD_MAX_VALUE = 65535.0;
+    const int UNCHANGED_THRESHOLD_MAX_DECIMALS = 1000;
+    const double DETECTION_THRESHOLD_MAX_VALUE = 1.0;
+    const int DETECTION_THRESHOLD_MAX_DECIMALS = 1000;
+    const int DETECTION_RADIUS_MAX_VALUE = std::numeric_limits<int>::max();
 }
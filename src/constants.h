@@ -71,4 +71,16 @@ namespace constants
     extern const int FILTER_HEIGHT_MAX_VALUE;
     extern const double FILTER_FIT_RADIUS_MAX_VALUE;
     extern const int FILTER_FIT_RADIUS_MAX_DECIMALS;
+    extern const int UPSAMPLING_FACTOR_MAX_VALUE;
+    extern const int CHUNK_LENGTH_MAX_VALUE;
+    extern const int PYRAMID_LEVELS_MAX_VALUE;
+    extern const double SEPARABLE_ENERGY_MAX_VALUE;
+    extern const int SEPARABLE_ENERGY_MAX_DECIMALS;
+    extern const double SPARSE_THRESHOLD_MAX_VALUE;
+    extern const int SPARSE_THRESHOLD_MAX_DECIMALS;
+    extern const double UNCHANGED_THRESHOLD_MAX_VALUE;
+    extern const int UNCHANGED_THRESHOLD_MAX_DECIMALS;
+    extern const double DETECTION_THRESHOLD_MAX_VALUE;
+    extern const int DETECTION_THRESHOLD_MAX_DECIMALS;
+    extern const int DETECTION_RADIUS_MAX_VALUE;
 }
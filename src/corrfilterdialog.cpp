@@ -29,22 +29,55 @@
 #include <QMessageBox>
 #include <QString>
 #include <QDoubleValidator>
+#include <QCheckBox>
 #include "corrfilterdialog.h"
 #include "constants.h"
 
 
 CorrFilterDialog::CorrFilterDialog(const unsigned int filterWindowWidth,
                                    const unsigned int filterWindowHeight,
+                                   const bool adaptiveWindows,
                                    const QString filterFile,
                                    const double fitRadius,
+                                   const CorrTrackAnalyser::LocalizationMethod localizationMethod,
+                                   const CorrTrackAnalyser::SubPixelMethod subPixelMethod,
+                                   const unsigned int upsamplingFactor,
+                                   const CorrTrackAnalyser::CorrelationMethod correlationMethod,
+                                   const bool normalizedCorrelation,
+                                   const bool singlePrecision,
+                                   const double separableEnergy,
+                                   const double sparseThreshold,
+                                   const size_t chunkLength,
+                                   const unsigned int pyramidLevels,
+                                   const MotionPredictor::Model motionModel,
+                                   const bool driftCorrection,
+                                   const double unchangedThreshold,
+                                   const double detectionThreshold,
+                                   const unsigned int detectionRadius,
                                    const QString newLastFilterFolder,
                                    const QString newLastFolder,
                                    QWidget *parent)
     : OKCancelDialog(parent),
       filterWindowWidthLE{new QLineEdit(this)},
       filterWindowHeightLE{new QLineEdit(this)},
+      adaptiveWindowsCB{new QCheckBox("Adaptive sizes, up to width and height", this)},
       filterFileLE{new QLineEdit(this)},
       fitRadiusLE{new QLineEdit(this)},
+      localizationMethodCBox{new QComboBox(this)},
+      subPixelMethodCBox{new QComboBox(this)},
+      upsamplingFactorLE{new QLineEdit(this)},
+      correlationMethodCBox{new QComboBox(this)},
+      normalizedCorrelationCB{new QCheckBox("Zero-mean normalized correlation", this)},
+      singlePrecisionCB{new QCheckBox("Single-precision direct correlation", this)},
+      separableEnergyLE{new QLineEdit(this)},
+      sparseThresholdLE{new QLineEdit(this)},
+      chunkLengthLE{new QLineEdit(this)},
+      pyramidLevelsLE{new QLineEdit(this)},
+      motionModelCBox{new QComboBox(this)},
+      driftCorrectionCB{new QCheckBox("Follow the global drift of the frames", this)},
+      unchangedThresholdLE{new QLineEdit(this)},
+      detectionThresholdLE{new QLineEdit(this)},
+      detectionRadiusLE{new QLineEdit(this)},
       lastFilterFolder{newLastFilterFolder},
       lastFolder{newLastFolder}
 {
@@ -63,6 +96,42 @@ CorrFilterDialog::CorrFilterDialog(const unsigned int filterWindowWidth,
                                                                 constants::FILTER_FIT_RADIUS_MAX_DECIMALS,
                                                                 this);
     fitRadiusLE->setValidator(fitRadiusValidator);
+    QIntValidator *upsamplingFactorValidator = new QIntValidator(1,
+                                                                 constants::UPSAMPLING_FACTOR_MAX_VALUE,
+                                                                 this);
+    upsamplingFactorLE->setValidator(upsamplingFactorValidator);
+    QDoubleValidator *separableEnergyValidator = new QDoubleValidator(0.0,
+                                                                      constants::SEPARABLE_ENERGY_MAX_VALUE,
+                                                                      constants::SEPARABLE_ENERGY_MAX_DECIMALS,
+                                                                      this);
+    separableEnergyLE->setValidator(separableEnergyValidator);
+    QDoubleValidator *sparseThresholdValidator = new QDoubleValidator(0.0,
+                                                                      constants::SPARSE_THRESHOLD_MAX_VALUE,
+                                                                      constants::SPARSE_THRESHOLD_MAX_DECIMALS,
+                                                                      this);
+    sparseThresholdLE->setValidator(sparseThresholdValidator);
+    QIntValidator *chunkLengthValidator = new QIntValidator(0,
+                                                            constants::CHUNK_LENGTH_MAX_VALUE,
+                                                            this);
+    chunkLengthLE->setValidator(chunkLengthValidator);
+    QIntValidator *pyramidLevelsValidator = new QIntValidator(0,
+                                                              constants::PYRAMID_LEVELS_MAX_VALUE,
+                                                              this);
+    pyramidLevelsLE->setValidator(pyramidLevelsValidator);
+    QDoubleValidator *unchangedThresholdValidator = new QDoubleValidator(0.0,
+                                                                         constants::UNCHANGED_THRESHOLD_MAX_VALUE,
+                                                                         constants::UNCHANGED_THRESHOLD_MAX_DECIMALS,
+                                                                         this);
+    unchangedThresholdLE->setValidator(unchangedThresholdValidator);
+    QDoubleValidator *detectionThresholdValidator = new QDoubleValidator(0.0,
+                                                                         constants::DETECTION_THRESHOLD_MAX_VALUE,
+                                                                         constants::DETECTION_THRESHOLD_MAX_DECIMALS,
+                                                                         this);
+    detectionThresholdLE->setValidator(detectionThresholdValidator);
+    QIntValidator *detectionRadiusValidator = new QIntValidator(1,
+                                                                constants::DETECTION_RADIUS_MAX_VALUE,
+                                                                this);
+    detectionRadiusLE->setValidator(detectionRadiusValidator);
 
     QLabel *filterWindowLabel = new QLabel("Correlation window");
     QLabel *filterWindowWidthLabel = new QLabel("Width (px)");
@@ -78,6 +147,7 @@ CorrFilterDialog::CorrFilterDialog(const unsigned int filterWindowWidth,
     QHBoxLayout *filterWindowLayout = new QHBoxLayout;
     filterWindowLayout->addLayout(filterLabelsLayout);
     filterWindowLayout->addLayout(filterEditsLayout);
+    adaptiveWindowsCB->setChecked(adaptiveWindows);
 
     QHBoxLayout *filterFileLayout = new QHBoxLayout;
     QLabel *filterFileLabel = new QLabel("Filter file");
@@ -91,22 +161,113 @@ CorrFilterDialog::CorrFilterDialog(const unsigned int filterWindowWidth,
     QVBoxLayout *filterOthersLabelsLayout = new QVBoxLayout;
     QLabel *fitRadiusLabel = new QLabel("Fit radius (px)");
     filterOthersLabelsLayout->addWidget(fitRadiusLabel);
+    QLabel *localizationMethodLabel = new QLabel("Localization");
+    filterOthersLabelsLayout->addWidget(localizationMethodLabel);
+    QLabel *subPixelMethodLabel = new QLabel("Sub-pixel peak");
+    filterOthersLabelsLayout->addWidget(subPixelMethodLabel);
+    QLabel *upsamplingFactorLabel = new QLabel("Upsampling factor (upsampled DFT)");
+    filterOthersLabelsLayout->addWidget(upsamplingFactorLabel);
+    QLabel *correlationMethodLabel = new QLabel("Correlation method");
+    filterOthersLabelsLayout->addWidget(correlationMethodLabel);
+    QLabel *separableEnergyLabel = new QLabel("Separable filter energy (0 = full filter)");
+    filterOthersLabelsLayout->addWidget(separableEnergyLabel);
+    QLabel *sparseThresholdLabel = new QLabel("Sparse filter threshold (fraction of the largest coefficient)");
+    filterOthersLabelsLayout->addWidget(sparseThresholdLabel);
+    QLabel *chunkLengthLabel = new QLabel("Temporal chunks (frames, 0 = off)");
+    filterOthersLabelsLayout->addWidget(chunkLengthLabel);
+    QLabel *pyramidLevelsLabel = new QLabel("Pyramid search levels (0 = off)");
+    filterOthersLabelsLayout->addWidget(pyramidLevelsLabel);
+    QLabel *motionModelLabel = new QLabel("Window centre");
+    filterOthersLabelsLayout->addWidget(motionModelLabel);
+    QLabel *unchangedThresholdLabel = new QLabel("Unchanged window threshold (grey levels, 0 = off)");
+    filterOthersLabelsLayout->addWidget(unchangedThresholdLabel);
+    QLabel *detectionThresholdLabel = new QLabel("Detection threshold (fraction of the highest correlation)");
+    filterOthersLabelsLayout->addWidget(detectionThresholdLabel);
+    QLabel *detectionRadiusLabel = new QLabel("Detection radius (px)");
+    filterOthersLabelsLayout->addWidget(detectionRadiusLabel);
     fitRadiusLE->setText(QString::number(fitRadius));
+    localizationMethodCBox->addItem("Correlation peak",
+                                    (int) CorrTrackAnalyser::LocalizationMethod::Correlation);
+    localizationMethodCBox->addItem("Centroid above the window mean",
+                                    (int) CorrTrackAnalyser::LocalizationMethod::Centroid);
+    localizationMethodCBox->addItem("Radial symmetry centre",
+                                    (int) CorrTrackAnalyser::LocalizationMethod::RadialSymmetry);
+    localizationMethodCBox->setCurrentIndex(localizationMethodCBox->findData((int) localizationMethod));
+    subPixelMethodCBox->addItem("Quadratic fit within the fit radius",
+                                (int) CorrTrackAnalyser::SubPixelMethod::QuadraticFit);
+    subPixelMethodCBox->addItem("3-point parabolic interpolation",
+                                (int) CorrTrackAnalyser::SubPixelMethod::Parabolic);
+    subPixelMethodCBox->addItem("3-point Gaussian interpolation",
+                                (int) CorrTrackAnalyser::SubPixelMethod::Gaussian);
+    subPixelMethodCBox->addItem("Upsampled DFT",
+                                (int) CorrTrackAnalyser::SubPixelMethod::UpsampledDFT);
+    subPixelMethodCBox->setCurrentIndex(subPixelMethodCBox->findData((int) subPixelMethod));
+    upsamplingFactorLE->setText(QString::number(upsamplingFactor));
+    correlationMethodCBox->addItem("Automatic",
+                                   (int) CorrTrackAnalyser::CorrelationMethod::Auto);
+    correlationMethodCBox->addItem("Direct",
+                                   (int) CorrTrackAnalyser::CorrelationMethod::Direct);
+    correlationMethodCBox->addItem("FFT",
+                                   (int) CorrTrackAnalyser::CorrelationMethod::FFT);
+    correlationMethodCBox->addItem("Full-frame FFT",
+                                   (int) CorrTrackAnalyser::CorrelationMethod::FrameFFT);
+    correlationMethodCBox->addItem("Integer",
+                                   (int) CorrTrackAnalyser::CorrelationMethod::Integer);
+    correlationMethodCBox->addItem("Batched (BLAS)",
+                                   (int) CorrTrackAnalyser::CorrelationMethod::Batch);
+    correlationMethodCBox->setCurrentIndex(correlationMethodCBox->findData((int) correlationMethod));
     QVBoxLayout *filterOthersEditsLayout = new QVBoxLayout;
     filterOthersEditsLayout->addWidget(fitRadiusLE);
+    filterOthersEditsLayout->addWidget(localizationMethodCBox);
+    filterOthersEditsLayout->addWidget(subPixelMethodCBox);
+    filterOthersEditsLayout->addWidget(upsamplingFactorLE);
+    filterOthersEditsLayout->addWidget(correlationMethodCBox);
+    separableEnergyLE->setText(QString::number(separableEnergy));
+    filterOthersEditsLayout->addWidget(separableEnergyLE);
+    sparseThresholdLE->setText(QString::number(sparseThreshold));
+    filterOthersEditsLayout->addWidget(sparseThresholdLE);
+    chunkLengthLE->setText(QString::number(chunkLength));
+    filterOthersEditsLayout->addWidget(chunkLengthLE);
+    pyramidLevelsLE->setText(QString::number(pyramidLevels));
+    filterOthersEditsLayout->addWidget(pyramidLevelsLE);
+    motionModelCBox->addItem("Previous position",
+                             (int) MotionPredictor::Model::None);
+    motionModelCBox->addItem("Constant velocity",
+                             (int) MotionPredictor::Model::ConstantVelocity);
+    motionModelCBox->addItem("Kalman filter",
+                             (int) MotionPredictor::Model::Kalman);
+    motionModelCBox->setCurrentIndex(motionModelCBox->findData((int) motionModel));
+    filterOthersEditsLayout->addWidget(motionModelCBox);
+    unchangedThresholdLE->setText(QString::number(unchangedThreshold));
+    filterOthersEditsLayout->addWidget(unchangedThresholdLE);
+    detectionThresholdLE->setText(QString::number(detectionThreshold));
+    filterOthersEditsLayout->addWidget(detectionThresholdLE);
+    detectionRadiusLE->setText(QString::number(detectionRadius));
+    filterOthersEditsLayout->addWidget(detectionRadiusLE);
     QHBoxLayout *filterOthersLayout = new QHBoxLayout;
     filterOthersLayout->addLayout(filterOthersLabelsLayout);
     filterOthersLayout->addLayout(filterOthersEditsLayout);
 
+    normalizedCorrelationCB->setChecked(normalizedCorrelation);
+    singlePrecisionCB->setChecked(singlePrecision);
+    updateSinglePrecision();
+    driftCorrectionCB->setChecked(driftCorrection);
+
     QVBoxLayout *mainLayout = new QVBoxLayout;
     mainLayout->addWidget(filterWindowLabel);
     mainLayout->addLayout(filterWindowLayout);
+    mainLayout->addWidget(adaptiveWindowsCB);
     mainLayout->addLayout(filterFileLayout);
     mainLayout->addLayout(filterOthersLayout);
+    mainLayout->addWidget(normalizedCorrelationCB);
+    mainLayout->addWidget(singlePrecisionCB);
+    mainLayout->addWidget(driftCorrectionCB);
     setLayout(mainLayout);
 
     connect(filterFileButton, SIGNAL(clicked()),
             this, SLOT(chooseFilterFile()));
+    connect(correlationMethodCBox, SIGNAL(currentIndexChanged(int)),
+            this, SLOT(updateSinglePrecision()));
 }
 
 void CorrFilterDialog::chooseFilterFile()
@@ -127,6 +288,16 @@ void CorrFilterDialog::chooseFilterFile()
     }
 }
 
+void CorrFilterDialog::updateSinglePrecision()
+{
+    // Only the direct correlation has a single-precision path, which the
+    // automatic method uses when it chooses the direct one.  The others
+    // compute in double precision.
+    const CorrTrackAnalyser::CorrelationMethod method = getCorrelationMethod();
+    singlePrecisionCB->setEnabled(method == CorrTrackAnalyser::CorrelationMethod::Auto
+                                  || method == CorrTrackAnalyser::CorrelationMethod::Direct);
+}
+
 unsigned int CorrFilterDialog::getFilterWindowWidth() const
 {
     return filterWindowWidthLE->text().toUInt();
@@ -137,11 +308,91 @@ unsigned int CorrFilterDialog::getFilterWindowHeight() const
     return filterWindowHeightLE->text().toUInt();
 }
 
+bool CorrFilterDialog::getAdaptiveWindows() const
+{
+    return adaptiveWindowsCB->isChecked();
+}
+
 double CorrFilterDialog::getFitRadius() const
 {
     return fitRadiusLE->text().toDouble();
 }
 
+CorrTrackAnalyser::LocalizationMethod CorrFilterDialog::getLocalizationMethod() const
+{
+    return (CorrTrackAnalyser::LocalizationMethod) localizationMethodCBox->currentData().toInt();
+}
+
+CorrTrackAnalyser::SubPixelMethod CorrFilterDialog::getSubPixelMethod() const
+{
+    return (CorrTrackAnalyser::SubPixelMethod) subPixelMethodCBox->currentData().toInt();
+}
+
+unsigned int CorrFilterDialog::getUpsamplingFactor() const
+{
+    return upsamplingFactorLE->text().toUInt();
+}
+
+CorrTrackAnalyser::CorrelationMethod CorrFilterDialog::getCorrelationMethod() const
+{
+    return (CorrTrackAnalyser::CorrelationMethod) correlationMethodCBox->currentData().toInt();
+}
+
+bool CorrFilterDialog::getNormalizedCorrelation() const
+{
+    return normalizedCorrelationCB->isChecked();
+}
+
+bool CorrFilterDialog::getSinglePrecision() const
+{
+    return singlePrecisionCB->isEnabled() && singlePrecisionCB->isChecked();
+}
+
+double CorrFilterDialog::getSeparableEnergy() const
+{
+    return separableEnergyLE->text().toDouble();
+}
+
+double CorrFilterDialog::getSparseThreshold() const
+{
+    return sparseThresholdLE->text().toDouble();
+}
+
+size_t CorrFilterDialog::getChunkLength() const
+{
+    return chunkLengthLE->text().toUInt();
+}
+
+unsigned int CorrFilterDialog::getPyramidLevels() const
+{
+    return pyramidLevelsLE->text().toUInt();
+}
+
+MotionPredictor::Model CorrFilterDialog::getMotionModel() const
+{
+    return (MotionPredictor::Model) motionModelCBox->currentData().toInt();
+}
+
+bool CorrFilterDialog::getDriftCorrection() const
+{
+    return driftCorrectionCB->isChecked();
+}
+
+double CorrFilterDialog::getUnchangedThreshold() const
+{
+    return unchangedThresholdLE->text().toDouble();
+}
+
+double CorrFilterDialog::getDetectionThreshold() const
+{
+    return detectionThresholdLE->text().toDouble();
+}
+
+unsigned int CorrFilterDialog::getDetectionRadius() const
+{
+    return detectionRadiusLE->text().toUInt();
+}
+
 QString CorrFilterDialog::getFilterFile() const
 {
     return filterFileLE->text();
@@ -180,5 +431,77 @@ void CorrFilterDialog::ok()
         return;
     }
 
+    pos = upsamplingFactorLE->cursorPosition();
+    QString upsamplingFactorStr(upsamplingFactorLE->text());
+    if (upsamplingFactorLE->validator()->validate(upsamplingFactorStr, pos) != QValidator::Acceptable)
+    {
+        msgBox->setText(QString("Upsampling factor value outside acceptable range (1-%1).").arg(constants::UPSAMPLING_FACTOR_MAX_VALUE));
+        msgBox->exec();
+        return;
+    }
+
+    pos = separableEnergyLE->cursorPosition();
+    QString separableEnergyStr(separableEnergyLE->text());
+    if (separableEnergyLE->validator()->validate(separableEnergyStr, pos) != QValidator::Acceptable)
+    {
+        msgBox->setText(QString("Separable filter energy value outside acceptable range (0-%1).").arg(constants::SEPARABLE_ENERGY_MAX_VALUE));
+        msgBox->exec();
+        return;
+    }
+
+    pos = sparseThresholdLE->cursorPosition();
+    QString sparseThresholdStr(sparseThresholdLE->text());
+    if (sparseThresholdLE->validator()->validate(sparseThresholdStr, pos) != QValidator::Acceptable)
+    {
+        msgBox->setText(QString("Sparse filter threshold value outside acceptable range (0-%1).").arg(constants::SPARSE_THRESHOLD_MAX_VALUE));
+        msgBox->exec();
+        return;
+    }
+
+    pos = chunkLengthLE->cursorPosition();
+    QString chunkLengthStr(chunkLengthLE->text());
+    if (chunkLengthLE->validator()->validate(chunkLengthStr, pos) != QValidator::Acceptable)
+    {
+        msgBox->setText(QString("Chunk length value outside acceptable range (0-%1).").arg(constants::CHUNK_LENGTH_MAX_VALUE));
+        msgBox->exec();
+        return;
+    }
+
+    pos = pyramidLevelsLE->cursorPosition();
+    QString pyramidLevelsStr(pyramidLevelsLE->text());
+    if (pyramidLevelsLE->validator()->validate(pyramidLevelsStr, pos) != QValidator::Acceptable)
+    {
+        msgBox->setText(QString("Pyramid levels value outside acceptable range (0-%1).").arg(constants::PYRAMID_LEVELS_MAX_VALUE));
+        msgBox->exec();
+        return;
+    }
+
+    pos = unchangedThresholdLE->cursorPosition();
+    QString unchangedThresholdStr(unchangedThresholdLE->text());
+    if (unchangedThresholdLE->validator()->validate(unchangedThresholdStr, pos) != QValidator::Acceptable)
+    {
+        msgBox->setText(QString("Unchanged window threshold value outside acceptable range (0-%1).").arg(constants::UNCHANGED_THRESHOLD_MAX_VALUE));
+        msgBox->exec();
+        return;
+    }
+
+    pos = detectionThresholdLE->cursorPosition();
+    QString detectionThresholdStr(detectionThresholdLE->text());
+    if (detectionThresholdLE->validator()->validate(detectionThresholdStr, pos) != QValidator::Acceptable)
+    {
+        msgBox->setText(QString("Detection threshold value outside acceptable range (0-%1).").arg(constants::DETECTION_THRESHOLD_MAX_VALUE));
+        msgBox->exec();
+        return;
+    }
+
+    pos = detectionRadiusLE->cursorPosition();
+    QString detectionRadiusStr(detectionRadiusLE->text());
+    if (detectionRadiusLE->validator()->validate(detectionRadiusStr, pos) != QValidator::Acceptable)
+    {
+        msgBox->setText(QString("Detection radius value outside acceptable range (1-%1).").arg(constants::DETECTION_RADIUS_MAX_VALUE));
+        msgBox->exec();
+        return;
+    }
+
     return OKCancelDialog::ok();
 }
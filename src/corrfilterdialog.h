@@ -24,8 +24,11 @@
 
 #include <QDialog>
 #include <QLineEdit>
+#include <QComboBox>
+#include <QCheckBox>
 #include <QString>
 #include "okcanceldialog.h"
+#include "math/corrtrackanalyser.h"
 
 
 class CorrFilterDialog : public OKCancelDialog
@@ -35,24 +38,73 @@ class CorrFilterDialog : public OKCancelDialog
 private:
     QLineEdit *filterWindowWidthLE;
     QLineEdit *filterWindowHeightLE;
+    QCheckBox *adaptiveWindowsCB;
     QLineEdit *filterFileLE;
     QLineEdit *fitRadiusLE;
+    QComboBox *localizationMethodCBox;
+    QComboBox *subPixelMethodCBox;
+    QLineEdit *upsamplingFactorLE;
+    QComboBox *correlationMethodCBox;
+    QCheckBox *normalizedCorrelationCB;
+    QCheckBox *singlePrecisionCB;
+    QLineEdit *separableEnergyLE;
+    QLineEdit *sparseThresholdLE;
+    QLineEdit *chunkLengthLE;
+    QLineEdit *pyramidLevelsLE;
+    QComboBox *motionModelCBox;
+    QCheckBox *driftCorrectionCB;
+    QLineEdit *unchangedThresholdLE;
+    QLineEdit *detectionThresholdLE;
+    QLineEdit *detectionRadiusLE;
 
 private slots:
     void chooseFilterFile();
+    void updateSinglePrecision();
     void ok() override;
 
 public:
     explicit CorrFilterDialog(const unsigned int filterWindowWidth,
                               const unsigned int filterWindowHeight,
+                              const bool adaptiveWindows,
                               const QString filterFile,
                               const double fitRadius,
+                              const CorrTrackAnalyser::LocalizationMethod localizationMethod,
+                              const CorrTrackAnalyser::SubPixelMethod subPixelMethod,
+                              const unsigned int upsamplingFactor,
+                              const CorrTrackAnalyser::CorrelationMethod correlationMethod,
+                              const bool normalizedCorrelation,
+                              const bool singlePrecision,
+                              const double separableEnergy,
+                              const double sparseThreshold,
+                              const size_t chunkLength,
+                              const unsigned int pyramidLevels,
+                              const MotionPredictor::Model motionModel,
+                              const bool driftCorrection,
+                              const double unchangedThreshold,
+                              const double detectionThreshold,
+                              const unsigned int detectionRadius,
                               const QString newLastFilterFolder,
                               const QString newLastFolder,
                               QWidget* parent = 0);
     unsigned int getFilterWindowWidth() const;
     unsigned int getFilterWindowHeight() const;
+    bool getAdaptiveWindows() const;
     double getFitRadius() const;
+    CorrTrackAnalyser::LocalizationMethod getLocalizationMethod() const;
+    CorrTrackAnalyser::SubPixelMethod getSubPixelMethod() const;
+    unsigned int getUpsamplingFactor() const;
+    CorrTrackAnalyser::CorrelationMethod getCorrelationMethod() const;
+    bool getNormalizedCorrelation() const;
+    bool getSinglePrecision() const;
+    double getSeparableEnergy() const;
+    double getSparseThreshold() const;
+    size_t getChunkLength() const;
+    unsigned int getPyramidLevels() const;
+    MotionPredictor::Model getMotionModel() const;
+    bool getDriftCorrection() const;
+    double getUnchangedThreshold() const;
+    double getDetectionThreshold() const;
+    unsigned int getDetectionRadius() const;
     QString getFilterFile() const;
     QString lastFilterFolder;
     QString lastFolder;
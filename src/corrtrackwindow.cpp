@@ -338,6 +338,12 @@ void CorrTrackWindow::addPoint(Point point)
 {
     // Add point to analyser and draw it.
     analyser->addPoint(point);
+    drawPoint(point);
+    updatePointsCtrlMenuItems();
+}
+
+void CorrTrackWindow::drawPoint(Point point)
+{
     // Add point
     QGraphicsEllipseItem *ellipse;
     double diameter = 2.0 * POINT_RADIUS * pow(constants::ZOOM_BASE, -zoomIndex);
@@ -389,8 +395,24 @@ void CorrTrackWindow::addPoint(Point point)
     // Add correlation map (but do not display)
     QGraphicsPixmapItem *item = nullptr;
     correlationMapItems->push_back(item);
+}
 
+void CorrTrackWindow::detectPoints()
+{
+    if (!(analyser->filter->isFilterSet()))
+    {
+        displayMessageBox("No filter set.");
+        return;
+    }
+
+    // The detected particles replace the current points.
+    removeAllPoints();
+    analyser->selectImage(currentFrameIndex - 1);
+    analyser->detectPoints();
+    for (Point const& point : *analyser->getPoints())
+        drawPoint(point);
     updatePointsCtrlMenuItems();
+    statusBar()->showMessage(QString("%1 points detected").arg(analyser->getPoints()->size()));
 }
 
 void CorrTrackWindow::removeLastPoint()
@@ -799,14 +821,15 @@ void CorrTrackWindow::analyse()
 {
     if (!validateCorrelation()) return;
 
-    // Prevent a short display of strange progress values when showing the
-    // progress bar:
-    analyser->selectImage(0);
+    // The particles are tracked from the displayed frame.  Also prevent a
+    // short display of strange progress values when showing the progress bar:
+    analyser->selectImage(currentFrameIndex - 1);
+    analyser->nAnalysedFrames = 0;
 
     progressWindow = new ProgressWindow(this);
     progressWindow->setWindowTitle("Analysing...");
     progressWindow->setNStepsPtr(&(analyser->movie->nFrames));
-    progressWindow->setStepPtr(&(analyser->currFrameIndex));
+    progressWindow->setStepPtr(&(analyser->nAnalysedFrames));
     progressWindow->open();
 
     analyseWorker = new AnalyseWorker(analyser);
@@ -1016,8 +1039,24 @@ void CorrTrackWindow::corrFilter()
     // Show correlation filter dialog
     CorrFilterDialog *dialog = new CorrFilterDialog(oldWidth,
                                                     oldHeight,
+                                                    analyser->adaptiveWindows,
                                                     filterFile,
                                                     oldFitRadius,
+                                                    analyser->localizationMethod,
+                                                    analyser->subPixelMethod,
+                                                    analyser->upsamplingFactor,
+                                                    analyser->correlationMethod,
+                                                    analyser->normalizedCorrelation,
+                                                    analyser->singlePrecision,
+                                                    analyser->separableEnergy,
+                                                    analyser->sparseThreshold,
+                                                    analyser->chunkLength,
+                                                    analyser->pyramidLevels,
+                                                    analyser->motionModel,
+                                                    analyser->driftCorrection,
+                                                    analyser->unchangedThreshold,
+                                                    analyser->detectionThreshold,
+                                                    analyser->detectionRadius,
                                                     settings->lastFilterFolder,
                                                     settings->lastFolder,
                                                     this);
@@ -1026,8 +1065,24 @@ void CorrTrackWindow::corrFilter()
     {
         analyser->windowWidth = dialog->getFilterWindowWidth();
         analyser->windowHeight = dialog->getFilterWindowHeight();
+        analyser->adaptiveWindows = dialog->getAdaptiveWindows();
         filterFile = dialog->getFilterFile();
         analyser->fitRadius = dialog->getFitRadius();
+        analyser->localizationMethod = dialog->getLocalizationMethod();
+        analyser->subPixelMethod = dialog->getSubPixelMethod();
+        analyser->upsamplingFactor = dialog->getUpsamplingFactor();
+        analyser->correlationMethod = dialog->getCorrelationMethod();
+        analyser->normalizedCorrelation = dialog->getNormalizedCorrelation();
+        analyser->singlePrecision = dialog->getSinglePrecision();
+        analyser->separableEnergy = dialog->getSeparableEnergy();
+        analyser->sparseThreshold = dialog->getSparseThreshold();
+        analyser->chunkLength = dialog->getChunkLength();
+        analyser->pyramidLevels = dialog->getPyramidLevels();
+        analyser->motionModel = dialog->getMotionModel();
+        analyser->driftCorrection = dialog->getDriftCorrection();
+        analyser->unchangedThreshold = dialog->getUnchangedThreshold();
+        analyser->detectionThreshold = dialog->getDetectionThreshold();
+        analyser->detectionRadius = dialog->getDetectionRadius();
         settings->lastFilterFolder = dialog->lastFilterFolder;
         settings->lastFolder = dialog->lastFolder;
     }
@@ -1168,6 +1223,10 @@ void CorrTrackWindow::createActions()
     corrFilterAct->setStatusTip(tr("Correlation filter options"));
     connect(corrFilterAct, SIGNAL(triggered()), this, SLOT(corrFilter()));
 
+    detectAct = new QAction(tr("&Detect points"), this);
+    detectAct->setStatusTip(tr("Replace the points by the particles detected in the current frame"));
+    connect(detectAct, SIGNAL(triggered()), this, SLOT(detectPoints()));
+
     removeLastAct = new QAction(tr("&Remove last point"), this);
     removeLastAct->setStatusTip(tr("Remove last point"));
     connect(removeLastAct, SIGNAL(triggered()), this, SLOT(removeLastPoint()));
@@ -1226,6 +1285,8 @@ void CorrTrackWindow::createMenus()
     viewMenu->addAction(zoomAct);
 
     filterMenu = menuBar()->addMenu(tr("&Filter"));
+    filterMenu->addAction(detectAct);
+    filterMenu->addSeparator();
     filterMenu->addAction(removeLastAct);
     filterMenu->addAction(removeAllAct);
     filterMenu->addSeparator();
@@ -130,6 +130,7 @@ private:
     QAction *intensityAct;
     QAction *zoomAct;
     // Filter
+    QAction *detectAct;
     QAction *removeLastAct;
     QAction *removeAllAct;
     QAction *corrFilterAct;
@@ -155,6 +156,7 @@ private:
     bool validateCorrelation() const;
     void initSlider();
     void addPoint(Point);
+    void drawPoint(Point);
     void createActions();
     void createMenus();
     void createToolBars();
@@ -176,6 +178,7 @@ private slots:
     void intensity();
     void zoom();
     // Filter
+    void detectPoints();
     void removeLastPoint();
     void removeAllPoints();
     void corrFilter();
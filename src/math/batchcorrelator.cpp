@@ -0,0 +1,154 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include <algorithm>
+#include <limits>
+#include <gsl/gsl_cblas.h>
+#include "math/batchcorrelator.h"
+
+
+namespace
+{
+    // Number of values of the matrix of image regions gathered at once, so
+    // that it stays in the L2 cache while the product reads it.
+    const size_t BLOCK_VALUES = 32768;
+    // positionIndex of the positions that are not marked
+    const unsigned int NOT_MARKED = std::numeric_limits<unsigned int>::max();
+}
+
+
+BatchCorrelator::BatchCorrelator(const CorrFilter * const filter,
+                                 const unsigned int imageWidth,
+                                 const unsigned int imageHeight)
+    : templates(filter->filter,
+                filter->filter + (size_t) filter->nTemplates * filter->width * filter->height),
+      pixels((size_t) imageWidth * imageHeight),
+      positionIndex((size_t) imageWidth * imageHeight, NOT_MARKED),
+      rowNeeded(imageHeight, false),
+      isCorrelated{false},
+      filterWidth{filter->width}, filterHeight{filter->height},
+      nTemplates{filter->nTemplates},
+      imageWidth{imageWidth}, imageHeight{imageHeight}
+{
+    const size_t templateSize = (size_t) filterWidth * filterHeight;
+    patches.resize(std::max(BLOCK_VALUES / templateSize, (size_t) 1) * templateSize);
+}
+
+void BatchCorrelator::markWindow(const Point point,
+                                 const unsigned int windowWidth,
+                                 const unsigned int windowHeight)
+{
+    // Requests the correlation values of the window of point for the next
+    // call to correlate().  The positions whose region is not inside the
+    // image are ignored.
+    if (isCorrelated)
+    {
+        for (const size_t position : positions)
+            positionIndex[position] = NOT_MARKED;
+        positions.clear();
+        isCorrelated = false;
+    }
+
+    const int uMin = (int) point.x - (int) (windowWidth / 2) - (int) (filterWidth / 2);
+    const int vMin = (int) point.y - (int) (windowHeight / 2) - (int) (filterHeight / 2);
+    const int uLast = (int) imageWidth - (int) filterWidth;
+    const int vLast = (int) imageHeight - (int) filterHeight;
+    for (int v = std::max(vMin, 0); v < vMin + (int) windowHeight && v <= vLast; v++)
+    {
+        for (int u = std::max(uMin, 0); u < uMin + (int) windowWidth && u <= uLast; u++)
+        {
+            const size_t position = (size_t) v * imageWidth + u;
+            if (positionIndex[position] == NOT_MARKED)
+            {
+                positionIndex[position] = (unsigned int) positions.size();
+                positions.push_back(position);
+            }
+        }
+        for (unsigned int j = 0; j < filterHeight; j++)
+            rowNeeded[v + j] = true;
+    }
+}
+
+void BatchCorrelator::correlate(const ImageView<uint8_t> &image)
+{
+    correlatePositions(image);
+}
+
+void BatchCorrelator::correlate(const ImageView<uint16_t> &image)
+{
+    correlatePositions(image);
+}
+
+template<typename PixelDataType>
+void BatchCorrelator::correlatePositions(const ImageView<PixelDataType> &image)
+{
+    // Correlates the marked positions of image (of size imageWidth x
+    // imageHeight).
+
+    const size_t templateSize = (size_t) filterWidth * filterHeight;
+    const size_t blockRows = patches.size() / templateSize;
+
+    // The rows of the regions are converted once, as the regions of
+    // neighbouring positions overlap.
+    for (unsigned int j = 0; j < imageHeight; j++)
+    {
+        if (!rowNeeded[j])
+            continue;
+        rowNeeded[j] = false;
+        image.region(0, j, imageWidth, 1).convert(pixels.data() + (size_t) j * imageWidth,
+                                                  imageWidth);
+    }
+
+    correlation.resize(positions.size() * nTemplates);
+    for (size_t first = 0; first < positions.size(); first += blockRows)
+    {
+        const size_t nRows = std::min(blockRows, positions.size() - first);
+        // One row per position: its region, row by row like the filter
+        for (size_t r = 0; r < nRows; r++)
+        {
+            const double *region = pixels.data() + positions[first + r];
+            double *row = patches.data() + r * templateSize;
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                std::copy(region, region + filterWidth, row);
+                region += imageWidth;
+                row += filterWidth;
+            }
+        }
+
+        double * const output = correlation.data() + first * nTemplates;
+        if (nTemplates == 1)
+            cblas_dgemv(CblasRowMajor, CblasNoTrans,
+                        (int) nRows, (int) templateSize,
+                        1.0, patches.data(), (int) templateSize,
+                        templates.data(), 1,
+                        0.0, output, 1);
+        else
+            cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans,
+                        (int) nRows, (int) nTemplates, (int) templateSize,
+                        1.0, patches.data(), (int) templateSize,
+                        templates.data(), (int) templateSize,
+                        0.0, output, (int) nTemplates);
+    }
+    isCorrelated = true;
+}
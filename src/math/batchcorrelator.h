@@ -0,0 +1,96 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "corrfilter.h"
+#include "imageview.h"
+#include "point.h"
+
+
+// Correlates the windows of all the particles of a frame with the filter, or
+// with all the templates of a filter bank, as a single matrix product.
+//
+// Each correlation value is the dot product of an image region of the filter
+// size with the filter.  The regions of all the marked window pixels are
+// gathered as the rows of a matrix (im2col), which is multiplied by the
+// filter (matrix-vector product) or by the matrix of the templates
+// (matrix-matrix product) with the CBLAS interface linked with GSL.  Linking
+// an optimized BLAS instead of gslcblas speeds this up without any other
+// change.  The pixels of overlapping windows are only computed once.  The
+// rows are gathered in blocks that stay in cache.
+//
+// values(u, v)[t] is the correlation of template t with the image region
+// whose top-left pixel is (u, v).  It is only set for the marked windows,
+// until the next window is marked.
+class BatchCorrelator
+{
+private:
+    std::vector<double> templates;
+    // Image rows that the marked regions cover, converted to double
+    std::vector<double> pixels;
+    // Regions of a block of positions
+    std::vector<double> patches;
+    // Marked positions, as v * imageWidth + u, and index of each image
+    // position in positions
+    std::vector<size_t> positions;
+    std::vector<unsigned int> positionIndex;
+    std::vector<bool> rowNeeded;
+    bool isCorrelated;
+    // correlation[i * nTemplates + t]: template t at positions[i]
+    std::vector<double> correlation;
+
+    template<typename PixelDataType>
+        void correlatePositions(const ImageView<PixelDataType> &image);
+
+public:
+    explicit BatchCorrelator(const CorrFilter * const filter,
+                             const unsigned int imageWidth,
+                             const unsigned int imageHeight);
+    BatchCorrelator(const BatchCorrelator&) =delete;
+    BatchCorrelator& operator=(const BatchCorrelator&) =delete;
+    BatchCorrelator(BatchCorrelator&&) =delete;
+    BatchCorrelator& operator=(BatchCorrelator&&) =delete;
+
+    void markWindow(const Point point,
+                    const unsigned int windowWidth,
+                    const unsigned int windowHeight);
+    void correlate(const ImageView<uint8_t> &image);
+    void correlate(const ImageView<uint16_t> &image);
+
+    const double* values(const unsigned int u, const unsigned int v) const
+    {
+        return correlation.data()
+               + (size_t) positionIndex[(size_t) v * imageWidth + u] * nTemplates;
+    }
+
+    const unsigned int filterWidth;
+    const unsigned int filterHeight;
+    const unsigned int nTemplates;
+    const unsigned int imageWidth;
+    const unsigned int imageHeight;
+};
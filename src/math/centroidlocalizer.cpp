@@ -0,0 +1,72 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include "math/centroidlocalizer.h"
+#include "math/correlationkernels.h"
+
+
+CentroidLocalizer::CentroidLocalizer(const Movie * const movie)
+    : WindowLocalizer(movie)
+{}
+
+PointD CentroidLocalizer::locateInWindow(const ImageView<uint8_t> &window)
+{
+    return centroid(window, kernels::centroidRow8);
+}
+
+PointD CentroidLocalizer::locateInWindow(const ImageView<uint16_t> &window)
+{
+    return centroid(window, kernels::centroidRow16);
+}
+
+template<typename PixelDataType, typename Kernel>
+PointD CentroidLocalizer::centroid(const ImageView<PixelDataType> &window,
+                                   const Kernel kernel)
+{
+    // The sum of the pixels is that of the weights above 0.
+    const uint64_t nPixels = (uint64_t) window.width * window.height;
+    uint64_t sums[2];
+    uint64_t total = 0;
+    for (unsigned int j = 0; j < window.height; j++)
+    {
+        kernel(window.row(j), window.width, 0, sums);
+        total += sums[0];
+    }
+    const unsigned int background = (unsigned int) (total / nPixels);
+
+    uint64_t weight = 0;
+    uint64_t momentX = 0;
+    uint64_t momentY = 0;
+    for (unsigned int j = 0; j < window.height; j++)
+    {
+        kernel(window.row(j), window.width, background, sums);
+        weight += sums[0];
+        momentX += sums[1];
+        momentY += j * sums[0];
+    }
+    peakValue = (double) weight / nPixels;
+    // Uniform window
+    if (weight == 0)
+        return PointD(0.5 * (window.width - 1), 0.5 * (window.height - 1));
+    return PointD((double) momentX / weight, (double) momentY / weight);
+}
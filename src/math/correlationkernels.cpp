@@ -0,0 +1,1698 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "math/correlationkernels.h"
+
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define CORRTRACK_X86
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
+// GCC and Clang only emit instructions of the extensions enabled for the
+// function, while MSVC accepts all intrinsics anywhere.
+#if defined(CORRTRACK_X86) && !defined(_MSC_VER)
+    #define TARGET(extensions) __attribute__((target(extensions)))
+#else
+    #define TARGET(extensions)
+#endif
+
+// Loops over the coefficients of a filter row, fully unrolled in the kernels
+// specialized for a filter width up to kernels::MAX_SPECIALIZED_WIDTH.  GCC
+// does not unroll them by itself, and only knows this pragma from GCC 8.
+#if defined(__clang__)
+    #define UNROLL_FILTER_ROW _Pragma("unroll 15")
+#elif defined(__GNUC__) && __GNUC__ >= 8
+    #define UNROLL_FILTER_ROW _Pragma("GCC unroll 15")
+#else
+    #define UNROLL_FILTER_ROW
+#endif
+
+
+namespace
+{
+    template<unsigned int FilterWidth>
+    void correlationRowScalar(const double * const image,
+                              const size_t imageStride,
+                              const double * const filter,
+                              const unsigned int filterWidth,
+                              const unsigned int filterHeight,
+                              const unsigned int nOutputs,
+                              double * const output)
+    {
+        const unsigned int width = FilterWidth > 0 ? FilterWidth : filterWidth;
+        for (unsigned int i = 0; i < nOutputs; i++)
+        {
+            double correlation = 0.0;
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const double * const imageRow = image + j * imageStride + i;
+                const double * const filterRow = filter + j * width;
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < width; k++)
+                    correlation += imageRow[k] * filterRow[k];
+            }
+            output[i] = correlation;
+        }
+    }
+
+    void floatCorrelationRowScalar(const float * const image,
+                                   const size_t imageStride,
+                                   const float * const filter,
+                                   const unsigned int filterWidth,
+                                   const unsigned int filterHeight,
+                                   const unsigned int nOutputs,
+                                   double * const output)
+    {
+        for (unsigned int i = 0; i < nOutputs; i++)
+        {
+            double correlation = 0.0;
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const float * const imageRow = image + j * imageStride + i;
+                const float * const filterRow = filter + j * filterWidth;
+                float rowCorrelation = 0.0f;
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < filterWidth; k++)
+                    rowCorrelation += imageRow[k] * filterRow[k];
+                correlation += rowCorrelation;
+            }
+            output[i] = correlation;
+        }
+    }
+
+    void sparseCorrelationRowScalar(const double * const image,
+                                    const size_t imageStride,
+                                    const kernels::FilterRun * const runs,
+                                    const unsigned int nRuns,
+                                    const double * const weights,
+                                    const unsigned int nOutputs,
+                                    double * const output)
+    {
+        for (unsigned int i = 0; i < nOutputs; i++)
+        {
+            double correlation = 0.0;
+            const double *runWeights = weights;
+            for (unsigned int r = 0; r < nRuns; r++)
+            {
+                const double * const imageRun = image + runs[r].y * imageStride + runs[r].x + i;
+                for (unsigned int k = 0; k < runs[r].length; k++)
+                    correlation += imageRun[k] * runWeights[k];
+                runWeights += runs[r].length;
+            }
+            output[i] = correlation;
+        }
+    }
+
+    template <typename PixelType>
+    void integerCorrelationRowScalar(const PixelType * const image,
+                                     const size_t imageStride,
+                                     const uint16_t pixelOffset,
+                                     const int16_t * const filter,
+                                     const unsigned int filterWidth,
+                                     const unsigned int filterStride,
+                                     const unsigned int filterHeight,
+                                     const unsigned int nOutputs,
+                                     int64_t * const output)
+    {
+        for (unsigned int i = 0; i < nOutputs; i++)
+        {
+            int64_t correlation = 0;
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const PixelType * const imageRow = image + j * imageStride + i;
+                const int16_t * const filterRow = filter + j * filterStride;
+                for (unsigned int k = 0; k < filterWidth; k++)
+                    correlation += (int64_t) ((int32_t) imageRow[k] - (int32_t) pixelOffset)
+                                   * filterRow[k];
+            }
+            output[i] = correlation;
+        }
+    }
+
+    void integerCorrelationRowScalar8(const uint8_t * const image,
+                                      const size_t imageStride,
+                                      const int16_t * const filter,
+                                      const unsigned int filterWidth,
+                                      const unsigned int filterStride,
+                                      const unsigned int filterHeight,
+                                      const unsigned int nOutputs,
+                                      int64_t * const output)
+    {
+        integerCorrelationRowScalar(image, imageStride, 0, filter,
+                                    filterWidth, filterStride, filterHeight,
+                                    nOutputs, output);
+    }
+
+    template <typename PixelType>
+    uint64_t absoluteDifferenceScalar(const PixelType * const a,
+                                      const PixelType * const b,
+                                      const size_t n)
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < n; i++)
+            sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        return sum;
+    }
+
+    template <typename PixelType>
+    void centroidRowScalar(const PixelType * const pixels, const size_t n,
+                           const unsigned int threshold,
+                           uint64_t * const sums)
+    {
+        uint64_t weight = 0;
+        uint64_t moment = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const uint64_t w = pixels[i] > threshold ? pixels[i] - threshold : 0;
+            weight += w;
+            moment += i * w;
+        }
+        sums[0] = weight;
+        sums[1] = moment;
+    }
+
+    void radialSymmetrySums(const float * const gradientX,
+                            const float * const gradientY,
+                            const unsigned int first, const unsigned int n,
+                            const float y,
+                            const float centroidX, const float centroidY,
+                            const float minDistance,
+                            double * const sums)
+    {
+        // Sums of the radial symmetry row kernels over first <= i < n
+        const float dy = y - centroidY;
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f, ar = 0.0f, br = 0.0f;
+        for (unsigned int i = first; i < n; i++)
+        {
+            const float x = (float) i;
+            const float dx = x - centroidX;
+            const float w = 1.0f / std::max(std::sqrt(dx * dx + dy * dy), minDistance);
+            const float a = gradientY[i];
+            const float b = -gradientX[i];
+            const float r = (a * x + b * y) * w;
+            aa += a * a * w;
+            ab += a * b * w;
+            bb += b * b * w;
+            ar += a * r;
+            br += b * r;
+        }
+        sums[0] = aa;
+        sums[1] = ab;
+        sums[2] = bb;
+        sums[3] = ar;
+        sums[4] = br;
+    }
+
+    void radialSymmetryRowScalar(const float * const gradientX,
+                                 const float * const gradientY,
+                                 const unsigned int n,
+                                 const float y,
+                                 const float centroidX,
+                                 const float centroidY,
+                                 const float minDistance,
+                                 double * const sums)
+    {
+        radialSymmetrySums(gradientX, gradientY, 0, n, y, centroidX, centroidY,
+                           minDistance, sums);
+    }
+
+#ifdef CORRTRACK_X86
+
+    int32_t coefficientsPair(const int16_t * const coefficients)
+    {
+        // Two neighbouring coefficients packed as the int16 pair expected by
+        // pmaddwd, the first one in the low half.
+        return (int32_t) ((uint32_t) (uint16_t) coefficients[0]
+                          | ((uint32_t) (uint16_t) coefficients[1] << 16));
+    }
+
+    void cpuid(int info[4], const int leaf, const int subleaf)
+    {
+#ifdef _MSC_VER
+        __cpuidex(info, leaf, subleaf);
+#else
+        unsigned int a, b, c, d;
+        __cpuid_count(leaf, subleaf, a, b, c, d);
+        info[0] = (int) a;
+        info[1] = (int) b;
+        info[2] = (int) c;
+        info[3] = (int) d;
+#endif
+    }
+
+    uint64_t xgetbv(const unsigned int index)
+    {
+#ifdef _MSC_VER
+        return _xgetbv(index);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+        return ((uint64_t) edx << 32) | eax;
+#endif
+    }
+
+    template<unsigned int FilterWidth>
+    TARGET("sse2")
+    void correlationRowSSE2(const double * const image,
+                            const size_t imageStride,
+                            const double * const filter,
+                            const unsigned int filterWidth,
+                            const unsigned int filterHeight,
+                            const unsigned int nOutputs,
+                            double * const output)
+    {
+        const unsigned int width = FilterWidth > 0 ? FilterWidth : filterWidth;
+        unsigned int i = 0;
+        // Blocks of 8 outputs
+        for (; i + 8 <= nOutputs; i += 8)
+        {
+            __m128d acc0 = _mm_setzero_pd();
+            __m128d acc1 = _mm_setzero_pd();
+            __m128d acc2 = _mm_setzero_pd();
+            __m128d acc3 = _mm_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const double * const imageRow = image + j * imageStride + i;
+                const double * const filterRow = filter + j * width;
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < width; k++)
+                {
+                    const __m128d c = _mm_set1_pd(filterRow[k]);
+                    acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(imageRow + k), c));
+                    acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(imageRow + k + 2), c));
+                    acc2 = _mm_add_pd(acc2, _mm_mul_pd(_mm_loadu_pd(imageRow + k + 4), c));
+                    acc3 = _mm_add_pd(acc3, _mm_mul_pd(_mm_loadu_pd(imageRow + k + 6), c));
+                }
+            }
+            _mm_storeu_pd(output + i, acc0);
+            _mm_storeu_pd(output + i + 2, acc1);
+            _mm_storeu_pd(output + i + 4, acc2);
+            _mm_storeu_pd(output + i + 6, acc3);
+        }
+        // Blocks of 2 outputs
+        for (; i + 2 <= nOutputs; i += 2)
+        {
+            __m128d acc = _mm_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const double * const imageRow = image + j * imageStride + i;
+                const double * const filterRow = filter + j * width;
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < width; k++)
+                {
+                    const __m128d c = _mm_set1_pd(filterRow[k]);
+                    acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(imageRow + k), c));
+                }
+            }
+            _mm_storeu_pd(output + i, acc);
+        }
+        if (i < nOutputs)
+            correlationRowScalar<FilterWidth>(image + i, imageStride, filter,
+                                              filterWidth, filterHeight,
+                                              nOutputs - i, output + i);
+    }
+
+    template<unsigned int FilterWidth>
+    TARGET("avx2,fma")
+    void correlationRowAVX2(const double * const image,
+                            const size_t imageStride,
+                            const double * const filter,
+                            const unsigned int filterWidth,
+                            const unsigned int filterHeight,
+                            const unsigned int nOutputs,
+                            double * const output)
+    {
+        const unsigned int width = FilterWidth > 0 ? FilterWidth : filterWidth;
+        unsigned int i = 0;
+        // Blocks of 16 outputs
+        for (; i + 16 <= nOutputs; i += 16)
+        {
+            __m256d acc0 = _mm256_setzero_pd();
+            __m256d acc1 = _mm256_setzero_pd();
+            __m256d acc2 = _mm256_setzero_pd();
+            __m256d acc3 = _mm256_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const double * const imageRow = image + j * imageStride + i;
+                const double * const filterRow = filter + j * width;
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < width; k++)
+                {
+                    const __m256d c = _mm256_broadcast_sd(filterRow + k);
+                    acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(imageRow + k), c, acc0);
+                    acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(imageRow + k + 4), c, acc1);
+                    acc2 = _mm256_fmadd_pd(_mm256_loadu_pd(imageRow + k + 8), c, acc2);
+                    acc3 = _mm256_fmadd_pd(_mm256_loadu_pd(imageRow + k + 12), c, acc3);
+                }
+            }
+            _mm256_storeu_pd(output + i, acc0);
+            _mm256_storeu_pd(output + i + 4, acc1);
+            _mm256_storeu_pd(output + i + 8, acc2);
+            _mm256_storeu_pd(output + i + 12, acc3);
+        }
+        // Blocks of 4 outputs
+        for (; i + 4 <= nOutputs; i += 4)
+        {
+            __m256d acc = _mm256_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const double * const imageRow = image + j * imageStride + i;
+                const double * const filterRow = filter + j * width;
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < width; k++)
+                {
+                    const __m256d c = _mm256_broadcast_sd(filterRow + k);
+                    acc = _mm256_fmadd_pd(_mm256_loadu_pd(imageRow + k), c, acc);
+                }
+            }
+            _mm256_storeu_pd(output + i, acc);
+        }
+        // Remaining outputs: use masked loads so that no pixel outside of the
+        // footprint is read.
+        if (i < nOutputs)
+        {
+            const unsigned int n = nOutputs - i;
+            const __m256i mask = _mm256_setr_epi64x(n > 0 ? -1 : 0,
+                                                    n > 1 ? -1 : 0,
+                                                    n > 2 ? -1 : 0,
+                                                    0);
+            __m256d acc = _mm256_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const double * const imageRow = image + j * imageStride + i;
+                const double * const filterRow = filter + j * width;
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < width; k++)
+                {
+                    const __m256d c = _mm256_broadcast_sd(filterRow + k);
+                    acc = _mm256_fmadd_pd(_mm256_maskload_pd(imageRow + k, mask), c, acc);
+                }
+            }
+            _mm256_maskstore_pd(output + i, mask, acc);
+        }
+    }
+
+    template<unsigned int FilterWidth>
+    TARGET("avx512f")
+    void correlationRowAVX512(const double * const image,
+                              const size_t imageStride,
+                              const double * const filter,
+                              const unsigned int filterWidth,
+                              const unsigned int filterHeight,
+                              const unsigned int nOutputs,
+                              double * const output)
+    {
+        const unsigned int width = FilterWidth > 0 ? FilterWidth : filterWidth;
+        unsigned int i = 0;
+        // Blocks of 32 outputs
+        for (; i + 32 <= nOutputs; i += 32)
+        {
+            __m512d acc0 = _mm512_setzero_pd();
+            __m512d acc1 = _mm512_setzero_pd();
+            __m512d acc2 = _mm512_setzero_pd();
+            __m512d acc3 = _mm512_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const double * const imageRow = image + j * imageStride + i;
+                const double * const filterRow = filter + j * width;
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < width; k++)
+                {
+                    const __m512d c = _mm512_set1_pd(filterRow[k]);
+                    acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(imageRow + k), c, acc0);
+                    acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(imageRow + k + 8), c, acc1);
+                    acc2 = _mm512_fmadd_pd(_mm512_loadu_pd(imageRow + k + 16), c, acc2);
+                    acc3 = _mm512_fmadd_pd(_mm512_loadu_pd(imageRow + k + 24), c, acc3);
+                }
+            }
+            _mm512_storeu_pd(output + i, acc0);
+            _mm512_storeu_pd(output + i + 8, acc1);
+            _mm512_storeu_pd(output + i + 16, acc2);
+            _mm512_storeu_pd(output + i + 24, acc3);
+        }
+        // Blocks of up to 8 outputs, the last one being masked
+        for (; i < nOutputs; i += 8)
+        {
+            const unsigned int n = nOutputs - i < 8 ? nOutputs - i : 8;
+            const __mmask8 mask = (__mmask8) ((1u << n) - 1u);
+            __m512d acc = _mm512_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const double * const imageRow = image + j * imageStride + i;
+                const double * const filterRow = filter + j * width;
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < width; k++)
+                {
+                    const __m512d c = _mm512_set1_pd(filterRow[k]);
+                    acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, imageRow + k), c, acc);
+                }
+            }
+            _mm512_mask_storeu_pd(output + i, mask, acc);
+        }
+    }
+
+    TARGET("sse2")
+    void floatCorrelationRowSSE2(const float * const image,
+                                 const size_t imageStride,
+                                 const float * const filter,
+                                 const unsigned int filterWidth,
+                                 const unsigned int filterHeight,
+                                 const unsigned int nOutputs,
+                                 double * const output)
+    {
+        unsigned int i = 0;
+        // Blocks of 8 outputs
+        for (; i + 8 <= nOutputs; i += 8)
+        {
+            __m128d sum0 = _mm_setzero_pd();
+            __m128d sum1 = _mm_setzero_pd();
+            __m128d sum2 = _mm_setzero_pd();
+            __m128d sum3 = _mm_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const float * const imageRow = image + j * imageStride + i;
+                const float * const filterRow = filter + j * filterWidth;
+                __m128 acc0 = _mm_setzero_ps();
+                __m128 acc1 = _mm_setzero_ps();
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < filterWidth; k++)
+                {
+                    const __m128 c = _mm_set1_ps(filterRow[k]);
+                    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(imageRow + k), c));
+                    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(imageRow + k + 4), c));
+                }
+                sum0 = _mm_add_pd(sum0, _mm_cvtps_pd(acc0));
+                sum1 = _mm_add_pd(sum1, _mm_cvtps_pd(_mm_movehl_ps(acc0, acc0)));
+                sum2 = _mm_add_pd(sum2, _mm_cvtps_pd(acc1));
+                sum3 = _mm_add_pd(sum3, _mm_cvtps_pd(_mm_movehl_ps(acc1, acc1)));
+            }
+            _mm_storeu_pd(output + i, sum0);
+            _mm_storeu_pd(output + i + 2, sum1);
+            _mm_storeu_pd(output + i + 4, sum2);
+            _mm_storeu_pd(output + i + 6, sum3);
+        }
+        // Blocks of 4 outputs
+        for (; i + 4 <= nOutputs; i += 4)
+        {
+            __m128d sum0 = _mm_setzero_pd();
+            __m128d sum1 = _mm_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const float * const imageRow = image + j * imageStride + i;
+                const float * const filterRow = filter + j * filterWidth;
+                __m128 acc = _mm_setzero_ps();
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < filterWidth; k++)
+                {
+                    const __m128 c = _mm_set1_ps(filterRow[k]);
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(imageRow + k), c));
+                }
+                sum0 = _mm_add_pd(sum0, _mm_cvtps_pd(acc));
+                sum1 = _mm_add_pd(sum1, _mm_cvtps_pd(_mm_movehl_ps(acc, acc)));
+            }
+            _mm_storeu_pd(output + i, sum0);
+            _mm_storeu_pd(output + i + 2, sum1);
+        }
+        if (i < nOutputs)
+            floatCorrelationRowScalar(image + i, imageStride, filter,
+                                      filterWidth, filterHeight,
+                                      nOutputs - i, output + i);
+    }
+
+    TARGET("avx2,fma")
+    void floatCorrelationRowAVX2(const float * const image,
+                                 const size_t imageStride,
+                                 const float * const filter,
+                                 const unsigned int filterWidth,
+                                 const unsigned int filterHeight,
+                                 const unsigned int nOutputs,
+                                 double * const output)
+    {
+        unsigned int i = 0;
+        // Blocks of 16 outputs
+        for (; i + 16 <= nOutputs; i += 16)
+        {
+            __m256d sum0 = _mm256_setzero_pd();
+            __m256d sum1 = _mm256_setzero_pd();
+            __m256d sum2 = _mm256_setzero_pd();
+            __m256d sum3 = _mm256_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const float * const imageRow = image + j * imageStride + i;
+                const float * const filterRow = filter + j * filterWidth;
+                __m256 acc0 = _mm256_setzero_ps();
+                __m256 acc1 = _mm256_setzero_ps();
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < filterWidth; k++)
+                {
+                    const __m256 c = _mm256_broadcast_ss(filterRow + k);
+                    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(imageRow + k), c, acc0);
+                    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(imageRow + k + 8), c, acc1);
+                }
+                sum0 = _mm256_add_pd(sum0, _mm256_cvtps_pd(_mm256_castps256_ps128(acc0)));
+                sum1 = _mm256_add_pd(sum1, _mm256_cvtps_pd(_mm256_extractf128_ps(acc0, 1)));
+                sum2 = _mm256_add_pd(sum2, _mm256_cvtps_pd(_mm256_castps256_ps128(acc1)));
+                sum3 = _mm256_add_pd(sum3, _mm256_cvtps_pd(_mm256_extractf128_ps(acc1, 1)));
+            }
+            _mm256_storeu_pd(output + i, sum0);
+            _mm256_storeu_pd(output + i + 4, sum1);
+            _mm256_storeu_pd(output + i + 8, sum2);
+            _mm256_storeu_pd(output + i + 12, sum3);
+        }
+        // Blocks of up to 8 outputs, the last one being masked so that no
+        // pixel outside of the footprint is read
+        for (; i < nOutputs; i += 8)
+        {
+            const unsigned int n = nOutputs - i;
+            const __m256i mask = _mm256_setr_epi32(-1,
+                                                   n > 1 ? -1 : 0,
+                                                   n > 2 ? -1 : 0,
+                                                   n > 3 ? -1 : 0,
+                                                   n > 4 ? -1 : 0,
+                                                   n > 5 ? -1 : 0,
+                                                   n > 6 ? -1 : 0,
+                                                   n > 7 ? -1 : 0);
+            __m256d sum0 = _mm256_setzero_pd();
+            __m256d sum1 = _mm256_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const float * const imageRow = image + j * imageStride + i;
+                const float * const filterRow = filter + j * filterWidth;
+                __m256 acc = _mm256_setzero_ps();
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < filterWidth; k++)
+                {
+                    const __m256 c = _mm256_broadcast_ss(filterRow + k);
+                    acc = _mm256_fmadd_ps(_mm256_maskload_ps(imageRow + k, mask), c, acc);
+                }
+                sum0 = _mm256_add_pd(sum0, _mm256_cvtps_pd(_mm256_castps256_ps128(acc)));
+                sum1 = _mm256_add_pd(sum1, _mm256_cvtps_pd(_mm256_extractf128_ps(acc, 1)));
+            }
+            if (n >= 8)
+            {
+                _mm256_storeu_pd(output + i, sum0);
+                _mm256_storeu_pd(output + i + 4, sum1);
+            }
+            else
+            {
+                // 64-bit masks of the two halves of the outputs
+                _mm256_maskstore_pd(output + i, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(mask)),
+                                    sum0);
+                _mm256_maskstore_pd(output + i + 4, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(mask, 1)),
+                                    sum1);
+            }
+        }
+    }
+
+    // Low (Half = 0) or high (Half = 1) half of the 16 floats of v, as
+    // doubles.  The zero-masked intrinsics avoid the undefined vectors of the
+    // plain ones, which GCC 12 reports as maybe used uninitialized.
+    template<int Half>
+    TARGET("avx512f")
+    inline __m512d halfToDouble(const __m512 v)
+    {
+        const __m256d values = _mm512_maskz_extractf64x4_pd(0xf, _mm512_castps_pd(v), Half);
+        return _mm512_maskz_cvtps_pd(0xff, _mm256_castpd_ps(values));
+    }
+
+    TARGET("avx512f")
+    void floatCorrelationRowAVX512(const float * const image,
+                                   const size_t imageStride,
+                                   const float * const filter,
+                                   const unsigned int filterWidth,
+                                   const unsigned int filterHeight,
+                                   const unsigned int nOutputs,
+                                   double * const output)
+    {
+        unsigned int i = 0;
+        // Blocks of 32 outputs
+        for (; i + 32 <= nOutputs; i += 32)
+        {
+            __m512d sum0 = _mm512_setzero_pd();
+            __m512d sum1 = _mm512_setzero_pd();
+            __m512d sum2 = _mm512_setzero_pd();
+            __m512d sum3 = _mm512_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const float * const imageRow = image + j * imageStride + i;
+                const float * const filterRow = filter + j * filterWidth;
+                __m512 acc0 = _mm512_setzero_ps();
+                __m512 acc1 = _mm512_setzero_ps();
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < filterWidth; k++)
+                {
+                    const __m512 c = _mm512_set1_ps(filterRow[k]);
+                    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(imageRow + k), c, acc0);
+                    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(imageRow + k + 16), c, acc1);
+                }
+                sum0 = _mm512_add_pd(sum0, halfToDouble<0>(acc0));
+                sum1 = _mm512_add_pd(sum1, halfToDouble<1>(acc0));
+                sum2 = _mm512_add_pd(sum2, halfToDouble<0>(acc1));
+                sum3 = _mm512_add_pd(sum3, halfToDouble<1>(acc1));
+            }
+            _mm512_storeu_pd(output + i, sum0);
+            _mm512_storeu_pd(output + i + 8, sum1);
+            _mm512_storeu_pd(output + i + 16, sum2);
+            _mm512_storeu_pd(output + i + 24, sum3);
+        }
+        // Blocks of up to 16 outputs, the last one being masked
+        for (; i < nOutputs; i += 16)
+        {
+            const unsigned int n = nOutputs - i < 16 ? nOutputs - i : 16;
+            const __mmask16 mask = (__mmask16) ((1u << n) - 1u);
+            __m512d sum0 = _mm512_setzero_pd();
+            __m512d sum1 = _mm512_setzero_pd();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const float * const imageRow = image + j * imageStride + i;
+                const float * const filterRow = filter + j * filterWidth;
+                __m512 acc = _mm512_setzero_ps();
+                UNROLL_FILTER_ROW
+                for (unsigned int k = 0; k < filterWidth; k++)
+                {
+                    const __m512 c = _mm512_set1_ps(filterRow[k]);
+                    acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, imageRow + k), c, acc);
+                }
+                sum0 = _mm512_add_pd(sum0, halfToDouble<0>(acc));
+                sum1 = _mm512_add_pd(sum1, halfToDouble<1>(acc));
+            }
+            _mm512_mask_storeu_pd(output + i, (__mmask8) (mask & 0xff), sum0);
+            _mm512_mask_storeu_pd(output + i + 8, (__mmask8) (mask >> 8), sum1);
+        }
+    }
+
+    TARGET("sse2")
+    void sparseCorrelationRowSSE2(const double * const image,
+                                  const size_t imageStride,
+                                  const kernels::FilterRun * const runs,
+                                  const unsigned int nRuns,
+                                  const double * const weights,
+                                  const unsigned int nOutputs,
+                                  double * const output)
+    {
+        unsigned int i = 0;
+        // Blocks of 8 outputs
+        for (; i + 8 <= nOutputs; i += 8)
+        {
+            __m128d acc0 = _mm_setzero_pd();
+            __m128d acc1 = _mm_setzero_pd();
+            __m128d acc2 = _mm_setzero_pd();
+            __m128d acc3 = _mm_setzero_pd();
+            const double *runWeights = weights;
+            for (unsigned int r = 0; r < nRuns; r++)
+            {
+                const double * const imageRun = image + runs[r].y * imageStride + runs[r].x + i;
+                for (unsigned int k = 0; k < runs[r].length; k++)
+                {
+                    const __m128d c = _mm_set1_pd(runWeights[k]);
+                    acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(imageRun + k), c));
+                    acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(imageRun + k + 2), c));
+                    acc2 = _mm_add_pd(acc2, _mm_mul_pd(_mm_loadu_pd(imageRun + k + 4), c));
+                    acc3 = _mm_add_pd(acc3, _mm_mul_pd(_mm_loadu_pd(imageRun + k + 6), c));
+                }
+                runWeights += runs[r].length;
+            }
+            _mm_storeu_pd(output + i, acc0);
+            _mm_storeu_pd(output + i + 2, acc1);
+            _mm_storeu_pd(output + i + 4, acc2);
+            _mm_storeu_pd(output + i + 6, acc3);
+        }
+        if (i < nOutputs)
+            sparseCorrelationRowScalar(image + i, imageStride, runs, nRuns, weights,
+                                       nOutputs - i, output + i);
+    }
+
+    TARGET("avx2,fma")
+    void sparseCorrelationRowAVX2(const double * const image,
+                                  const size_t imageStride,
+                                  const kernels::FilterRun * const runs,
+                                  const unsigned int nRuns,
+                                  const double * const weights,
+                                  const unsigned int nOutputs,
+                                  double * const output)
+    {
+        unsigned int i = 0;
+        // Blocks of 16 outputs
+        for (; i + 16 <= nOutputs; i += 16)
+        {
+            __m256d acc0 = _mm256_setzero_pd();
+            __m256d acc1 = _mm256_setzero_pd();
+            __m256d acc2 = _mm256_setzero_pd();
+            __m256d acc3 = _mm256_setzero_pd();
+            const double *runWeights = weights;
+            for (unsigned int r = 0; r < nRuns; r++)
+            {
+                const double * const imageRun = image + runs[r].y * imageStride + runs[r].x + i;
+                for (unsigned int k = 0; k < runs[r].length; k++)
+                {
+                    const __m256d c = _mm256_broadcast_sd(runWeights + k);
+                    acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(imageRun + k), c, acc0);
+                    acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(imageRun + k + 4), c, acc1);
+                    acc2 = _mm256_fmadd_pd(_mm256_loadu_pd(imageRun + k + 8), c, acc2);
+                    acc3 = _mm256_fmadd_pd(_mm256_loadu_pd(imageRun + k + 12), c, acc3);
+                }
+                runWeights += runs[r].length;
+            }
+            _mm256_storeu_pd(output + i, acc0);
+            _mm256_storeu_pd(output + i + 4, acc1);
+            _mm256_storeu_pd(output + i + 8, acc2);
+            _mm256_storeu_pd(output + i + 12, acc3);
+        }
+        // Blocks of 4 outputs
+        for (; i + 4 <= nOutputs; i += 4)
+        {
+            __m256d acc = _mm256_setzero_pd();
+            const double *runWeights = weights;
+            for (unsigned int r = 0; r < nRuns; r++)
+            {
+                const double * const imageRun = image + runs[r].y * imageStride + runs[r].x + i;
+                for (unsigned int k = 0; k < runs[r].length; k++)
+                {
+                    const __m256d c = _mm256_broadcast_sd(runWeights + k);
+                    acc = _mm256_fmadd_pd(_mm256_loadu_pd(imageRun + k), c, acc);
+                }
+                runWeights += runs[r].length;
+            }
+            _mm256_storeu_pd(output + i, acc);
+        }
+        if (i < nOutputs)
+            sparseCorrelationRowScalar(image + i, imageStride, runs, nRuns, weights,
+                                       nOutputs - i, output + i);
+    }
+
+    TARGET("avx512f")
+    void sparseCorrelationRowAVX512(const double * const image,
+                                    const size_t imageStride,
+                                    const kernels::FilterRun * const runs,
+                                    const unsigned int nRuns,
+                                    const double * const weights,
+                                    const unsigned int nOutputs,
+                                    double * const output)
+    {
+        unsigned int i = 0;
+        // Blocks of 32 outputs
+        for (; i + 32 <= nOutputs; i += 32)
+        {
+            __m512d acc0 = _mm512_setzero_pd();
+            __m512d acc1 = _mm512_setzero_pd();
+            __m512d acc2 = _mm512_setzero_pd();
+            __m512d acc3 = _mm512_setzero_pd();
+            const double *runWeights = weights;
+            for (unsigned int r = 0; r < nRuns; r++)
+            {
+                const double * const imageRun = image + runs[r].y * imageStride + runs[r].x + i;
+                for (unsigned int k = 0; k < runs[r].length; k++)
+                {
+                    const __m512d c = _mm512_set1_pd(runWeights[k]);
+                    acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(imageRun + k), c, acc0);
+                    acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(imageRun + k + 8), c, acc1);
+                    acc2 = _mm512_fmadd_pd(_mm512_loadu_pd(imageRun + k + 16), c, acc2);
+                    acc3 = _mm512_fmadd_pd(_mm512_loadu_pd(imageRun + k + 24), c, acc3);
+                }
+                runWeights += runs[r].length;
+            }
+            _mm512_storeu_pd(output + i, acc0);
+            _mm512_storeu_pd(output + i + 8, acc1);
+            _mm512_storeu_pd(output + i + 16, acc2);
+            _mm512_storeu_pd(output + i + 24, acc3);
+        }
+        // Blocks of up to 8 outputs, the last one being masked
+        for (; i < nOutputs; i += 8)
+        {
+            const unsigned int n = nOutputs - i < 8 ? nOutputs - i : 8;
+            const __mmask8 mask = (__mmask8) ((1u << n) - 1u);
+            __m512d acc = _mm512_setzero_pd();
+            const double *runWeights = weights;
+            for (unsigned int r = 0; r < nRuns; r++)
+            {
+                const double * const imageRun = image + runs[r].y * imageStride + runs[r].x + i;
+                for (unsigned int k = 0; k < runs[r].length; k++)
+                {
+                    const __m512d c = _mm512_set1_pd(runWeights[k]);
+                    acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, imageRun + k), c, acc);
+                }
+                runWeights += runs[r].length;
+            }
+            _mm512_mask_storeu_pd(output + i, mask, acc);
+        }
+    }
+
+    // Loads 8 (SSE2) or 16 (AVX2) pixels as int16
+
+    TARGET("sse2")
+    inline __m128i loadPixelsSSE2(const uint8_t * const pixels, const __m128i)
+    {
+        return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) pixels),
+                                 _mm_setzero_si128());
+    }
+
+    TARGET("sse2")
+    inline __m128i loadPixelsSSE2(const uint16_t * const pixels, const __m128i offset)
+    {
+        return _mm_xor_si128(_mm_loadu_si128((const __m128i *) pixels), offset);
+    }
+
+    TARGET("avx2")
+    inline __m256i loadPixelsAVX2(const uint8_t * const pixels, const __m256i)
+    {
+        return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) pixels));
+    }
+
+    TARGET("avx2")
+    inline __m256i loadPixelsAVX2(const uint16_t * const pixels, const __m256i offset)
+    {
+        return _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) pixels), offset);
+    }
+
+    template <typename PixelType>
+    TARGET("sse2")
+    void integerCorrelationRowSSE2(const PixelType * const image,
+                                   const size_t imageStride,
+                                   const uint16_t pixelOffset,
+                                   const int16_t * const filter,
+                                   const unsigned int filterWidth,
+                                   const unsigned int filterStride,
+                                   const unsigned int filterHeight,
+                                   const unsigned int nOutputs,
+                                   int64_t * const output)
+    {
+        const __m128i offset = _mm_set1_epi16((short) pixelOffset);
+        unsigned int i = 0;
+        // Blocks of 8 outputs
+        for (; i + 8 <= nOutputs; i += 8)
+        {
+            // int64 sums of outputs (0, 1), (2, 3), (4, 5) and (6, 7)
+            __m128i sum0 = _mm_setzero_si128();
+            __m128i sum1 = _mm_setzero_si128();
+            __m128i sum2 = _mm_setzero_si128();
+            __m128i sum3 = _mm_setzero_si128();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const PixelType * const imageRow = image + j * imageStride + i;
+                const int16_t * const filterRow = filter + j * filterStride;
+                // int32 sums of outputs 0-3 and 4-7 for this filter row
+                __m128i accLo = _mm_setzero_si128();
+                __m128i accHi = _mm_setzero_si128();
+                for (unsigned int k = 0; k < filterWidth; k += 2)
+                {
+                    // For an odd filter width, the last coefficient is paired
+                    // with a zero: do not read past the filter footprint.
+                    const __m128i v0 = loadPixelsSSE2(imageRow + k, offset);
+                    const __m128i v1 = k + 1 < filterWidth
+                                       ? loadPixelsSSE2(imageRow + k + 1, offset)
+                                       : v0;
+                    const __m128i c = _mm_set1_epi32(coefficientsPair(filterRow + k));
+                    accLo = _mm_add_epi32(accLo, _mm_madd_epi16(_mm_unpacklo_epi16(v0, v1), c));
+                    accHi = _mm_add_epi32(accHi, _mm_madd_epi16(_mm_unpackhi_epi16(v0, v1), c));
+                }
+                const __m128i signLo = _mm_srai_epi32(accLo, 31);
+                const __m128i signHi = _mm_srai_epi32(accHi, 31);
+                sum0 = _mm_add_epi64(sum0, _mm_unpacklo_epi32(accLo, signLo));
+                sum1 = _mm_add_epi64(sum1, _mm_unpackhi_epi32(accLo, signLo));
+                sum2 = _mm_add_epi64(sum2, _mm_unpacklo_epi32(accHi, signHi));
+                sum3 = _mm_add_epi64(sum3, _mm_unpackhi_epi32(accHi, signHi));
+            }
+            _mm_storeu_si128((__m128i *) (output + i), sum0);
+            _mm_storeu_si128((__m128i *) (output + i + 2), sum1);
+            _mm_storeu_si128((__m128i *) (output + i + 4), sum2);
+            _mm_storeu_si128((__m128i *) (output + i + 6), sum3);
+        }
+        if (i < nOutputs)
+            integerCorrelationRowScalar(image + i, imageStride, pixelOffset, filter,
+                                        filterWidth, filterStride, filterHeight,
+                                        nOutputs - i, output + i);
+    }
+
+    template <typename PixelType>
+    TARGET("avx2")
+    void integerCorrelationRowAVX2(const PixelType * const image,
+                                   const size_t imageStride,
+                                   const uint16_t pixelOffset,
+                                   const int16_t * const filter,
+                                   const unsigned int filterWidth,
+                                   const unsigned int filterStride,
+                                   const unsigned int filterHeight,
+                                   const unsigned int nOutputs,
+                                   int64_t * const output)
+    {
+        const __m256i offset = _mm256_set1_epi16((short) pixelOffset);
+        unsigned int i = 0;
+        // Blocks of 16 outputs
+        for (; i + 16 <= nOutputs; i += 16)
+        {
+            // int64 sums of outputs 0-3, 4-7, 8-11 and 12-15
+            __m256i sum0 = _mm256_setzero_si256();
+            __m256i sum1 = _mm256_setzero_si256();
+            __m256i sum2 = _mm256_setzero_si256();
+            __m256i sum3 = _mm256_setzero_si256();
+            for (unsigned int j = 0; j < filterHeight; j++)
+            {
+                const PixelType * const imageRow = image + j * imageStride + i;
+                const int16_t * const filterRow = filter + j * filterStride;
+                // int32 sums for this filter row.  As unpacking works within
+                // 128-bit lanes, accA holds outputs 0-3 and 8-11, and accB
+                // outputs 4-7 and 12-15.
+                __m256i accA = _mm256_setzero_si256();
+                __m256i accB = _mm256_setzero_si256();
+                for (unsigned int k = 0; k < filterWidth; k += 2)
+                {
+                    const __m256i v0 = loadPixelsAVX2(imageRow + k, offset);
+                    const __m256i v1 = k + 1 < filterWidth
+                                       ? loadPixelsAVX2(imageRow + k + 1, offset)
+                                       : v0;
+                    const __m256i c = _mm256_set1_epi32(coefficientsPair(filterRow + k));
+                    accA = _mm256_add_epi32(accA, _mm256_madd_epi16(_mm256_unpacklo_epi16(v0, v1), c));
+                    accB = _mm256_add_epi32(accB, _mm256_madd_epi16(_mm256_unpackhi_epi16(v0, v1), c));
+                }
+                const __m256i outputs0 = _mm256_permute2x128_si256(accA, accB, 0x20);
+                const __m256i outputs8 = _mm256_permute2x128_si256(accA, accB, 0x31);
+                sum0 = _mm256_add_epi64(sum0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(outputs0)));
+                sum1 = _mm256_add_epi64(sum1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(outputs0, 1)));
+                sum2 = _mm256_add_epi64(sum2, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(outputs8)));
+                sum3 = _mm256_add_epi64(sum3, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(outputs8, 1)));
+            }
+            _mm256_storeu_si256((__m256i *) (output + i), sum0);
+            _mm256_storeu_si256((__m256i *) (output + i + 4), sum1);
+            _mm256_storeu_si256((__m256i *) (output + i + 8), sum2);
+            _mm256_storeu_si256((__m256i *) (output + i + 12), sum3);
+        }
+        if (i < nOutputs)
+            integerCorrelationRowSSE2(image + i, imageStride, pixelOffset, filter,
+                                      filterWidth, filterStride, filterHeight,
+                                      nOutputs - i, output + i);
+    }
+
+    void integerCorrelationRowSSE2_8(const uint8_t * const image,
+                                     const size_t imageStride,
+                                     const int16_t * const filter,
+                                     const unsigned int filterWidth,
+                                     const unsigned int filterStride,
+                                     const unsigned int filterHeight,
+                                     const unsigned int nOutputs,
+                                     int64_t * const output)
+    {
+        integerCorrelationRowSSE2(image, imageStride, 0, filter,
+                                  filterWidth, filterStride, filterHeight,
+                                  nOutputs, output);
+    }
+
+    void integerCorrelationRowAVX2_8(const uint8_t * const image,
+                                     const size_t imageStride,
+                                     const int16_t * const filter,
+                                     const unsigned int filterWidth,
+                                     const unsigned int filterStride,
+                                     const unsigned int filterHeight,
+                                     const unsigned int nOutputs,
+                                     int64_t * const output)
+    {
+        integerCorrelationRowAVX2(image, imageStride, 0, filter,
+                                  filterWidth, filterStride, filterHeight,
+                                  nOutputs, output);
+    }
+
+    // Iterations of the 16-bit absolute difference kernels between two
+    // flushes of their int32 lanes, each of which gains at most 2 * 65535
+    // per iteration.
+    const size_t ABSOLUTE_DIFFERENCE_FLUSH = 16384;
+
+    TARGET("sse2")
+    uint64_t absoluteDifferenceSSE2_8(const uint8_t * const a,
+                                      const uint8_t * const b,
+                                      const size_t n)
+    {
+        __m128i sum = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *) (a + i)),
+                                                  _mm_loadu_si128((const __m128i *) (b + i))));
+        uint64_t lanes[2];
+        _mm_storeu_si128((__m128i *) lanes, sum);
+        return lanes[0] + lanes[1] + absoluteDifferenceScalar(a + i, b + i, n - i);
+    }
+
+    TARGET("avx2")
+    uint64_t absoluteDifferenceAVX2_8(const uint8_t * const a,
+                                      const uint8_t * const b,
+                                      const size_t n)
+    {
+        __m256i sum = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *) (a + i)),
+                                                        _mm256_loadu_si256((const __m256i *) (b + i))));
+        uint64_t lanes[4];
+        _mm256_storeu_si256((__m256i *) lanes, sum);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+               + absoluteDifferenceSSE2_8(a + i, b + i, n - i);
+    }
+
+    TARGET("sse2")
+    uint64_t absoluteDifferenceSSE2_16(const uint16_t * const a,
+                                       const uint16_t * const b,
+                                       const size_t n)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i sum = _mm_setzero_si128();
+        size_t i = 0;
+        while (i + 8 <= n)
+        {
+            __m128i acc = _mm_setzero_si128();
+            const size_t blockEnd = std::min(n - n % 8, i + 8 * ABSOLUTE_DIFFERENCE_FLUSH);
+            for (; i < blockEnd; i += 8)
+            {
+                const __m128i va = _mm_loadu_si128((const __m128i *) (a + i));
+                const __m128i vb = _mm_loadu_si128((const __m128i *) (b + i));
+                const __m128i d = _mm_or_si128(_mm_subs_epu16(va, vb),
+                                               _mm_subs_epu16(vb, va));
+                acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(d, zero));
+                acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(d, zero));
+            }
+            sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(acc, zero));
+            sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(acc, zero));
+        }
+        uint64_t lanes[2];
+        _mm_storeu_si128((__m128i *) lanes, sum);
+        return lanes[0] + lanes[1] + absoluteDifferenceScalar(a + i, b + i, n - i);
+    }
+
+    TARGET("avx2")
+    uint64_t absoluteDifferenceAVX2_16(const uint16_t * const a,
+                                       const uint16_t * const b,
+                                       const size_t n)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i sum = _mm256_setzero_si256();
+        size_t i = 0;
+        while (i + 16 <= n)
+        {
+            __m256i acc = _mm256_setzero_si256();
+            const size_t blockEnd = std::min(n - n % 16, i + 16 * ABSOLUTE_DIFFERENCE_FLUSH);
+            for (; i < blockEnd; i += 16)
+            {
+                const __m256i va = _mm256_loadu_si256((const __m256i *) (a + i));
+                const __m256i vb = _mm256_loadu_si256((const __m256i *) (b + i));
+                const __m256i d = _mm256_or_si256(_mm256_subs_epu16(va, vb),
+                                                  _mm256_subs_epu16(vb, va));
+                acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(d, zero));
+                acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(d, zero));
+            }
+            sum = _mm256_add_epi64(sum, _mm256_unpacklo_epi32(acc, zero));
+            sum = _mm256_add_epi64(sum, _mm256_unpackhi_epi32(acc, zero));
+        }
+        uint64_t lanes[4];
+        _mm256_storeu_si256((__m256i *) lanes, sum);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+               + absoluteDifferenceSSE2_16(a + i, b + i, n - i);
+    }
+
+    // Iterations of the centroid row kernels between two flushes of their
+    // int32 lanes of offset moments, each of which gains at most 26 * 65535
+    // per iteration (32-bit pixels of the AVX2 16-bit kernel, whose lanes
+    // hold the offsets k and k + 4 of a 128-bit half).
+    const size_t CENTROID_FLUSH = 2048;
+
+    TARGET("sse2")
+    void centroidRowSSE2_8(const uint8_t * const pixels, const size_t n,
+                           const unsigned int threshold,
+                           uint64_t * const sums)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i thresholds = _mm_set1_epi8((char) threshold);
+        const __m128i lowOffsets = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m128i highOffsets = _mm_setr_epi16(8, 9, 10, 11, 12, 13, 14, 15);
+        __m128i weight = _mm_setzero_si128();
+        __m128i moment = _mm_setzero_si128();
+        size_t i = 0;
+        while (i + 16 <= n)
+        {
+            __m128i offsetMoment = _mm_setzero_si128();
+            const size_t blockEnd = std::min(n - n % 16, i + 16 * CENTROID_FLUSH);
+            for (; i < blockEnd; i += 16)
+            {
+                const __m128i w = _mm_subs_epu8(_mm_loadu_si128((const __m128i *) (pixels + i)),
+                                                thresholds);
+                const __m128i w64 = _mm_sad_epu8(w, zero);
+                weight = _mm_add_epi64(weight, w64);
+                moment = _mm_add_epi64(moment, _mm_mul_epu32(w64, _mm_set1_epi32((int) i)));
+                offsetMoment = _mm_add_epi32(offsetMoment,
+                                             _mm_madd_epi16(_mm_unpacklo_epi8(w, zero), lowOffsets));
+                offsetMoment = _mm_add_epi32(offsetMoment,
+                                             _mm_madd_epi16(_mm_unpackhi_epi8(w, zero), highOffsets));
+            }
+            moment = _mm_add_epi64(moment, _mm_unpacklo_epi32(offsetMoment, zero));
+            moment = _mm_add_epi64(moment, _mm_unpackhi_epi32(offsetMoment, zero));
+        }
+        uint64_t lanes[4];
+        _mm_storeu_si128((__m128i *) lanes, weight);
+        _mm_storeu_si128((__m128i *) (lanes + 2), moment);
+        centroidRowScalar(pixels + i, n - i, threshold, sums);
+        sums[1] += lanes[2] + lanes[3] + i * sums[0];
+        sums[0] += lanes[0] + lanes[1];
+    }
+
+    TARGET("avx2")
+    void centroidRowAVX2_8(const uint8_t * const pixels, const size_t n,
+                           const unsigned int threshold,
+                           uint64_t * const sums)
+    {
+        // The 8 to 16-bit unpacks interleave within each 128-bit half.
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i thresholds = _mm256_set1_epi8((char) threshold);
+        const __m256i lowOffsets = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7,
+                                                     16, 17, 18, 19, 20, 21, 22, 23);
+        const __m256i highOffsets = _mm256_setr_epi16(8, 9, 10, 11, 12, 13, 14, 15,
+                                                      24, 25, 26, 27, 28, 29, 30, 31);
+        __m256i weight = _mm256_setzero_si256();
+        __m256i moment = _mm256_setzero_si256();
+        size_t i = 0;
+        while (i + 32 <= n)
+        {
+            __m256i offsetMoment = _mm256_setzero_si256();
+            const size_t blockEnd = std::min(n - n % 32, i + 32 * CENTROID_FLUSH);
+            for (; i < blockEnd; i += 32)
+            {
+                const __m256i w = _mm256_subs_epu8(_mm256_loadu_si256((const __m256i *) (pixels + i)),
+                                                   thresholds);
+                const __m256i w64 = _mm256_sad_epu8(w, zero);
+                weight = _mm256_add_epi64(weight, w64);
+                moment = _mm256_add_epi64(moment, _mm256_mul_epu32(w64, _mm256_set1_epi32((int) i)));
+                offsetMoment = _mm256_add_epi32(offsetMoment,
+                                                _mm256_madd_epi16(_mm256_unpacklo_epi8(w, zero), lowOffsets));
+                offsetMoment = _mm256_add_epi32(offsetMoment,
+                                                _mm256_madd_epi16(_mm256_unpackhi_epi8(w, zero), highOffsets));
+            }
+            moment = _mm256_add_epi64(moment, _mm256_unpacklo_epi32(offsetMoment, zero));
+            moment = _mm256_add_epi64(moment, _mm256_unpackhi_epi32(offsetMoment, zero));
+        }
+        uint64_t lanes[8];
+        _mm256_storeu_si256((__m256i *) lanes, weight);
+        _mm256_storeu_si256((__m256i *) (lanes + 4), moment);
+        // Against the AVX-SSE transition penalty of the tail
+        _mm256_zeroupper();
+        centroidRowSSE2_8(pixels + i, n - i, threshold, sums);
+        sums[1] += lanes[4] + lanes[5] + lanes[6] + lanes[7] + i * sums[0];
+        sums[0] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    TARGET("sse2")
+    void centroidRowSSE2_16(const uint16_t * const pixels, const size_t n,
+                            const unsigned int threshold,
+                            uint64_t * const sums)
+    {
+        // The weights of the 4 pairs of pixels of a vector are summed in the
+        // low halves of 2 int64 lanes, whose products by the index of the
+        // first pixel are taken by pmuludq.
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i thresholds = _mm_set1_epi16((short) threshold);
+        const __m128i offsets = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m128i lowHalves = _mm_set1_epi64x(0xffffffff);
+        __m128i weight = _mm_setzero_si128();
+        __m128i moment = _mm_setzero_si128();
+        size_t i = 0;
+        while (i + 8 <= n)
+        {
+            __m128i offsetMoment = _mm_setzero_si128();
+            const size_t blockEnd = std::min(n - n % 8, i + 8 * CENTROID_FLUSH);
+            for (; i < blockEnd; i += 8)
+            {
+                const __m128i w = _mm_subs_epu16(_mm_loadu_si128((const __m128i *) (pixels + i)),
+                                                 thresholds);
+                __m128i w64 = _mm_add_epi32(_mm_unpacklo_epi16(w, zero),
+                                            _mm_unpackhi_epi16(w, zero));
+                w64 = _mm_and_si128(_mm_add_epi64(w64, _mm_srli_epi64(w64, 32)), lowHalves);
+                weight = _mm_add_epi64(weight, w64);
+                moment = _mm_add_epi64(moment, _mm_mul_epu32(w64, _mm_set1_epi32((int) i)));
+                const __m128i low = _mm_mullo_epi16(w, offsets);
+                const __m128i high = _mm_mulhi_epu16(w, offsets);
+                offsetMoment = _mm_add_epi32(offsetMoment, _mm_unpacklo_epi16(low, high));
+                offsetMoment = _mm_add_epi32(offsetMoment, _mm_unpackhi_epi16(low, high));
+            }
+            moment = _mm_add_epi64(moment, _mm_unpacklo_epi32(offsetMoment, zero));
+            moment = _mm_add_epi64(moment, _mm_unpackhi_epi32(offsetMoment, zero));
+        }
+        uint64_t lanes[4];
+        _mm_storeu_si128((__m128i *) lanes, weight);
+        _mm_storeu_si128((__m128i *) (lanes + 2), moment);
+        centroidRowScalar(pixels + i, n - i, threshold, sums);
+        sums[1] += lanes[2] + lanes[3] + i * sums[0];
+        sums[0] += lanes[0] + lanes[1];
+    }
+
+    TARGET("avx2")
+    void centroidRowAVX2_16(const uint16_t * const pixels, const size_t n,
+                            const unsigned int threshold,
+                            uint64_t * const sums)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i thresholds = _mm256_set1_epi16((short) threshold);
+        const __m256i offsets = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7,
+                                                  8, 9, 10, 11, 12, 13, 14, 15);
+        const __m256i lowHalves = _mm256_set1_epi64x(0xffffffff);
+        __m256i weight = _mm256_setzero_si256();
+        __m256i moment = _mm256_setzero_si256();
+        size_t i = 0;
+        while (i + 16 <= n)
+        {
+            __m256i offsetMoment = _mm256_setzero_si256();
+            const size_t blockEnd = std::min(n - n % 16, i + 16 * CENTROID_FLUSH);
+            for (; i < blockEnd; i += 16)
+            {
+                const __m256i w = _mm256_subs_epu16(_mm256_loadu_si256((const __m256i *) (pixels + i)),
+                                                    thresholds);
+                __m256i w64 = _mm256_add_epi32(_mm256_unpacklo_epi16(w, zero),
+                                               _mm256_unpackhi_epi16(w, zero));
+                w64 = _mm256_and_si256(_mm256_add_epi64(w64, _mm256_srli_epi64(w64, 32)),
+                                       lowHalves);
+                weight = _mm256_add_epi64(weight, w64);
+                moment = _mm256_add_epi64(moment, _mm256_mul_epu32(w64, _mm256_set1_epi32((int) i)));
+                const __m256i low = _mm256_mullo_epi16(w, offsets);
+                const __m256i high = _mm256_mulhi_epu16(w, offsets);
+                offsetMoment = _mm256_add_epi32(offsetMoment, _mm256_unpacklo_epi16(low, high));
+                offsetMoment = _mm256_add_epi32(offsetMoment, _mm256_unpackhi_epi16(low, high));
+            }
+            moment = _mm256_add_epi64(moment, _mm256_unpacklo_epi32(offsetMoment, zero));
+            moment = _mm256_add_epi64(moment, _mm256_unpackhi_epi32(offsetMoment, zero));
+        }
+        uint64_t lanes[8];
+        _mm256_storeu_si256((__m256i *) lanes, weight);
+        _mm256_storeu_si256((__m256i *) (lanes + 4), moment);
+        // Against the AVX-SSE transition penalty of the tail
+        _mm256_zeroupper();
+        centroidRowSSE2_16(pixels + i, n - i, threshold, sums);
+        sums[1] += lanes[4] + lanes[5] + lanes[6] + lanes[7] + i * sums[0];
+        sums[0] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    TARGET("sse2")
+    float horizontalSum(const __m128 v)
+    {
+        float lanes[4];
+        _mm_storeu_ps(lanes, v);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    TARGET("sse2")
+    void radialSymmetryRowSSE2(const float * const gradientX,
+                               const float * const gradientY,
+                               const unsigned int n,
+                               const float y,
+                               const float centroidX,
+                               const float centroidY,
+                               const float minDistance,
+                               double * const sums)
+    {
+        const __m128 vy = _mm_set1_ps(y);
+        const __m128 dy = _mm_set1_ps(y - centroidY);
+        const __m128 dy2 = _mm_mul_ps(dy, dy);
+        const __m128 vCentroidX = _mm_set1_ps(centroidX);
+        const __m128 vMinDistance = _mm_set1_ps(minDistance);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 step = _mm_set1_ps(4.0f);
+        __m128 x = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        __m128 aa = _mm_setzero_ps(), ab = _mm_setzero_ps(), bb = _mm_setzero_ps();
+        __m128 ar = _mm_setzero_ps(), br = _mm_setzero_ps();
+        unsigned int i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128 dx = _mm_sub_ps(x, vCentroidX);
+            const __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), dy2));
+            const __m128 w = _mm_div_ps(one, _mm_max_ps(distance, vMinDistance));
+            const __m128 a = _mm_loadu_ps(gradientY + i);
+            const __m128 b = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(gradientX + i));
+            const __m128 aw = _mm_mul_ps(a, w);
+            const __m128 bw = _mm_mul_ps(b, w);
+            const __m128 r = _mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(b, vy));
+            aa = _mm_add_ps(aa, _mm_mul_ps(a, aw));
+            ab = _mm_add_ps(ab, _mm_mul_ps(b, aw));
+            bb = _mm_add_ps(bb, _mm_mul_ps(b, bw));
+            ar = _mm_add_ps(ar, _mm_mul_ps(r, aw));
+            br = _mm_add_ps(br, _mm_mul_ps(r, bw));
+            x = _mm_add_ps(x, step);
+        }
+        radialSymmetrySums(gradientX, gradientY, i, n, y, centroidX, centroidY,
+                           minDistance, sums);
+        sums[0] += horizontalSum(aa);
+        sums[1] += horizontalSum(ab);
+        sums[2] += horizontalSum(bb);
+        sums[3] += horizontalSum(ar);
+        sums[4] += horizontalSum(br);
+    }
+
+    TARGET("avx2")
+    float horizontalSum(const __m256 v)
+    {
+        return horizontalSum(_mm_add_ps(_mm256_castps256_ps128(v),
+                                        _mm256_extractf128_ps(v, 1)));
+    }
+
+    TARGET("avx2")
+    void radialSymmetryRowAVX2(const float * const gradientX,
+                               const float * const gradientY,
+                               const unsigned int n,
+                               const float y,
+                               const float centroidX,
+                               const float centroidY,
+                               const float minDistance,
+                               double * const sums)
+    {
+        const __m256 vy = _mm256_set1_ps(y);
+        const __m256 dy = _mm256_set1_ps(y - centroidY);
+        const __m256 dy2 = _mm256_mul_ps(dy, dy);
+        const __m256 vCentroidX = _mm256_set1_ps(centroidX);
+        const __m256 vMinDistance = _mm256_set1_ps(minDistance);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 step = _mm256_set1_ps(8.0f);
+        __m256 x = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        __m256 aa = _mm256_setzero_ps(), ab = _mm256_setzero_ps(), bb = _mm256_setzero_ps();
+        __m256 ar = _mm256_setzero_ps(), br = _mm256_setzero_ps();
+        unsigned int i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m256 dx = _mm256_sub_ps(x, vCentroidX);
+            const __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), dy2));
+            const __m256 w = _mm256_div_ps(one, _mm256_max_ps(distance, vMinDistance));
+            const __m256 a = _mm256_loadu_ps(gradientY + i);
+            const __m256 b = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(gradientX + i));
+            const __m256 aw = _mm256_mul_ps(a, w);
+            const __m256 bw = _mm256_mul_ps(b, w);
+            const __m256 r = _mm256_add_ps(_mm256_mul_ps(a, x), _mm256_mul_ps(b, vy));
+            aa = _mm256_add_ps(aa, _mm256_mul_ps(a, aw));
+            ab = _mm256_add_ps(ab, _mm256_mul_ps(b, aw));
+            bb = _mm256_add_ps(bb, _mm256_mul_ps(b, bw));
+            ar = _mm256_add_ps(ar, _mm256_mul_ps(r, aw));
+            br = _mm256_add_ps(br, _mm256_mul_ps(r, bw));
+            x = _mm256_add_ps(x, step);
+        }
+        const float partial[5] = {horizontalSum(aa), horizontalSum(ab), horizontalSum(bb),
+                                  horizontalSum(ar), horizontalSum(br)};
+        // Against the AVX-SSE transition penalty of the tail
+        _mm256_zeroupper();
+        radialSymmetrySums(gradientX, gradientY, i, n, y, centroidX, centroidY,
+                           minDistance, sums);
+        for (unsigned int k = 0; k < 5; k++)
+            sums[k] += partial[k];
+    }
+
+#endif // CORRTRACK_X86
+
+    // Specialized row kernels of each instruction set, for the odd filter
+    // widths from kernels::MIN_SPECIALIZED_WIDTH to
+    // kernels::MAX_SPECIALIZED_WIDTH
+#define SPECIALIZED_KERNELS(kernel) \
+    { kernel<5>, kernel<7>, kernel<9>, kernel<11>, kernel<13>, kernel<15> }
+
+    const kernels::CorrelationRowKernel correlationRowScalarKernels[] =
+        SPECIALIZED_KERNELS(correlationRowScalar);
+#ifdef CORRTRACK_X86
+    const kernels::CorrelationRowKernel correlationRowSSE2Kernels[] =
+        SPECIALIZED_KERNELS(correlationRowSSE2);
+    const kernels::CorrelationRowKernel correlationRowAVX2Kernels[] =
+        SPECIALIZED_KERNELS(correlationRowAVX2);
+    const kernels::CorrelationRowKernel correlationRowAVX512Kernels[] =
+        SPECIALIZED_KERNELS(correlationRowAVX512);
+#endif
+
+#undef SPECIALIZED_KERNELS
+}
+
+
+kernels::InstructionSet kernels::detectInstructionSet()
+{
+#ifdef CORRTRACK_X86
+    int info[4];
+    cpuid(info, 0, 0);
+    const int maxLeaf = info[0];
+    if (maxLeaf < 1)
+        return InstructionSet::Scalar;
+
+    cpuid(info, 1, 0);
+    const bool hasSSE2 = (info[3] & (1 << 26)) != 0;
+    const bool hasFMA = (info[2] & (1 << 12)) != 0;
+    const bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+    const bool hasAVX = (info[2] & (1 << 28)) != 0;
+
+    bool hasAVX2 = false;
+    bool hasAVX512F = false;
+    if (maxLeaf >= 7)
+    {
+        cpuid(info, 7, 0);
+        hasAVX2 = (info[1] & (1 << 5)) != 0;
+        hasAVX512F = (info[1] & (1 << 16)) != 0;
+    }
+
+    // The OS must also save the YMM (and ZMM) registers on context switches.
+    uint64_t xcr0 = 0;
+    if (hasOSXSAVE)
+        xcr0 = xgetbv(0);
+    const bool osSavesYMM = (xcr0 & 0x06) == 0x06;
+    const bool osSavesZMM = (xcr0 & 0xe6) == 0xe6;
+
+    if (hasAVX512F && osSavesZMM)
+        return InstructionSet::AVX512;
+    if (hasAVX && hasAVX2 && hasFMA && osSavesYMM)
+        return InstructionSet::AVX2;
+    if (hasSSE2)
+        return InstructionSet::SSE2;
+#endif
+    return InstructionSet::Scalar;
+}
+
+const char* kernels::instructionSetName(const InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case InstructionSet::SSE2:
+        return "SSE2";
+    case InstructionSet::AVX2:
+        return "AVX2";
+    case InstructionSet::AVX512:
+        return "AVX-512";
+    default:
+        return "scalar";
+    }
+}
+
+kernels::CorrelationRowKernel kernels::correlationRowKernel(const InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#ifdef CORRTRACK_X86
+    case InstructionSet::SSE2:
+        return correlationRowSSE2<0>;
+    case InstructionSet::AVX2:
+        return correlationRowAVX2<0>;
+    case InstructionSet::AVX512:
+        return correlationRowAVX512<0>;
+#endif
+    default:
+        return correlationRowScalar<0>;
+    }
+}
+
+kernels::CorrelationRowKernel kernels::correlationRowKernel(const InstructionSet instructionSet,
+                                                            const unsigned int filterWidth)
+{
+    if (filterWidth < MIN_SPECIALIZED_WIDTH || filterWidth > MAX_SPECIALIZED_WIDTH
+            || filterWidth % 2 == 0)
+        return correlationRowKernel(instructionSet);
+    const unsigned int index = (filterWidth - MIN_SPECIALIZED_WIDTH) / 2;
+    switch (instructionSet)
+    {
+#ifdef CORRTRACK_X86
+    case InstructionSet::SSE2:
+        return correlationRowSSE2Kernels[index];
+    case InstructionSet::AVX2:
+        return correlationRowAVX2Kernels[index];
+    case InstructionSet::AVX512:
+        return correlationRowAVX512Kernels[index];
+#endif
+    default:
+        return correlationRowScalarKernels[index];
+    }
+}
+
+kernels::FloatCorrelationRowKernel kernels::floatCorrelationRowKernel(const InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#ifdef CORRTRACK_X86
+    case InstructionSet::SSE2:
+        return floatCorrelationRowSSE2;
+    case InstructionSet::AVX2:
+        return floatCorrelationRowAVX2;
+    case InstructionSet::AVX512:
+        return floatCorrelationRowAVX512;
+#endif
+    default:
+        return floatCorrelationRowScalar;
+    }
+}
+
+kernels::SparseCorrelationRowKernel kernels::sparseCorrelationRowKernel(const InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#ifdef CORRTRACK_X86
+    case InstructionSet::SSE2:
+        return sparseCorrelationRowSSE2;
+    case InstructionSet::AVX2:
+        return sparseCorrelationRowAVX2;
+    case InstructionSet::AVX512:
+        return sparseCorrelationRowAVX512;
+#endif
+    default:
+        return sparseCorrelationRowScalar;
+    }
+}
+
+kernels::IntegerCorrelationRowKernel8 kernels::integerCorrelationRowKernel8(const InstructionSet instructionSet)
+{
+    // There is no AVX-512 variant: the AVX2 one is used instead.
+    switch (instructionSet)
+    {
+#ifdef CORRTRACK_X86
+    case InstructionSet::SSE2:
+        return integerCorrelationRowSSE2_8;
+    case InstructionSet::AVX2:
+    case InstructionSet::AVX512:
+        return integerCorrelationRowAVX2_8;
+#endif
+    default:
+        return integerCorrelationRowScalar8;
+    }
+}
+
+kernels::IntegerCorrelationRowKernel16 kernels::integerCorrelationRowKernel16(const InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#ifdef CORRTRACK_X86
+    case InstructionSet::SSE2:
+        return integerCorrelationRowSSE2<uint16_t>;
+    case InstructionSet::AVX2:
+    case InstructionSet::AVX512:
+        return integerCorrelationRowAVX2<uint16_t>;
+#endif
+    default:
+        return integerCorrelationRowScalar<uint16_t>;
+    }
+}
+
+kernels::AbsoluteDifferenceKernel8 kernels::absoluteDifferenceKernel8(const InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#ifdef CORRTRACK_X86
+    case InstructionSet::SSE2:
+        return absoluteDifferenceSSE2_8;
+    case InstructionSet::AVX2:
+    case InstructionSet::AVX512:
+        return absoluteDifferenceAVX2_8;
+#endif
+    default:
+        return absoluteDifferenceScalar<uint8_t>;
+    }
+}
+
+kernels::AbsoluteDifferenceKernel16 kernels::absoluteDifferenceKernel16(const InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#ifdef CORRTRACK_X86
+    case InstructionSet::SSE2:
+        return absoluteDifferenceSSE2_16;
+    case InstructionSet::AVX2:
+    case InstructionSet::AVX512:
+        return absoluteDifferenceAVX2_16;
+#endif
+    default:
+        return absoluteDifferenceScalar<uint16_t>;
+    }
+}
+
+kernels::CentroidRowKernel8 kernels::centroidRowKernel8(const InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#ifdef CORRTRACK_X86
+    case InstructionSet::SSE2:
+        return centroidRowSSE2_8;
+    case InstructionSet::AVX2:
+    case InstructionSet::AVX512:
+        return centroidRowAVX2_8;
+#endif
+    default:
+        return centroidRowScalar<uint8_t>;
+    }
+}
+
+kernels::CentroidRowKernel16 kernels::centroidRowKernel16(const InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#ifdef CORRTRACK_X86
+    case InstructionSet::SSE2:
+        return centroidRowSSE2_16;
+    case InstructionSet::AVX2:
+    case InstructionSet::AVX512:
+        return centroidRowAVX2_16;
+#endif
+    default:
+        return centroidRowScalar<uint16_t>;
+    }
+}
+
+kernels::RadialSymmetryRowKernel kernels::radialSymmetryRowKernel(const InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+#ifdef CORRTRACK_X86
+    case InstructionSet::SSE2:
+        return radialSymmetryRowSSE2;
+    case InstructionSet::AVX2:
+    case InstructionSet::AVX512:
+        return radialSymmetryRowAVX2;
+#endif
+    default:
+        return radialSymmetryRowScalar;
+    }
+}
+
+const kernels::InstructionSet kernels::instructionSet = kernels::detectInstructionSet();
+const kernels::CorrelationRowKernel kernels::correlationRow = kernels::correlationRowKernel(kernels::instructionSet);
+const kernels::FloatCorrelationRowKernel kernels::floatCorrelationRow = kernels::floatCorrelationRowKernel(kernels::instructionSet);
+const kernels::SparseCorrelationRowKernel kernels::sparseCorrelationRow = kernels::sparseCorrelationRowKernel(kernels::instructionSet);
+const kernels::IntegerCorrelationRowKernel8 kernels::integerCorrelationRow8 = kernels::integerCorrelationRowKernel8(kernels::instructionSet);
+const kernels::IntegerCorrelationRowKernel16 kernels::integerCorrelationRow16 = kernels::integerCorrelationRowKernel16(kernels::instructionSet);
+const kernels::AbsoluteDifferenceKernel8 kernels::absoluteDifference8 = kernels::absoluteDifferenceKernel8(kernels::instructionSet);
+const kernels::AbsoluteDifferenceKernel16 kernels::absoluteDifference16 = kernels::absoluteDifferenceKernel16(kernels::instructionSet);
+const kernels::CentroidRowKernel8 kernels::centroidRow8 = kernels::centroidRowKernel8(kernels::instructionSet);
+const kernels::CentroidRowKernel16 kernels::centroidRow16 = kernels::centroidRowKernel16(kernels::instructionSet);
+const kernels::RadialSymmetryRowKernel kernels::radialSymmetryRow = kernels::radialSymmetryRowKernel(kernels::instructionSet);
@@ -0,0 +1,215 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Low-level correlation kernels.
+//
+// A row kernel computes nOutputs consecutive values of one row of a
+// correlation map:
+//
+//   output[i] = sum_{j, k} image[j * imageStride + i + k] * filter[j * filterWidth + k]
+//
+// for 0 <= j < filterHeight and 0 <= k < filterWidth.  image points to the
+// top-left pixel of the filter footprint of the first output value.
+//
+// The SIMD variants vectorize over neighbouring output values, so that each
+// filter coefficient is broadcast once and reused for several outputs kept in
+// registers.  Each output value is accumulated in the same order as in the
+// scalar kernel.  The SSE2 kernel therefore gives bit-identical results, while
+// the AVX2 and AVX-512 kernels use fused multiply-adds, whose results differ
+// from the scalar ones by at most filterWidth * filterHeight * 2^-52 times
+// sum |image * filter| (in practice, a few units in the last place).
+//
+// The row kernels are also specialized for the odd filter widths from
+// MIN_SPECIALIZED_WIDTH to MAX_SPECIALIZED_WIDTH, with the loops over the
+// coefficients of a filter row fully unrolled.  They accumulate in the same
+// order as the generic kernel of the same instruction set, and give the same
+// results.  Wider filters gain nothing from the unrolling.
+//
+// The single-precision row kernels compute the same sums on float images and
+// filters, with twice as many outputs per vector.  Each filter row is
+// accumulated in float, and the rows are summed in double, so that the
+// rounding errors grow with the filter width only.  The SSE2 kernel gives the
+// same results as the scalar one.
+//
+// The sparse row kernels compute the same sums over the coefficients of a
+// sparse filter only, stored as horizontal runs of consecutive coefficients:
+// run r covers runs[r].length coefficients from (runs[r].x, runs[r].y) of the
+// filter footprint, whose weights follow those of the previous runs.  The runs
+// are vectorized over neighbouring outputs as the full rows are above.
+//
+// The integer row kernels compute the same sums directly on 8 or 16-bit
+// pixels, with a filter quantized to int16 whose rows are padded with zeros to
+// an even filterStride.  They use widening multiply-adds (pmaddwd) on pairs of
+// neighbouring filter coefficients, accumulate each filter row in int32 and the
+// sum of the rows in int64.  The caller must quantize the filter so that
+// filterStride * max|filter| * max|pixel| < 2^31.  16-bit pixels are read as
+// (pixel xor pixelOffset) interpreted as int16: pixelOffset must be 0x8000 if
+// pixels may exceed 32767, and 0 otherwise.  Results are exact.
+//
+// The absolute difference kernels compute the exact sum of |a[i] - b[i]| for
+// 0 <= i < n, to detect whether a region of a frame changed.  The 8-bit SIMD
+// variants use psadbw.  The 16-bit ones take |a - b| as the sum of the two
+// saturated differences and accumulate it in int32 lanes, which are flushed to
+// int64 often enough not to overflow.
+//
+// The centroid row kernels compute, for the weights w[i] = max(pixels[i] -
+// threshold, 0) with 0 <= i < n, the exact sums of w[i] in sums[0] and of
+// i * w[i] in sums[1], from which the intensity-weighted centroid of a window
+// above its background follows.  The SIMD variants take the weights as
+// saturated differences.  The 8-bit ones sum them with psadbw, and their
+// moments as the product of each sum by the index of its first pixel plus the
+// pmaddwd of the weights by their offsets from it.  The 16-bit ones form the
+// latter with 16-bit multiplies.  The int32 lanes of the offsets are flushed
+// to int64 often enough not to overflow.
+//
+// The radial symmetry row kernels sum the terms of the normal equations of
+// RadialSymmetryLocalizer over a row of n gradients (gx, gy) at x = i and the
+// given y: with a = gy, b = -gx, r = a x + b y and the weight w = 1 /
+// max(sqrt((x - cx)^2 + (y - cy)^2), minDistance), they set sums to the sums
+// of a^2 w, a b w, b^2 w, a r w and b r w.  They are computed in float, and
+// the SIMD variants sum them in a different order from the scalar kernel, so
+// that the results differ by a few float roundings.
+namespace kernels
+{
+    const unsigned int MIN_SPECIALIZED_WIDTH = 5;
+    const unsigned int MAX_SPECIALIZED_WIDTH = 15;
+
+    enum class InstructionSet
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+        AVX512,
+    };
+
+    typedef void (*CorrelationRowKernel)(const double * const image,
+                                         const size_t imageStride,
+                                         const double * const filter,
+                                         const unsigned int filterWidth,
+                                         const unsigned int filterHeight,
+                                         const unsigned int nOutputs,
+                                         double * const output);
+
+    typedef void (*FloatCorrelationRowKernel)(const float * const image,
+                                              const size_t imageStride,
+                                              const float * const filter,
+                                              const unsigned int filterWidth,
+                                              const unsigned int filterHeight,
+                                              const unsigned int nOutputs,
+                                              double * const output);
+
+    struct FilterRun
+    {
+        unsigned int x;
+        unsigned int y;
+        unsigned int length;
+    };
+
+    typedef void (*SparseCorrelationRowKernel)(const double * const image,
+                                               const size_t imageStride,
+                                               const FilterRun * const runs,
+                                               const unsigned int nRuns,
+                                               const double * const weights,
+                                               const unsigned int nOutputs,
+                                               double * const output);
+
+    typedef void (*IntegerCorrelationRowKernel8)(const uint8_t * const image,
+                                                 const size_t imageStride,
+                                                 const int16_t * const filter,
+                                                 const unsigned int filterWidth,
+                                                 const unsigned int filterStride,
+                                                 const unsigned int filterHeight,
+                                                 const unsigned int nOutputs,
+                                                 int64_t * const output);
+
+    typedef void (*IntegerCorrelationRowKernel16)(const uint16_t * const image,
+                                                  const size_t imageStride,
+                                                  const uint16_t pixelOffset,
+                                                  const int16_t * const filter,
+                                                  const unsigned int filterWidth,
+                                                  const unsigned int filterStride,
+                                                  const unsigned int filterHeight,
+                                                  const unsigned int nOutputs,
+                                                  int64_t * const output);
+
+    typedef uint64_t (*AbsoluteDifferenceKernel8)(const uint8_t * const a,
+                                                  const uint8_t * const b,
+                                                  const size_t n);
+
+    typedef uint64_t (*AbsoluteDifferenceKernel16)(const uint16_t * const a,
+                                                   const uint16_t * const b,
+                                                   const size_t n);
+
+    typedef void (*CentroidRowKernel8)(const uint8_t * const pixels,
+                                       const size_t n,
+                                       const unsigned int threshold,
+                                       uint64_t * const sums);
+
+    typedef void (*CentroidRowKernel16)(const uint16_t * const pixels,
+                                        const size_t n,
+                                        const unsigned int threshold,
+                                        uint64_t * const sums);
+
+    typedef void (*RadialSymmetryRowKernel)(const float * const gradientX,
+                                            const float * const gradientY,
+                                            const unsigned int n,
+                                            const float y,
+                                            const float centroidX,
+                                            const float centroidY,
+                                            const float minDistance,
+                                            double * const sums);
+
+    InstructionSet detectInstructionSet();
+    const char* instructionSetName(const InstructionSet instructionSet);
+    CorrelationRowKernel correlationRowKernel(const InstructionSet instructionSet);
+    CorrelationRowKernel correlationRowKernel(const InstructionSet instructionSet,
+                                              const unsigned int filterWidth);
+    FloatCorrelationRowKernel floatCorrelationRowKernel(const InstructionSet instructionSet);
+    SparseCorrelationRowKernel sparseCorrelationRowKernel(const InstructionSet instructionSet);
+    IntegerCorrelationRowKernel8 integerCorrelationRowKernel8(const InstructionSet instructionSet);
+    IntegerCorrelationRowKernel16 integerCorrelationRowKernel16(const InstructionSet instructionSet);
+    AbsoluteDifferenceKernel8 absoluteDifferenceKernel8(const InstructionSet instructionSet);
+    AbsoluteDifferenceKernel16 absoluteDifferenceKernel16(const InstructionSet instructionSet);
+    CentroidRowKernel8 centroidRowKernel8(const InstructionSet instructionSet);
+    CentroidRowKernel16 centroidRowKernel16(const InstructionSet instructionSet);
+    RadialSymmetryRowKernel radialSymmetryRowKernel(const InstructionSet instructionSet);
+
+    // Best instruction set supported by the CPU and the OS, and the matching
+    // kernels.  They are set once at startup.
+    extern const InstructionSet instructionSet;
+    extern const CorrelationRowKernel correlationRow;
+    extern const FloatCorrelationRowKernel floatCorrelationRow;
+    extern const SparseCorrelationRowKernel sparseCorrelationRow;
+    extern const IntegerCorrelationRowKernel8 integerCorrelationRow8;
+    extern const IntegerCorrelationRowKernel16 integerCorrelationRow16;
+    extern const AbsoluteDifferenceKernel8 absoluteDifference8;
+    extern const AbsoluteDifferenceKernel16 absoluteDifference16;
+    extern const CentroidRowKernel8 centroidRow8;
+    extern const CentroidRowKernel16 centroidRow16;
+    extern const RadialSymmetryRowKernel radialSymmetryRow;
+}
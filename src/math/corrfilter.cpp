@@ -19,27 +19,49 @@
  */
 
 
+#include <algorithm>
+#include <stdexcept>
 #include <string>
+#include <cmath>
 #include <fstream>
 #include <vector>
 #include <boost/algorithm/string.hpp>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_linalg.h>
 #include "corrfilter.h"
+#include "math/fft2d.h"
 #include "io/exceptions/ioexception.h"
 
 
+namespace
+{
+    // Longest gap between two runs of significant coefficients of a row that
+    // is kept in a single run: a few more multiply-adds cost less than the
+    // start of a run.
+    const unsigned int MAX_RUN_GAP = 2;
+}
+
+
 const char* CorrFilter::CorrFilterFormatException::what() const noexcept
 {
     return "Filter file format error.";
 }
 
 CorrFilter::CorrFilter()
-    : filter{nullptr}
+    : spectrumWidth{0}, spectrumHeight{0},
+      width{0}, height{0}, nTemplates{0},
+      filter{nullptr}
 {}
 
 void CorrFilter::setFilter(const std::string fileName)
 {
+    // The file may hold a bank of templates of the same size, separated by
+    // empty lines.  It is read and checked before any member is changed, so
+    // that the previous filter is kept if it cannot be loaded.
     std::vector<std::string> elems;
-    filterFileName = fileName;
+    std::vector<unsigned int> templateHeights;
+    unsigned int newWidth = 0;
     try
     {
         std::ifstream file;
@@ -48,20 +70,29 @@ void CorrFilter::setFilter(const std::string fileName)
         file.exceptions(std::ios::badbit);
         std::string line;
         bool first = true;
+        bool isSeparated = true;
         while (std::getline(file, line))
         {
+            if (boost::algorithm::trim_copy(line).empty())
+            {
+                isSeparated = true;
+                continue;
+            }
+            if (isSeparated)
+                templateHeights.push_back(0);
+            isSeparated = false;
+            templateHeights.back()++;
             std::vector<std::string> columns;
             boost::algorithm::split(columns, line, boost::is_any_of("\t"));
             if (first)
             {
-                width = (unsigned int) (columns.size());
+                newWidth = (unsigned int) (columns.size());
                 first = false;
             }
             // Append columns to elems
             elems.reserve(elems.size() + columns.size()); // preallocate memory
             elems.insert(elems.end(), columns.begin(), columns.end());
         }
-        height = (unsigned int) (elems.size()) / width;
         file.close();
     }
     catch (const std::ios_base::failure)
@@ -69,23 +100,178 @@ void CorrFilter::setFilter(const std::string fileName)
         throw IOException();
     }
 
-    // Build correlation filter array from elems
+    const unsigned int newHeight = templateHeights.empty() ? 0 : templateHeights[0];
+    const unsigned int newNTemplates = (unsigned int) templateHeights.size();
+    for (const unsigned int templateHeight : templateHeights)
+        if (templateHeight != newHeight)
+            throw CorrFilterFormatException();
+    if (newNTemplates == 0
+            || elems.size() != (size_t) newNTemplates * newWidth * newHeight)
+        throw CorrFilterFormatException();
+
+    std::vector<double> values(elems.size());
     try
     {
-        filter = new double[width * height];
+        for (size_t i = 0; i < elems.size(); i++)
+            values[i] = stod(elems[i]);
+    }
+    catch (std::invalid_argument)
+    {
+        throw CorrFilterFormatException();
+    }
+    catch (const std::out_of_range&)
+    {
+        throw CorrFilterFormatException();
+    }
+
+    // Build correlation filter array from the values, and swap it in
+    double * const newFilter = new double[values.size()];
+    std::copy(values.begin(), values.end(), newFilter);
+    delete[] filter;
+    filter = newFilter;
+    filterFileName = fileName;
+    width = newWidth;
+    height = newHeight;
+    nTemplates = newNTemplates;
+    spectrum.clear();
+    spectrumWidth = 0;
+    spectrumHeight = 0;
+
+    const size_t n = (size_t) width * height;
+    means.resize(nTemplates);
+    deviations.resize(nTemplates);
+    for (unsigned int t = 0; t < nTemplates; t++)
+    {
+        const double * const values = filter + t * n;
+        double templateMean = 0.0;
+        for (size_t i = 0; i < n; i++)
+            templateMean += values[i];
+        templateMean /= n;
+        double templateDeviation = 0.0;
+        for (size_t i = 0; i < n; i++)
+            templateDeviation += (values[i] - templateMean) * (values[i] - templateMean);
+        means[t] = templateMean;
+        deviations[t] = std::sqrt(templateDeviation);
+    }
+
+    decompose();
+}
+
+void CorrFilter::decompose()
+{
+    // Sets the separable terms of the filter from its SVD.  GSL needs at
+    // least as many rows as columns, so that a wide filter is decomposed
+    // transposed.
+    const bool isTransposed = width > height;
+    const unsigned int nRows = isTransposed ? width : height;
+    const unsigned int nColumns = isTransposed ? height : width;
+    gsl_matrix *U = gsl_matrix_alloc(nRows, nColumns);
+    gsl_matrix *V = gsl_matrix_alloc(nColumns, nColumns);
+    gsl_vector *S = gsl_vector_alloc(nColumns);
+    gsl_vector *work = gsl_vector_alloc(nColumns);
+    for (unsigned int y = 0; y < height; y++)
+        for (unsigned int x = 0; x < width; x++)
+        {
+            if (isTransposed)
+                gsl_matrix_set(U, x, y, filter[width * y + x]);
+            else
+                gsl_matrix_set(U, y, x, filter[width * y + x]);
+        }
+    gsl_linalg_SV_decomp(U, V, S, work);
+
+    singularValues.resize(nColumns);
+    columnVectors.resize((size_t) nColumns * height);
+    rowVectors.resize((size_t) nColumns * width);
+    for (unsigned int t = 0; t < nColumns; t++)
+    {
+        const double s = gsl_vector_get(S, t);
+        singularValues[t] = s;
         for (unsigned int y = 0; y < height; y++)
+            columnVectors[(size_t) t * height + y] = s * (isTransposed ? gsl_matrix_get(V, y, t)
+                                                                       : gsl_matrix_get(U, y, t));
+        for (unsigned int x = 0; x < width; x++)
+            rowVectors[(size_t) t * width + x] = isTransposed ? gsl_matrix_get(U, x, t)
+                                                              : gsl_matrix_get(V, x, t);
+    }
+
+    gsl_matrix_free(U);
+    gsl_matrix_free(V);
+    gsl_vector_free(S);
+    gsl_vector_free(work);
+}
+
+void CorrFilter::sparseRuns(const double threshold,
+                            std::vector<kernels::FilterRun> &runs,
+                            std::vector<double> &weights) const
+{
+    // Sparse form of the filter for kernels::sparseCorrelationRow: the
+    // coefficients whose magnitude is above threshold times the largest one,
+    // grouped in horizontal runs.  With a threshold of 0, only the zeros are
+    // dropped and the correlation is unchanged.
+    runs.clear();
+    weights.clear();
+    double largest = 0.0;
+    for (size_t i = 0; i < (size_t) width * height; i++)
+        largest = std::max(largest, std::abs(filter[i]));
+    const double minMagnitude = threshold * largest;
+    for (unsigned int y = 0; y < height; y++)
+    {
+        const double * const row = filter + (size_t) width * y;
+        unsigned int x = 0;
+        while (x < width)
         {
-            for (unsigned int x = 0; x < width; x++)
+            if (row[x] == 0.0 || std::abs(row[x]) <= minMagnitude)
+            {
+                x++;
+                continue;
+            }
+            // Extend the run up to the last significant coefficient that
+            // follows a short enough gap.
+            unsigned int end = x + 1;
+            unsigned int next = end;
+            while (next < width && next - end <= MAX_RUN_GAP)
             {
-                unsigned int i = width * y + x;
-                filter[i] = stod(elems[i]);
+                if (row[next] != 0.0 && std::abs(row[next]) > minMagnitude)
+                    end = next + 1;
+                next++;
             }
+            runs.push_back(kernels::FilterRun{x, y, end - x});
+            weights.insert(weights.end(), row + x, row + end);
+            x = end;
         }
     }
-    catch (std::invalid_argument)
+}
+
+unsigned int CorrFilter::separableRank(const double energyFraction) const
+{
+    // Smallest number of separable terms whose sum keeps energyFraction of
+    // the energy (the sum of the squares) of the filter.
+    double energy = 0.0;
+    for (const double s : singularValues)
+        energy += s * s;
+    double kept = 0.0;
+    unsigned int rank = 0;
+    while (rank < singularValues.size() && kept < energyFraction * energy)
     {
-        throw CorrFilterFormatException();
+        kept += singularValues[rank] * singularValues[rank];
+        rank++;
     }
+    return std::max(rank, 1u);
+}
+
+double CorrFilter::separableError(const unsigned int rank) const
+{
+    // Norm of the difference between the filter and the sum of its first
+    // rank separable terms, relative to the norm of the filter.
+    double energy = 0.0;
+    double dropped = 0.0;
+    for (size_t t = 0; t < singularValues.size(); t++)
+    {
+        energy += singularValues[t] * singularValues[t];
+        if (t >= rank)
+            dropped += singularValues[t] * singularValues[t];
+    }
+    return energy > 0.0 ? std::sqrt(dropped / energy) : 0.0;
 }
 
 bool CorrFilter::isFilterSet() const
@@ -105,3 +291,24 @@ double CorrFilter::getFilterValue(const unsigned int x,
     return filter[i];
 }
 
+
+const double* CorrFilter::getSpectrum(const unsigned int fftWidth,
+                                      const unsigned int fftHeight) const
+{
+    // Returns the 2D FFT (packed complex array) of the filter zero-padded to
+    // fftWidth x fftHeight.  It is computed once and cached until the filter
+    // or the requested size changes.
+
+    if (fftWidth != spectrumWidth || fftHeight != spectrumHeight)
+    {
+        spectrum.assign(2 * (size_t) fftWidth * fftHeight, 0.0);
+        for (unsigned int y = 0; y < height; y++)
+            for (unsigned int x = 0; x < width; x++)
+                spectrum[2 * ((size_t) y * fftWidth + x)] = filter[width * y + x];
+        FFT2D fft(fftWidth, fftHeight);
+        fft.forward(spectrum.data(), height);
+        spectrumWidth = fftWidth;
+        spectrumHeight = fftHeight;
+    }
+    return spectrum.data();
+}
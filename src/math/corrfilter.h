@@ -23,11 +23,21 @@
 
 
 #include <string>
+#include <vector>
 #include <exception>
+#include "math/correlationkernels.h"
 
 
 class CorrFilter
 {
+private:
+    // Cached FFT of the zero-padded filter
+    mutable std::vector<double> spectrum;
+    mutable unsigned int spectrumWidth;
+    mutable unsigned int spectrumHeight;
+
+    void decompose();
+
 public:
     CorrFilter();
     ~CorrFilter();
@@ -39,11 +49,34 @@ public:
     void setFilter(const std::string fileName);
     bool isFilterSet() const;
     double getFilterValue(const unsigned int x, const unsigned int y) const;
+    const double* getSpectrum(const unsigned int fftWidth,
+                              const unsigned int fftHeight) const;
+    void sparseRuns(const double threshold,
+                    std::vector<kernels::FilterRun> &runs,
+                    std::vector<double> &weights) const;
+    unsigned int separableRank(const double energyFraction) const;
+    double separableError(const unsigned int rank) const;
 
     std::string filterFileName;
     unsigned int width;
     unsigned int height;
+    // Number of templates of a filter bank, stored one after the other in
+    // filter.  The other members describe the first one only.
+    unsigned int nTemplates;
     double *filter;
+    // Mean of each template, and norm of the template minus its mean, used
+    // to normalize the correlation
+    std::vector<double> means;
+    std::vector<double> deviations;
+    // Singular value decomposition of the filter, as a sum of separable
+    // terms in decreasing order:
+    //
+    //   filter[y * width + x] = sum_t columnVectors[t * height + y] * rowVectors[t * width + x]
+    //
+    // The singular values are included in columnVectors.
+    std::vector<double> singularValues;
+    std::vector<double> columnVectors;
+    std::vector<double> rowVectors;
 
     class CorrFilterFormatException : public std::exception
     {
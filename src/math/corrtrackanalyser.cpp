@@ -19,40 +19,229 @@
  */
 
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem.hpp>
-#include <gsl/gsl_vector.h>
-#include <gsl/gsl_matrix.h>
-#include <gsl/gsl_multifit.h>
 #include "constants.h"
 #include "corrtrackanalyser.h"
+#include "io/exceptions/ioexception.h"
 #include "movie/movie.h"
 #include "math/corrfilter.h"
+#include "math/correlationkernels.h"
+#include "math/fftcorrelator.h"
+#include "math/framecorrelator.h"
+#include "math/imageview.h"
+#include "math/integercorrelator.h"
+#include "math/centroidlocalizer.h"
+#include "math/radialsymmetrylocalizer.h"
+#include "math/quadraticfit.h"
+#include "math/threadpool.h"
+#include "math/upsampleddft.h"
 #include "math/imaged.h"
 
 
+namespace
+{
+    // Number of frames tracked by the worker threads between two writes of
+    // the output file.
+    const size_t FRAMES_PER_BLOCK = 256;
+
+    // Minimum number of chunks per worker thread in chunked mode.
+    const size_t CHUNKS_PER_THREAD = 4;
+
+    // In the pyramid search, distance (in pixels of each level) between the
+    // peak position predicted from the coarser level and the searched
+    // positions.  The 2 x 2 binning moves the peak by up to one pixel of the
+    // finer level, and its rounding by one more.
+    const unsigned int PYRAMID_SEARCH_RADIUS = 2;
+
+    // With adaptive windows, a correlation peak lower than this fraction of
+    // the previous one is searched again in a larger window.
+    const double PEAK_QUALITY_DROP = 0.5;
+
+    // Cost of the sparse kernels, relative to that of the dense ones per
+    // filter coefficient, for each coefficient they keep and each run of
+    // coefficients.  Fitted to the timings of bench/sparsebench.cpp, for
+    // filters of 11 x 11 to 31 x 31 coefficients in rings or scattered, with
+    // the scalar to AVX-512 kernels (from 1.0 to 1.5 per coefficient and 1.7
+    // to 4.0 per run).
+    const double SPARSE_COEFFICIENT_COST = 1.3;
+    const double SPARSE_RUN_COST = 3.0;
+    // Cost of the single-precision direct kernels relative to the double
+    // ones: their vectors hold twice as many values.
+    const double SINGLE_PRECISION_COST = 0.5;
+
+    // Number of rows of the correlation of the frame processed by each task
+    // of the particle detection.
+    const unsigned int DETECTION_BAND_HEIGHT = 64;
+
+    // Binary file in the temporary directory, removed with the object.
+    struct TemporaryFile
+    {
+        TemporaryFile()
+            : path(boost::filesystem::temp_directory_path()
+                   / boost::filesystem::unique_path("corrtrack-%%%%-%%%%.tmp")),
+              stream(path.string(), std::ios::in | std::ios::out
+                                    | std::ios::binary | std::ios::trunc)
+        {
+            if (!stream.is_open())
+                throw IOException();
+        }
+
+        ~TemporaryFile()
+        {
+            stream.close();
+            boost::system::error_code error;
+            boost::filesystem::remove(path, error);
+        }
+
+        TemporaryFile(const TemporaryFile&) =delete;
+        TemporaryFile& operator=(const TemporaryFile&) =delete;
+
+        const boost::filesystem::path path;
+        std::fstream stream;
+    };
+
+    PointD shifted(const PointD position, const PointD shift)
+    {
+        return PointD(position.x + shift.x, position.y + shift.y);
+    }
+
+    bool isLocalMaximum(const double * const values, const size_t stride,
+                        const unsigned int width, const unsigned int height,
+                        const unsigned int u, const unsigned int v,
+                        const unsigned int radius)
+    {
+        // Whether values[v * stride + u] is the highest of the values of the
+        // width x height array within radius along each axis.  Of equal
+        // values, only the first one in raster order is a maximum, so that a
+        // plateau gives a single one.
+        const double value = values[(size_t) v * stride + u];
+        const unsigned int iMin = u > radius ? u - radius : 0;
+        const unsigned int jMin = v > radius ? v - radius : 0;
+        const unsigned int iMax = std::min(u + radius, width - 1);
+        const unsigned int jMax = std::min(v + radius, height - 1);
+        for (unsigned int j = jMin; j <= jMax; j++)
+        {
+            const double * const row = values + (size_t) j * stride;
+            for (unsigned int i = iMin; i <= iMax; i++)
+            {
+                if (row[i] > value
+                        || (row[i] == value && (j < v || (j == v && i < u))))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    Point windowCentre(const PointD position)
+    {
+        // Pixel of position, where a correlation window is centred
+        return Point((unsigned int) std::max(position.x + 0.5, 0.0),
+                     (unsigned int) std::max(position.y + 0.5, 0.0));
+    }
+
+    double peakOffset(const double left, const double centre,
+                      const double right, const bool isGaussian)
+    {
+        // Offset of the maximum of the parabola through three consecutive
+        // values, from the central one.  In Gaussian mode, the parabola is
+        // fitted to their logarithms, when they are all positive (written
+        // with two logarithms instead of three).
+        double difference = left - right;
+        double curvature = left - 2.0 * centre + right;
+        if (isGaussian && left > 0.0 && centre > 0.0 && right > 0.0)
+        {
+            difference = std::log(left / right);
+            curvature = std::log(left * right / (centre * centre));
+        }
+        if (curvature >= 0.0)
+            return 0.0;
+        return 0.5 * difference / curvature;
+    }
+
+    void downsample(const std::vector<double> &input,
+                    const unsigned int width, const unsigned int height,
+                    const bool isPadded,
+                    std::vector<double> &output,
+                    unsigned int &outputWidth, unsigned int &outputHeight)
+    {
+        // Sums of the 2 x 2 blocks of input.  The incomplete blocks of the
+        // last row and column are dropped, or zero-padded if isPadded.
+        outputWidth = isPadded ? (width + 1) / 2 : width / 2;
+        outputHeight = isPadded ? (height + 1) / 2 : height / 2;
+        output.assign((size_t) outputWidth * outputHeight, 0.0);
+        for (unsigned int j = 0; j < 2 * outputHeight && j < height; j++)
+            for (unsigned int i = 0; i < 2 * outputWidth && i < width; i++)
+                output[(size_t) (j / 2) * outputWidth + i / 2] += input[(size_t) j * width + i];
+    }
+}
+
+
 CorrTrackAnalyser::CorrTrackAnalyser()
     : filterData{nullptr},
-      filterWidth{0}, filterHeight{0},
-      currImageData{nullptr},
-      currImageWidth{0}, currImageHeight{0},
+      filterWidth{0}, filterHeight{0}, nTemplates{1},
       pointsList{new std::vector<Point>()},
+      frameCorrelator{nullptr},
+      batchCorrelator{nullptr},
+      threadPool{nullptr},
+      useFFT{false},
+      useFrameFFT{false},
+      useInteger{false},
+      useBatch{false},
+      usePyramid{false},
+      useAdaptiveWindows{false},
+      footprintWidth{1}, footprintHeight{1},
+      filterRowKernel{nullptr},
+      useSinglePrecision{false},
+      isSparseDropped{false}, isSeparableDropped{false},
+      separableRank{0},
+      useSparse{false},
+      directCost{0.0},
       filter{new CorrFilter()},
       movie{new Movie()},
       windowWidth{15}, windowHeight{15},
+      adaptiveWindows{false},
       fitRadius{1.5},
-      currFrameIndex{0}
+      localizationMethod{LocalizationMethod::Correlation},
+      subPixelMethod{SubPixelMethod::QuadraticFit},
+      upsamplingFactor{100},
+      correlationMethod{CorrelationMethod::Auto},
+      normalizedCorrelation{false},
+      singlePrecision{false},
+      separableEnergy{0.0},
+      sparseThreshold{0.0},
+      chunkLength{0},
+      seedWindowWidth{45}, seedWindowHeight{45},
+      pyramidLevels{0},
+      motionModel{MotionPredictor::Model::None},
+      driftCorrection{false},
+      unchangedThreshold{0.0},
+      detectionThreshold{0.5},
+      detectionRadius{5},
+      currFrameIndex{0},
+      nAnalysedFrames{0}
 {}
 
 CorrTrackAnalyser::~CorrTrackAnalyser()
 {
     delete movie;
     if (filterData != nullptr) delete filterData;
-    if (currImageData != nullptr) delete currImageData;
 
+    for (WorkerContext *context : contexts)
+        delete context;
+    delete threadPool;
+    delete frameCorrelator;
+    delete batchCorrelator;
     delete filter;
     delete pointsList;
 }
@@ -68,6 +257,104 @@ const char* CorrTrackAnalyser::AnalyseException::what() const noexcept
     return _message.c_str();
 }
 
+CorrTrackAnalyser::WorkerContext::WorkerContext()
+    : fftCorrelator{nullptr},
+      integerCorrelator{nullptr},
+      quadraticFit{nullptr},
+      upsampledDFT{nullptr},
+      driftEstimator{nullptr},
+      localizer{nullptr},
+      templateIndex{0},
+      correlationMap{nullptr},
+      peakValue{0.0}
+{}
+
+CorrTrackAnalyser::WorkerContext::~WorkerContext()
+{
+    delete fftCorrelator;
+    delete integerCorrelator;
+    delete quadraticFit;
+    delete upsampledDFT;
+    delete driftEstimator;
+    delete localizer;
+    delete correlationMap;
+}
+
+CorrTrackAnalyser::CorrelationLocalizer::CorrelationLocalizer(const CorrTrackAnalyser * const analyser,
+                                                              WorkerContext * const context)
+    : analyser{analyser}, context{context}
+{}
+
+PointD CorrTrackAnalyser::CorrelationLocalizer::locate(const Point point,
+                                                       const size_t frameIndex,
+                                                       const unsigned int width,
+                                                       const unsigned int height)
+{
+    const PointD position = analyser->locatePeak(point, frameIndex,
+                                                 width, height, context);
+    peakPixel = context->peakPixel;
+    peakValue = context->peakValue;
+    return position;
+}
+
+CorrTrackAnalyser::TrackingState::TrackingState(const std::vector<Point> &points,
+                                                const size_t origin,
+                                                const bool isForward,
+                                                const size_t nSteps,
+                                                const size_t blockSize,
+                                                const size_t nChunks,
+                                                const MotionPredictor::Model motionModel)
+    : nPoints{points.size()}, origin{origin}, isForward{isForward},
+      nSteps{nSteps}, blockSize{blockSize}, nChunks{nChunks},
+      chunkSize{blockSize / nChunks},
+      first{0}, end{0}, nBlockChunks{0},
+      points(points),
+      measurements(points.size(), Measurement{false, 0, Point(), PointD(), 0, 0.0}),
+      samples(blockSize * points.size()),
+      chunks(points.size() * nChunks),
+      failedSteps(points.size(), nSteps),
+      failures(points.size()),
+      firstFailedStep(nSteps),
+      warnings(points.size())
+{
+    // The particles start at rest.
+    for (Point const& point : points)
+        predictors.push_back(MotionPredictor(motionModel,
+                                             PointD(point.x, point.y)));
+}
+
+size_t CorrTrackAnalyser::TrackingState::frame(const size_t step) const
+{
+    return isForward ? origin + step : origin - step;
+}
+
+PointD CorrTrackAnalyser::TrackingState::drift(const size_t step) const
+{
+    // Global drift at a step of the current block.  Past the last computed
+    // step, that of the last one.
+    if (drifts.empty())
+        return PointD(0.0, 0.0);
+    return drifts[std::min(step - first, drifts.size() - 1)];
+}
+
+bool CorrTrackAnalyser::TrackingState::isDone() const
+{
+    // Whether all the steps were tracked, or a particle was lost.
+    return first >= nSteps || firstFailedStep < nSteps;
+}
+
+void CorrTrackAnalyser::TrackingState::fail(const size_t k, const size_t step,
+                                            const std::exception_ptr failure)
+{
+    // Records that particle k was lost at the given step.
+    failedSteps[k] = step;
+    failures[k] = failure;
+    size_t firstStep = firstFailedStep;
+    while (step < firstStep
+           && !firstFailedStep.compare_exchange_weak(firstStep, step))
+    {}
+}
+
 void CorrTrackAnalyser::setMovie(std::string fileName)
 {
     movie->openMovie(fileName);
@@ -100,75 +387,402 @@ std::vector<Point>* CorrTrackAnalyser::getPoints() const
     return pointsList;
 }
 
-double CorrTrackAnalyser::correlationValue(const unsigned int i0,
-                                           const unsigned int j0) const
+void CorrTrackAnalyser::selectImage(size_t frameIndex)
+{
+    // Switch to desired frame.
+    //
+    // The frame is not converted: the correlation methods read the pixels of
+    // the regions they need from the movie frames.
+    currFrameIndex = frameIndex;
+}
+
+void CorrTrackAnalyser::calcCorrelationMap(const Point point,
+                                           const size_t frameIndex,
+                                           ImageD * const correlationMap,
+                                           WorkerContext * const context) const
+{
+    // Computes correlationMap, centred on point in the given frame.
+    //
+    // This is called concurrently by the worker threads, each with its own
+    // context.  In full-frame mode, the frame must have been correlated by
+    // correlateFrame().  The FFT and full-frame methods only apply to maps of
+    // the size of the correlation window, and the others are used for larger
+    // (seed) windows.
+    unsigned int iMin, jMin;
+    outerRegion(point, correlationMap->width, correlationMap->height,
+                filterWidth, filterHeight, iMin, jMin);
+    const bool isWindow = correlationMap->width == windowWidth
+                          && correlationMap->height == windowHeight;
+    // Calculate correlation
+    if (movie->bitsPerSample == 8)
+        correlateRegion(ImageView<uint8_t>(movie->frames8.at(frameIndex)),
+                        iMin, jMin, isWindow, correlationMap, context);
+    else
+        correlateRegion(ImageView<uint16_t>(movie->frames16.at(frameIndex)),
+                        iMin, jMin, isWindow, correlationMap, context);
+}
+
+void CorrTrackAnalyser::outerRegion(const Point point,
+                                    const unsigned int mapWidth,
+                                    const unsigned int mapHeight,
+                                    const unsigned int readWidth,
+                                    const unsigned int readHeight,
+                                    unsigned int &iMin, unsigned int &jMin) const
 {
-    // The desired frame must be loaded in currImage and currFrameIndex.
-    double correlation = 0.0;
-    const unsigned int iStart = i0 - (int)(filterWidth / 2);
-    const unsigned int jStart = j0 - (int)(filterHeight / 2);
-    for (unsigned int j = 0; j < filterHeight; j++)
+    // Top-left pixel of the region read for a map centred on point, when a
+    // region of readWidth x readHeight pixels is read around each pixel of
+    // the map (the filter for the correlation).  Throws if the region is not
+    // inside the frame.
+    const int iStart = point.x - (int)(mapWidth / 2);
+    const int jStart = point.y - (int)(mapHeight / 2);
+    // Check boundaries
+    const int i0 = iStart - (int)(readWidth / 2);
+    const int j0 = jStart - (int)(readHeight / 2);
+    const int iMax = i0 + (mapWidth - 1) + (readWidth - 1);
+    const int jMax = j0 + (mapHeight - 1) + (readHeight - 1);
+    if (i0 < 0 || iMax >= (int)(movie->width)
+            || j0 < 0 || jMax >= (int)(movie->height))
     {
-        for (unsigned int i = 0; i < filterWidth; i++)
-        {
-            correlation += currImageData[(jStart + j) * currImageWidth + iStart + i]
-                           * filterData[j * filterWidth + i];
-        }
+        std::string message("Correlation window out of image boundaries.");
+        throw AnalyseException(message);
     }
-    return correlation;
+    iMin = (unsigned int) i0;
+    jMin = (unsigned int) j0;
 }
 
-void CorrTrackAnalyser::selectImage(size_t frameIndex)
+template<typename PixelDataType>
+void CorrTrackAnalyser::correlateRegion(const ImageView<PixelDataType> &frame,
+                                        const unsigned int iMin,
+                                        const unsigned int jMin,
+                                        const bool isWindow,
+                                        ImageD * const correlationMap,
+                                        WorkerContext * const context) const
 {
-    // Switch to desired frame.
+    // Computes correlationMap from the region of the frame that it covers,
+    // enlarged by the filter size, whose top-left pixel is (iMin, jMin).  The
+    // FFT, full-frame and batched correlators are only used if it is the
+    // correlation window of a particle (of the frame given to
+    // correlateFrame(), for the latter two).
+    const unsigned int mapWidth = correlationMap->width;
+    const unsigned int mapHeight = correlationMap->height;
+    const ImageView<PixelDataType> region = frame.region(iMin, jMin,
+                                                         mapWidth + filterWidth - 1,
+                                                         mapHeight + filterHeight - 1);
+    if (useFrameFFT && isWindow)
+    {
+        // Already computed for the whole frame by correlateFrame()
+        for (unsigned int j = 0; j < mapHeight; j++)
+        {
+            const double * const row = frameCorrelator->correlation.data()
+                                       + (size_t) (jMin + j) * frame.width
+                                       + iMin;
+            std::copy(row, row + mapWidth,
+                      correlationMap->pixelsData + j * mapWidth);
+        }
+    }
+    else if (useBatch && isWindow && nTemplates == 1)
+    {
+        // Already computed for the windows of all the particles by
+        // correlateFrame()
+        for (unsigned int j = 0; j < mapHeight; j++)
+            for (unsigned int i = 0; i < mapWidth; i++)
+                correlationMap->pixelsData[j * mapWidth + i] = *batchCorrelator->values(iMin + i, jMin + j);
+    }
+    else if (nTemplates > 1)
+    {
+        // Normalized template by template
+        correlateBank(region, iMin, jMin, false, correlationMap, context);
+        return;
+    }
+    else if (useInteger)
+    {
+        context->integerCorrelator->correlate(region.data, region.stride,
+                                              mapWidth, mapHeight,
+                                              correlationMap->pixelsData);
+    }
+    else if (useSinglePrecision)
+    {
+        // Convert the region covered by the filter to float
+        context->floatPatch.resize((size_t) region.width * region.height);
+        region.convert(context->floatPatch.data(), region.width);
+        for (unsigned int j = 0; j < mapHeight; j++)
+        {
+            kernels::floatCorrelationRow(context->floatPatch.data() + (size_t) j * region.width,
+                                         region.width,
+                                         floatFilterData.data(), filterWidth, filterHeight,
+                                         mapWidth,
+                                         correlationMap->pixelsData + j * mapWidth);
+        }
+    }
+    else
+    {
+        // Convert the region covered by the filter to double
+        context->patch.resize((size_t) region.width * region.height);
+        region.convert(context->patch.data(), region.width);
 
-    if (currImageData != nullptr) delete currImageData;
+        if (useFFT && isWindow)
+        {
+            context->fftCorrelator->correlate(context->patch.data(), region.width,
+                                              correlationMap->pixelsData);
+        }
+        else if (useSparse)
+        {
+            for (unsigned int j = 0; j < mapHeight; j++)
+            {
+                kernels::sparseCorrelationRow(context->patch.data() + (size_t) j * region.width,
+                                              region.width,
+                                              filterRuns.data(), (unsigned int) filterRuns.size(),
+                                              runWeights.data(),
+                                              mapWidth,
+                                              correlationMap->pixelsData + j * mapWidth);
+            }
+        }
+        else if (separableRank > 0)
+        {
+            correlateSeparable(context->patch.data(), region.width,
+                               correlationMap, context);
+        }
+        else
+        {
+            // One row of the map at a time, so that the kernel can keep
+            // neighbouring output values in registers.
+            for (unsigned int j = 0; j < mapHeight; j++)
+            {
+                filterRowKernel(context->patch.data() + (size_t) j * region.width,
+                                region.width,
+                                filterData, filterWidth, filterHeight,
+                                mapWidth,
+                                correlationMap->pixelsData + j * mapWidth);
+            }
+        }
+    }
 
-    currFrameIndex = frameIndex;
-    currImageWidth = movie->width;
-    currImageHeight = movie->height;
-    currImageData = new double[currImageWidth * currImageHeight];
+    if (normalizedCorrelation)
+    {
+        sumRegion(region, context);
+        normalizeCorrelation(region.width, 0, correlationMap->pixelsData,
+                             mapWidth, mapHeight, context);
+    }
+}
 
-    if (movie->bitsPerSample == 8)
+template<typename PixelDataType>
+void CorrTrackAnalyser::correlateBank(const ImageView<PixelDataType> &region,
+                                      const unsigned int iMin,
+                                      const unsigned int jMin,
+                                      const bool isPixelMaximum,
+                                      ImageD * const correlationMap,
+                                      WorkerContext * const context) const
+{
+    // Computes correlationMap with each template of the filter bank, from
+    // the region whose top-left pixel is (iMin, jMin), and keeps the map of
+    // the template with the highest peak, whose index is set in
+    // context->templateIndex.  If isPixelMaximum, the maximum over the
+    // templates of each value is kept instead, for regions that hold several
+    // particles.  The region is read from the frame once, whatever the number
+    // of templates, and stays in cache for all of them.  In batched mode, the
+    // maps of the windows were computed by correlateFrame().  Normalized
+    // scores can be compared between any templates, and plain ones only
+    // between templates of similar norms.
+    const unsigned int mapWidth = correlationMap->width;
+    const unsigned int mapHeight = correlationMap->height;
+    const size_t mapSize = (size_t) mapWidth * mapHeight;
+    const size_t templateSize = (size_t) filterWidth * filterHeight;
+    const bool isBatched = useBatch && !isPixelMaximum
+                           && mapWidth == windowWidth && mapHeight == windowHeight;
+    if (!isBatched && useSinglePrecision)
     {
-        uint8_t* data = movie->frames8.at(frameIndex).pixelsData;
-        for (unsigned int k = 0; k < currImageWidth * currImageHeight; k++)
-            currImageData[k] = (double) data[k];
+        context->floatPatch.resize((size_t) region.width * region.height);
+        region.convert(context->floatPatch.data(), region.width);
+    }
+    else if (!isBatched)
+    {
+        context->patch.resize((size_t) region.width * region.height);
+        region.convert(context->patch.data(), region.width);
+    }
+    if (normalizedCorrelation)
+        sumRegion(region, context);
+    context->templateMap.resize(mapSize);
+    double best = 0.0;
+    for (unsigned int t = 0; t < nTemplates; t++)
+    {
+        double * const map = t == 0 ? correlationMap->pixelsData
+                                    : context->templateMap.data();
+        for (unsigned int j = 0; j < mapHeight; j++)
+        {
+            if (isBatched)
+            {
+                for (unsigned int i = 0; i < mapWidth; i++)
+                    map[j * mapWidth + i] = batchCorrelator->values(iMin + i, jMin + j)[t];
+                continue;
+            }
+            if (useSinglePrecision)
+            {
+                kernels::floatCorrelationRow(context->floatPatch.data() + (size_t) j * region.width,
+                                             region.width,
+                                             floatFilterData.data() + t * templateSize,
+                                             filterWidth, filterHeight,
+                                             mapWidth,
+                                             map + j * mapWidth);
+                continue;
+            }
+            filterRowKernel(context->patch.data() + (size_t) j * region.width,
+                            region.width,
+                            filterData + t * templateSize,
+                            filterWidth, filterHeight,
+                            mapWidth,
+                            map + j * mapWidth);
+        }
+        if (normalizedCorrelation)
+            normalizeCorrelation(region.width, t, map, mapWidth, mapHeight, context);
+        if (isPixelMaximum)
+        {
+            if (t > 0)
+                for (size_t k = 0; k < mapSize; k++)
+                    correlationMap->pixelsData[k] = std::max(correlationMap->pixelsData[k],
+                                                             map[k]);
+            continue;
+        }
+        const double peak = *std::max_element(map, map + mapSize);
+        if (t == 0 || peak > best)
+        {
+            best = peak;
+            context->templateIndex = t;
+            if (t > 0)
+                std::copy(map, map + mapSize, correlationMap->pixelsData);
+        }
     }
+}
+
+template<typename PixelDataType>
+void CorrTrackAnalyser::correlateBand(const ImageView<PixelDataType> &frame,
+                                      const unsigned int jMin,
+                                      ImageD * const correlationMap,
+                                      WorkerContext * const context) const
+{
+    // Computes correlationMap, of the full width of the frame, from its
+    // rows from jMin, for detectPoints().  A band holds many particles,
+    // that may each match a different template of a bank.
+    if (nTemplates > 1)
+        correlateBank(frame.region(0, jMin, frame.width,
+                                   correlationMap->height + filterHeight - 1),
+                      0, jMin, true, correlationMap, context);
     else
+        correlateRegion(frame, 0, jMin, false, correlationMap, context);
+}
+
+void CorrTrackAnalyser::correlateSeparable(const double * const patch,
+                                           const unsigned int patchWidth,
+                                           ImageD * const correlationMap,
+                                           WorkerContext * const context) const
+{
+    // Computes correlationMap from patch, the region covered by the filter,
+    // with the first separableRank terms of the filter.  For each row of the
+    // map and each term, the column vector is correlated over the full width
+    // of the patch, and the row vector over the result.  Both passes use the
+    // row kernel, with a filter of a single row or column.
+    const unsigned int mapWidth = correlationMap->width;
+    const unsigned int mapHeight = correlationMap->height;
+    const double * const columnVectors = filter->columnVectors.data();
+    const double * const rowVectors = filter->rowVectors.data();
+    context->columnPass.resize(patchWidth);
+    context->termRow.resize(mapWidth);
+    double * const columnPass = context->columnPass.data();
+    double * const termRow = context->termRow.data();
+    for (unsigned int j = 0; j < mapHeight; j++)
     {
-        uint16_t* data = movie->frames16.at(frameIndex).pixelsData;
-        for (unsigned int k = 0; k < currImageWidth * currImageHeight; k++)
-            currImageData[k] = (double) data[k];
+        double * const row = correlationMap->pixelsData + (size_t) j * mapWidth;
+        for (unsigned int t = 0; t < separableRank; t++)
+        {
+            kernels::correlationRow(patch + (size_t) j * patchWidth, patchWidth,
+                                    columnVectors + (size_t) t * filterHeight,
+                                    1, filterHeight, patchWidth, columnPass);
+            filterRowKernel(columnPass, patchWidth,
+                            rowVectors + (size_t) t * filterWidth,
+                            filterWidth, 1, mapWidth,
+                            t == 0 ? row : termRow);
+            if (t > 0)
+                for (unsigned int i = 0; i < mapWidth; i++)
+                    row[i] += termRow[i];
+        }
     }
 }
 
-ImageD* CorrTrackAnalyser::calcCorrelationMap(const Point point) const
+template<typename PixelDataType>
+void CorrTrackAnalyser::sumRegion(const ImageView<PixelDataType> &region,
+                                  WorkerContext * const context) const
 {
-    ImageD *correlationMap = new ImageD(windowWidth, windowHeight);
-    const int iStart = point.x - (int)(windowWidth / 2);
-    const int jStart = point.y - (int)(windowHeight / 2);
-    // Check boundaries
-    const int iMin = iStart - (int)(filterWidth / 2);
-    const int jMin = jStart - (int)(filterHeight / 2);
-    const int iMax = iMin + (windowWidth - 1) + (filterWidth - 1);
-    const int jMax = jMin + (windowHeight - 1) + (filterHeight - 1);
-    if (iMin < 0 || iMax >= (int)(currImageWidth)
-            || jMin < 0 || jMax >= (int)(currImageHeight))
+    // Summed-area tables of region and of its square, in context->sums and
+    // context->squareSums, for normalizeCorrelation().  The sums of integer
+    // pixels are exact in double.
+    const unsigned int width = region.width;
+    const unsigned int height = region.height;
+    const size_t stride = (size_t) width + 1;
+    std::vector<double> &sums = context->sums;
+    std::vector<double> &squareSums = context->squareSums;
+    sums.assign(stride * (height + 1), 0.0);
+    squareSums.assign(stride * (height + 1), 0.0);
+    for (unsigned int j = 0; j < height; j++)
     {
-        std::string message("Correlation window out of image boundaries.");
-        throw AnalyseException(message);
+        const PixelDataType * const pixels = region.row(j);
+        double rowSum = 0.0;
+        double rowSquareSum = 0.0;
+        for (unsigned int i = 0; i < width; i++)
+        {
+            const double value = (double) pixels[i];
+            rowSum += value;
+            rowSquareSum += value * value;
+            sums[(j + 1) * stride + i + 1] = sums[j * stride + i + 1] + rowSum;
+            squareSums[(j + 1) * stride + i + 1] = squareSums[j * stride + i + 1]
+                                                   + rowSquareSum;
+        }
     }
-    // Calculate correlation
-    for (unsigned int i = 0; i < windowWidth; i++)
+}
+
+void CorrTrackAnalyser::normalizeCorrelation(const unsigned int regionWidth,
+                                             const unsigned int templateIndex,
+                                             double * const map,
+                                             const unsigned int mapWidth,
+                                             const unsigned int mapHeight,
+                                             WorkerContext * const context) const
+{
+    // Turns the plain correlation map of a template over a region into the
+    // zero-mean normalized cross-correlation.  With S and S2 the sums of the
+    // n pixels under the filter and of their squares, and C the plain
+    // correlation:
+    //
+    //     ZNCC = (C - mean(filter) * S) / (deviation(filter) * sqrt(S2 - S^2 / n))
+    //
+    // S and S2 are read in O(1) per position from the summed-area tables of
+    // the region computed by sumRegion(), and the filter constants are
+    // computed once by CorrFilter.  Where the image is flat under the
+    // filter, the ZNCC is set to 0.
+    const size_t stride = (size_t) regionWidth + 1;
+    const std::vector<double> &sums = context->sums;
+    const std::vector<double> &squareSums = context->squareSums;
+    const double n = (double) filterWidth * filterHeight;
+    const double filterMean = filter->means[templateIndex];
+    const double filterDeviation = filter->deviations[templateIndex];
+    for (unsigned int j = 0; j < mapHeight; j++)
     {
-        for (unsigned int j = 0; j < windowHeight; j++)
+        const double * const top = sums.data() + j * stride;
+        const double * const bottom = sums.data() + (j + filterHeight) * stride;
+        const double * const squareTop = squareSums.data() + j * stride;
+        const double * const squareBottom = squareSums.data() + (j + filterHeight) * stride;
+        double * const row = map + (size_t) j * mapWidth;
+        for (unsigned int i = 0; i < mapWidth; i++)
         {
-            const double correlation = correlationValue(iStart + i, jStart + j);
-            correlationMap->setPixelIntensity(i, j, correlation);
+            const double sum = bottom[i + filterWidth] - bottom[i]
+                               - top[i + filterWidth] + top[i];
+            const double squareSum = squareBottom[i + filterWidth] - squareBottom[i]
+                                     - squareTop[i + filterWidth] + squareTop[i];
+            const double variance = squareSum - sum * sum / n;
+            if (variance > 0.0 && filterDeviation > 0.0)
+                row[i] = (row[i] - filterMean * sum)
+                         / (filterDeviation * std::sqrt(variance));
+            else
+                row[i] = 0.0;
         }
     }
-    return correlationMap;
 }
 
 std::vector<ImageD*>* CorrTrackAnalyser::testCorrelation()
@@ -177,32 +791,236 @@ std::vector<ImageD*>* CorrTrackAnalyser::testCorrelation()
     //
     // The frame must already be selected.
 
-    copyFilter();
+    prepareCorrelation();
+    correlateFrame(*pointsList);
 
     std::vector<ImageD*> *correlationMaps = new std::vector<ImageD*>;
     ImageD *correlationMap;
     for (Point const& point: *pointsList)
     {
-        correlationMap = calcCorrelationMap(point);
+        correlationMap = new ImageD(windowWidth, windowHeight);
+        calcCorrelationMap(point, currFrameIndex, correlationMap, contexts[0]);
         correlationMaps->push_back(correlationMap);
     }
     return correlationMaps;
 }
 
+void CorrTrackAnalyser::detectPoints()
+{
+    // Replaces the points by the particles detected in the current frame:
+    // the maxima of the correlation of the whole frame with the filter
+    // (normalized if normalizedCorrelation) within detectionRadius pixels
+    // along each axis, that are at least detectionThreshold times the
+    // highest value.  Only the window centres for which calcCorrelationMap()
+    // reads inside the frame are kept.  The points are in raster order.
+    //
+    // The frame is correlated by the direct kernels chosen by
+    // prepareCorrelation(), by bands of rows, or by the full-frame
+    // correlator, whichever costs less in automatic mode.  A bank is always
+    // correlated by bands, keeping the maximum over its templates of each
+    // value.  The bands and the tiles of the full-frame correlator are
+    // processed concurrently by the worker threads.
+
+    prepareCorrelation();
+    pointsList->clear();
+    if (movie->width + 1 < windowWidth + filterWidth
+            || movie->height + 1 < windowHeight + filterHeight)
+        return;
+
+    // Correlation values (of the regions whose top-left pixels are) in
+    // [0, nValidX) x [0, nValidY), of which those of the windows centred in
+    // [uMin, uMax] x [vMin, vMax] are inside the frame (see outerRegion()).
+    const unsigned int nValidX = movie->width - filterWidth + 1;
+    const unsigned int nValidY = movie->height - filterHeight + 1;
+    const unsigned int uMin = windowWidth / 2;
+    const unsigned int vMin = windowHeight / 2;
+    const unsigned int uMax = nValidX - (windowWidth - windowWidth / 2);
+    const unsigned int vMax = nValidY - (windowHeight - windowHeight / 2);
+    const unsigned int nBands = (nValidY + DETECTION_BAND_HEIGHT - 1) / DETECTION_BAND_HEIGHT;
+
+    bool isFrameFFT = false;
+    switch (correlationMethod)
+    {
+    case CorrelationMethod::Auto:
+        isFrameFFT = FrameCorrelator::cost(filterWidth, filterHeight,
+                                           movie->width, movie->height)
+                     < directCost * ((double) nValidX * nValidY)
+                       / ((double) windowWidth * windowHeight);
+        break;
+    case CorrelationMethod::FFT:
+    case CorrelationMethod::FrameFFT:
+        isFrameFFT = true;
+        break;
+    case CorrelationMethod::Direct:
+    case CorrelationMethod::Integer:
+    case CorrelationMethod::Batch:
+        break;
+    }
+    if (nTemplates > 1)
+        isFrameFFT = false;
+
+    double *correlation;
+    size_t stride;
+    std::vector<double> bandsCorrelation;
+    if (isFrameFFT)
+    {
+        prepareFrameCorrelator();
+        frameCorrelator->markAll();
+        if (movie->bitsPerSample == 8)
+            frameCorrelator->correlate(ImageView<uint8_t>(movie->frames8.at(currFrameIndex)),
+                                       threadPool);
+        else
+            frameCorrelator->correlate(ImageView<uint16_t>(movie->frames16.at(currFrameIndex)),
+                                       threadPool);
+        correlation = frameCorrelator->correlation.data();
+        stride = movie->width;
+    }
+    else
+    {
+        bandsCorrelation.resize((size_t) nValidX * nValidY);
+        correlation = bandsCorrelation.data();
+        stride = nValidX;
+    }
+
+    std::vector<double> bandMaxima(nBands, -HUGE_VAL);
+    threadPool->run(nBands, [&](const size_t band, const unsigned int worker)
+    {
+        WorkerContext * const context = contexts[worker];
+        const unsigned int v0 = (unsigned int) band * DETECTION_BAND_HEIGHT;
+        const unsigned int height = std::min(DETECTION_BAND_HEIGHT, nValidY - v0);
+        if (!isFrameFFT)
+        {
+            ImageD bandMap(nValidX, height);
+            if (movie->bitsPerSample == 8)
+                correlateBand(ImageView<uint8_t>(movie->frames8.at(currFrameIndex)),
+                              v0, &bandMap, context);
+            else
+                correlateBand(ImageView<uint16_t>(movie->frames16.at(currFrameIndex)),
+                              v0, &bandMap, context);
+            std::copy(bandMap.pixelsData, bandMap.pixelsData + (size_t) nValidX * height,
+                      correlation + v0 * stride);
+        }
+        else if (normalizedCorrelation)
+        {
+            // Normalized in a copy, as normalizeCorrelation() reads
+            // contiguous rows.
+            std::vector<double> &map = context->templateMap;
+            map.resize((size_t) nValidX * height);
+            for (unsigned int j = 0; j < height; j++)
+                std::copy(correlation + (v0 + j) * stride,
+                          correlation + (v0 + j) * stride + nValidX,
+                          map.begin() + (size_t) j * nValidX);
+            if (movie->bitsPerSample == 8)
+                sumRegion(ImageView<uint8_t>(movie->frames8.at(currFrameIndex))
+                          .region(0, v0, movie->width, height + filterHeight - 1),
+                          context);
+            else
+                sumRegion(ImageView<uint16_t>(movie->frames16.at(currFrameIndex))
+                          .region(0, v0, movie->width, height + filterHeight - 1),
+                          context);
+            normalizeCorrelation(movie->width, 0, map.data(), nValidX, height,
+                                 context);
+            for (unsigned int j = 0; j < height; j++)
+                std::copy(map.begin() + (size_t) j * nValidX,
+                          map.begin() + (size_t) (j + 1) * nValidX,
+                          correlation + (v0 + j) * stride);
+        }
+        for (unsigned int v = std::max(v0, vMin); v < v0 + height && v <= vMax; v++)
+        {
+            const double * const row = correlation + v * stride;
+            bandMaxima[band] = std::max(bandMaxima[band],
+                                        *std::max_element(row + uMin, row + uMax + 1));
+        }
+    });
+    const double threshold = detectionThreshold
+                             * *std::max_element(bandMaxima.begin(), bandMaxima.end());
+
+    std::vector<std::vector<Point>> bandPoints(nBands);
+    threadPool->run(nBands, [&](const size_t band, const unsigned int)
+    {
+        const unsigned int v0 = (unsigned int) band * DETECTION_BAND_HEIGHT;
+        const unsigned int height = std::min(DETECTION_BAND_HEIGHT, nValidY - v0);
+        for (unsigned int v = std::max(v0, vMin); v < v0 + height && v <= vMax; v++)
+        {
+            const double * const row = correlation + v * stride;
+            for (unsigned int u = uMin; u <= uMax; u++)
+            {
+                if (row[u] >= threshold
+                        && isLocalMaximum(correlation, stride, nValidX, nValidY,
+                                          u, v, detectionRadius))
+                    bandPoints[band].push_back(Point(u + filterWidth / 2,
+                                                     v + filterHeight / 2));
+            }
+        }
+    });
+    for (std::vector<Point> const& points : bandPoints)
+        pointsList->insert(pointsList->end(), points.begin(), points.end());
+}
+
 void CorrTrackAnalyser::analyse()
 {
+    // The particles are tracked from their positions in the current frame,
+    // forward to the end of the movie and backward to its beginning.  The
+    // trajectory of each particle in each direction only depends on its own
+    // previous positions, so that the particles and directions are tracked as
+    // independent chains by the worker threads.  The frames are processed in
+    // blocks of each direction.  In full-frame and batched modes, each frame
+    // is first correlated for all the particles, and the blocks are single
+    // frames of one direction.
+    //
+    // In chunked mode, the blocks are also split into temporal chunks, so
+    // that a few particles can be tracked on many threads.  See
+    // seedChunks() and stitchChunks().
+    //
+    // With a motion model, the windows are centred on the positions predicted
+    // from the previous ones, and the distance between the predicted and
+    // measured positions is written after those.  With an unchanged
+    // threshold, whether the position was reused is also written.  With drift
+    // correction, the windows are also moved by the global drift of the
+    // frames, which is written at the end of the lines.
+    //
+    // The positions are written in time order.  Those of the backward
+    // direction, as well as the forward ones that come before they are
+    // complete, are kept by frame in a temporary file, so that the memory
+    // used does not grow with the length of the movie.  If a particle cannot
+    // be tracked, the output file only covers the frames between the losses
+    // of the particles in each direction, as a frame by frame analysis from
+    // the current frame would, and the corresponding exception is rethrown.
+
     // Initialize parameters
-    ImageD* correlationMap;
-    double x, y;
-    std::vector<Point> *movingPointsList = new std::vector<Point>;
-    *movingPointsList = *pointsList;
+    const size_t nPoints = pointsList->size();
+    const size_t seedFrame = std::min(currFrameIndex, movie->nFrames);
     boost::filesystem::path path(movie->fileName);
     path = boost::filesystem::change_extension(path, "dat");
     std::string outputFileName = path.string();
     std::ofstream outputFile(outputFileName);
+    nAnalysedFrames = 0;
 
     // This is set before the big loops that need to be efficient.
-    copyFilter();
+    prepareCorrelation();
+
+    const bool isChunked = chunkLength > 0 && !useFrameFFT && !useBatch;
+    size_t nChunks = 1;
+    size_t blockSize = FRAMES_PER_BLOCK;
+    if (useFrameFFT || useBatch)
+    {
+        blockSize = 1;
+    }
+    else if (isChunked)
+    {
+        // Enough tasks for the work stealing to balance the threads
+        const size_t nTasks = CHUNKS_PER_THREAD * threadPool->nThreads;
+        nChunks = (nTasks + nPoints - 1) / std::max(nPoints, (size_t) 1);
+        nChunks = std::max(nChunks, (size_t) 1);
+        blockSize = nChunks * chunkLength;
+    }
+    TrackingState forward(*pointsList, seedFrame, true,
+                          movie->nFrames - seedFrame, blockSize, nChunks,
+                          motionModel);
+    TrackingState backward(*pointsList, seedFrame > 0 ? seedFrame - 1 : 0, false,
+                           seedFrame, blockSize, nChunks, motionModel);
+    for (TrackingState *state : {&forward, &backward})
+        state->windows.assign(nPoints, Window{windowWidth, windowHeight, 0.0});
 
     if (outputFile.is_open())
     {
@@ -218,133 +1036,850 @@ void CorrTrackAnalyser::analyse()
         outputFile << "# with window size (" << windowWidth
                    << ", " << windowHeight << ") and fit radius "
                    << fitRadius << ".\n";
+        if (localizationMethod == LocalizationMethod::Centroid)
+            outputFile << "# Particles located by the centroid of the intensity above the mean of their windows.\n";
+        else if (localizationMethod == LocalizationMethod::RadialSymmetry)
+            outputFile << "# Particles located by the centre of radial symmetry of the intensity in their windows.\n";
+        else if (subPixelMethod == SubPixelMethod::Parabolic)
+            outputFile << "# Sub-pixel peak by 3-point parabolic interpolation along each axis (quadratic fit on the map edges).\n";
+        else if (subPixelMethod == SubPixelMethod::Gaussian)
+            outputFile << "# Sub-pixel peak by 3-point Gaussian interpolation along each axis (quadratic fit on the map edges).\n";
+        else if (subPixelMethod == SubPixelMethod::UpsampledDFT)
+            outputFile << "# Sub-pixel peak of the DFT of the correlation maps upsampled by "
+                       << upsamplingFactor << " (quadratic fit on the map edges).\n";
+        if (useAdaptiveWindows)
+            outputFile << "# Adaptive window sizes, up to the size above.\n";
+        if (useSparse && !useInteger && localizationMethod == LocalizationMethod::Correlation)
+            outputFile << "# Direct correlation with " << runWeights.size()
+                       << " of the " << filterWidth * filterHeight
+                       << " filter coefficients, in " << filterRuns.size()
+                       << " runs (threshold " << sparseThreshold << ").\n";
+        if (separableEnergy > 0.0 && !useInteger && !useSparse && !useSinglePrecision
+                && localizationMethod == LocalizationMethod::Correlation)
+        {
+            const unsigned int rank = filter->separableRank(separableEnergy);
+            if (separableRank > 0)
+                outputFile << "# Direct correlation with " << rank
+                           << " separable term(s) of the filter, relative error "
+                           << filter->separableError(rank) << ".\n";
+            else
+                outputFile << "# Full filter, as its " << rank
+                           << " separable term(s) for a relative error of "
+                           << filter->separableError(rank) << " are not cheaper.\n";
+        }
+        if (useSinglePrecision && isSparseDropped)
+            outputFile << "# Full filter in single precision, instead of its sparse form (threshold "
+                       << sparseThreshold << "), which has no single-precision kernels.\n";
+        else if (useSinglePrecision && isSeparableDropped)
+            outputFile << "# Full filter in single precision, instead of its separable form, which has no single-precision kernels.\n";
+        if (localizationMethod == LocalizationMethod::Correlation)
+            outputFile << "# Correlation method: "
+                       << correlationMethodDescription() << ".\n";
+        if (isChunked)
+            outputFile << "# Temporal chunks of " << chunkLength
+                       << " frames, seeded with window size ("
+                       << std::max(seedWindowWidth, windowWidth) << ", "
+                       << std::max(seedWindowHeight, windowHeight) << ").\n";
+        if (seedFrame > 0)
+            outputFile << "# Tracked forward and backward from frame "
+                       << seedFrame + 1 << ".\n";
+        if (motionModel == MotionPredictor::Model::ConstantVelocity)
+            outputFile << "# Windows centred with a constant velocity model, r: distance to the predicted position.\n";
+        else if (motionModel == MotionPredictor::Model::Kalman)
+            outputFile << "# Windows centred with a Kalman filter, r: distance to the predicted position.\n";
+        if (driftCorrection)
+            outputFile << "# Windows moved by the global drift from frame "
+                       << seedFrame + 1 << ", by phase correlation of frames binned by "
+                       << contexts[0]->driftEstimator->binning << ".\n";
+        if (unchangedThreshold > 0.0)
+            outputFile << "# Positions reused while the mean absolute difference of the window regions from the frame of the last position found is below "
+                       << unchangedThreshold << ", u: 1 if reused.\n";
+        if (nTemplates > 1)
+            outputFile << "# t: best template of the bank (from 1), s: its correlation peak.\n";
         outputFile << "#\n";
         outputFile << "# Frame\tTimestamp";
-        for (unsigned int k = 0; k < movingPointsList->size(); k++)
+        for (unsigned int k = 0; k < nPoints; k++)
         {
             outputFile << "\tx_" << k + 1 << "\ty_" << k + 1;
+            if (motionModel != MotionPredictor::Model::None)
+                outputFile << "\tr_" << k + 1;
+            if (unchangedThreshold > 0.0)
+                outputFile << "\tu_" << k + 1;
+            if (nTemplates > 1)
+                outputFile << "\tt_" << k + 1 << "\ts_" << k + 1;
         }
+        if (driftCorrection)
+            outputFile << "\tdrift_x\tdrift_y";
         outputFile << "\n";
-        for (unsigned int i = 0; i < movie->nFrames; i++)
+
+        // Backward positions, and forward ones that wait for them, as records
+        // of the samples of the particles and the drift of each frame
+        const size_t recordSize = nPoints * sizeof(Sample) + sizeof(PointD);
+        std::unique_ptr<TemporaryFile> pending;
+        if (seedFrame > 0)
+            pending.reset(new TemporaryFile());
+        size_t laterEnd = seedFrame;
+        bool isEarlierWritten = seedFrame == 0;
+        while (!forward.isDone() || !backward.isDone())
         {
-            selectImage(i);
-            outputFile << i + 1 << "\t" << movie->timestamps.at(i);
-            for (Point &point : *movingPointsList)
+            std::vector<TrackingState*> states;
+            for (TrackingState *state : {&forward, &backward})
             {
-                correlationMap = calcCorrelationMap(point);
-                PointD newPoint = subPixelRes(correlationMap);
-
-                delete correlationMap;
-
-                x = point.x - (windowWidth / 2) + newPoint.x;
-                y = point.y - (windowHeight / 2) + newPoint.y;
+                if (state->isDone())
+                    continue;
+                state->end = std::min(state->first + blockSize, state->nSteps);
+                states.push_back(state);
+            }
+            estimateDrift(states);
+            if (useFrameFFT || useBatch)
+            {
+                // The frame correlators hold one frame at a time.
+                for (TrackingState *state : states)
+                {
+                    selectImage(state->frame(state->first));
+                    correlateFrame(state->points);
+                    trackBlock({state});
+                }
+            }
+            else
+            {
+                trackBlock(states);
+            }
 
-                // The "+ 1.0" are because the first pixel is (0, 0) in this
-                // program, while the usual convention is that the first pixel
-                // is (1, 1).
-                outputFile << std::fixed << std::setprecision(6)
-                           << "\t" << x + 1.0
-                           << "\t" << y + 1.0;
+            for (TrackingState *state : states)
+            {
+                // Steps at which all the particles were tracked
+                const size_t end = std::min(state->end, state->firstFailedStep.load());
+                const Sample * const samples = state->samples.data();
+                const PointD * const drifts = state->drifts.data();
+                if (state->isForward && isEarlierWritten)
+                {
+                    writePositions(outputFile, state->frame(state->first),
+                                   state->frame(end), samples, drifts);
+                }
+                else
+                {
+                    for (size_t s = state->first; s < end; s++)
+                    {
+                        const PointD drift = driftCorrection ? drifts[s - state->first]
+                                                             : PointD();
+                        pending->stream.seekp(state->frame(s) * recordSize);
+                        pending->stream.write(reinterpret_cast<const char*>(
+                                                  samples + (s - state->first) * nPoints),
+                                              nPoints * sizeof(Sample));
+                        pending->stream.write(reinterpret_cast<const char*>(&drift),
+                                              sizeof(PointD));
+                    }
+                    if (!pending->stream)
+                        throw IOException();
+                    if (state->isForward)
+                        laterEnd = state->frame(end);
+                }
+                nAnalysedFrames += state->end - state->first;
+                state->first = state->end;
+            }
 
-                point.setPos((unsigned int) (x + 0.5),
-                             (unsigned int) (y + 0.5));
+            if (backward.isDone() && !isEarlierWritten)
+            {
+                const size_t firstFrame = backward.firstFailedStep < backward.nSteps
+                                          ? backward.frame(backward.firstFailedStep) + 1
+                                          : 0;
+                std::vector<Sample> blockSamples(FRAMES_PER_BLOCK * nPoints);
+                std::vector<PointD> blockDrifts(FRAMES_PER_BLOCK);
+                for (size_t i = firstFrame; i < laterEnd; i += FRAMES_PER_BLOCK)
+                {
+                    const size_t n = std::min(FRAMES_PER_BLOCK, laterEnd - i);
+                    pending->stream.seekg(i * recordSize);
+                    for (size_t f = 0; f < n; f++)
+                    {
+                        pending->stream.read(reinterpret_cast<char*>(
+                                                 blockSamples.data() + f * nPoints),
+                                             nPoints * sizeof(Sample));
+                        pending->stream.read(reinterpret_cast<char*>(&blockDrifts[f]),
+                                             sizeof(PointD));
+                    }
+                    if (!pending->stream)
+                        throw IOException();
+                    writePositions(outputFile, i, i + n,
+                                   blockSamples.data(), blockDrifts.data());
+                }
+                pending.reset();
+                isEarlierWritten = true;
             }
-            outputFile << "\n";
         }
+
+        // selectImage() moved it in full-frame mode
+        currFrameIndex = seedFrame;
+
+        for (size_t k = 0; k < nPoints; k++)
+            for (TrackingState *state : {&backward, &forward})
+                for (std::string const& warning : state->warnings[k])
+                    outputFile << "# Warning: " << warning << "\n";
         outputFile.close();
+
+        // Same exception as a frame by frame analysis, forward first
+        for (TrackingState *state : {&forward, &backward})
+            for (size_t k = 0; k < nPoints; k++)
+                if (state->firstFailedStep < state->nSteps
+                        && state->failedSteps[k] == state->firstFailedStep)
+                    std::rethrow_exception(state->failures[k]);
     }
 }
 
-PointD CorrTrackAnalyser::subPixelRes(const ImageD * const correlationMap) const
+void CorrTrackAnalyser::runTasks(const std::vector<TrackingState*> &states,
+                                 const std::function<size_t(const TrackingState&)> &nTasks,
+                                 const std::function<void(TrackingState&, const size_t,
+                                                          WorkerContext * const)> &task)
 {
-    const size_t shift = correlationMap->width * correlationMap->height;
+    // Runs task(state, i, context) for i < nTasks(state), for all the states
+    // in a single batch of the worker threads.
+    std::vector<size_t> ends;
+    size_t n = 0;
+    for (TrackingState *state : states)
+    {
+        n += nTasks(*state);
+        ends.push_back(n);
+    }
+    threadPool->run(n, [&](const size_t i, const unsigned int worker)
+    {
+        size_t s = 0;
+        while (i >= ends[s])
+            s++;
+        task(*states[s], i - (s > 0 ? ends[s - 1] : 0), contexts[worker]);
+    });
+}
 
-    // Position of maximum correlation
-    const size_t k = std::distance(correlationMap->pixelsData,
-                                   std::max_element(correlationMap->pixelsData,
-                                                    correlationMap->pixelsData + shift));
-    const unsigned int jMax = (unsigned int) (k) / correlationMap->width;
-    const unsigned int iMax = (unsigned int) (k) - jMax * correlationMap->width;
+void CorrTrackAnalyser::estimateDrift(const std::vector<TrackingState*> &states)
+{
+    // With drift correction, finds the global drift at each step of the
+    // current block of each state, and at the step after it for the windows
+    // of the next block.  The shifts between consecutive frames are
+    // independent tasks, and are then summed from the seed frame.  The
+    // window positions at the start of the blocks are moved accordingly.
+    if (!driftCorrection)
+        return;
 
-    const double fitRadius2 = fitRadius * fitRadius;
-    const double shift_x = (double) iMax;
-    const double shift_y = (double) jMax;
+    for (TrackingState *state : states)
+    {
+        const PointD start = state->first > 0 ? state->drifts.back()
+                                              : PointD(0.0, 0.0);
+        const size_t last = std::min(state->end, state->nSteps - 1);
+        state->drifts.assign(last - state->first + 1, PointD(0.0, 0.0));
+        state->drifts[0] = start;
+    }
+    runTasks(states,
+             [](const TrackingState &state) { return state.drifts.size(); },
+             [&](TrackingState &state, const size_t i, WorkerContext * const context)
+    {
+        // The first step of the backward direction is one frame before the
+        // seed frame.
+        const size_t step = state.first + i;
+        if (i > 0)
+            state.drifts[i] = frameShift(state.frame(step - 1), state.frame(step),
+                                         context);
+        else if (step == 0 && !state.isForward)
+            state.drifts[i] = frameShift(state.origin + 1, state.origin, context);
+    });
+    for (TrackingState *state : states)
+    {
+        for (size_t i = 1; i < state->drifts.size(); i++)
+            state->drifts[i] = shifted(state->drifts[i], state->drifts[i - 1]);
+        for (size_t k = 0; k < state->nPoints; k++)
+            state->points[k] = windowCentre(shifted(state->predictors[k].predict(),
+                                                    state->drifts[0]));
+    }
+}
+
+PointD CorrTrackAnalyser::frameShift(const size_t previousFrame,
+                                     const size_t frame,
+                                     WorkerContext * const context) const
+{
+    // Global shift of frame from previousFrame.
+    if (movie->bitsPerSample == 8)
+        return context->driftEstimator->estimate(
+                    ImageView<uint8_t>(movie->frames8.at(previousFrame)),
+                    ImageView<uint8_t>(movie->frames8.at(frame)));
+    else
+        return context->driftEstimator->estimate(
+                    ImageView<uint16_t>(movie->frames16.at(previousFrame)),
+                    ImageView<uint16_t>(movie->frames16.at(frame)));
+}
 
-    std::vector<double> xVector, yVector, corrVector;
+void CorrTrackAnalyser::trackBlock(const std::vector<TrackingState*> &states)
+{
+    // Tracks all the particles over the current block of each state, on the
+    // worker threads.  In full-frame mode, the frame must have been
+    // correlated by correlateFrame().
 
-    for (unsigned int i = 0; i < correlationMap->width; i++)
+    for (TrackingState *state : states)
+    {
+        state->nBlockChunks = (state->end - state->first + state->chunkSize - 1)
+                              / state->chunkSize;
+        for (size_t k = 0; k < state->nPoints; k++)
+        {
+            Chunk &chunk = state->chunks[k * state->nChunks];
+            chunk.start = state->points[k];
+            chunk.predictor = state->predictors[k];
+            chunk.window = state->windows[k];
+            chunk.measurement = state->measurements[k];
+            chunk.seeded = true;
+        }
+    }
+    runTasks(states,
+             [](const TrackingState &state)
+             { return state.nBlockChunks > 1 ? state.nPoints : 0; },
+             [&](TrackingState &state, const size_t k, WorkerContext * const context)
+             { seedChunks(k, context, state); });
+    runTasks(states,
+             [](const TrackingState &state)
+             { return state.nPoints * state.nBlockChunks; },
+             [&](TrackingState &state, const size_t i, WorkerContext * const context)
+             { trackChunk(i % state.nPoints, i / state.nPoints, context, state); });
+    runTasks(states,
+             [](const TrackingState &state)
+             { return state.nPoints; },
+             [&](TrackingState &state, const size_t k, WorkerContext * const context)
+    {
+        stitchChunks(k, context, state);
+        const Chunk &last = state.chunks[k * state.nChunks + state.nBlockChunks - 1];
+        state.points[k] = last.end;
+        state.predictors[k] = last.endPredictor;
+        state.windows[k] = last.endWindow;
+        state.measurements[k] = last.endMeasurement;
+    });
+}
+
+void CorrTrackAnalyser::writePositions(std::ostream &outputFile,
+                                       const size_t first, const size_t end,
+                                       const Sample * const samples,
+                                       const PointD * const drifts) const
+{
+    // Writes the lines of frames first to end - 1, from
+    // samples[(i - first) * nPoints + k] for particle k in frame i, and
+    // drifts[i - first] if any.
+    const size_t nPoints = pointsList->size();
+    for (size_t i = first; i < end; i++)
     {
-        for (unsigned int j = 0; j < correlationMap->height; j++)
+        outputFile << i + 1 << "\t" << movie->timestamps.at(i);
+        for (size_t k = 0; k < nPoints; k++)
         {
-            const double x = (double) i;
-            const double y = (double) j;
-            const double radius2 = (x - shift_x) * (x - shift_x)
-                                   + (y - shift_y) * (y - shift_y);
-            if (radius2 <= fitRadius2)
+            const Sample &sample = samples[(i - first) * nPoints + k];
+            const PointD &position = sample.position;
+            // The "+ 1.0" are because the first pixel is (0, 0) in
+            // this program, while the usual convention is that the
+            // first pixel is (1, 1).
+            outputFile << std::fixed << std::setprecision(6)
+                       << "\t" << position.x + 1.0
+                       << "\t" << position.y + 1.0;
+            if (motionModel != MotionPredictor::Model::None)
+                outputFile << "\t" << sample.residual;
+            if (unchangedThreshold > 0.0)
+                outputFile << "\t" << (sample.isUnchanged ? 1 : 0);
+            if (nTemplates > 1)
+                outputFile << "\t" << sample.templateIndex + 1
+                           << "\t" << sample.score;
+        }
+        if (driftCorrection)
+            outputFile << "\t" << drifts[i - first].x
+                       << "\t" << drifts[i - first].y;
+        outputFile << "\n";
+    }
+}
+
+PointD CorrTrackAnalyser::locate(const Point point, const size_t frameIndex,
+                                 const unsigned int mapWidth,
+                                 const unsigned int mapHeight,
+                                 WorkerContext * const context) const
+{
+    // Position of the particle in the given frame, searched in the window of
+    // mapWidth x mapHeight pixels centred on point by the localizer of the
+    // context, which also sets its peak.  Throws if the region that the
+    // localizer reads is not inside the frame.
+    unsigned int iMin, jMin;
+    outerRegion(point, mapWidth, mapHeight, footprintWidth, footprintHeight,
+                iMin, jMin);
+    return context->localizer->locate(point, frameIndex, mapWidth, mapHeight);
+}
+
+PointD CorrTrackAnalyser::locatePeak(const Point point, const size_t frameIndex,
+                                     const unsigned int mapWidth,
+                                     const unsigned int mapHeight,
+                                     WorkerContext * const context) const
+{
+    // Position of the particle in the given frame, from the peak of the
+    // correlation map centred on point.  The map buffer of the context is
+    // reused.
+    //
+    // In pyramid mode, large maps are first searched coarsely by
+    // pyramidSearch(), and only a small map around its estimate is computed
+    // at full resolution.
+    if (usePyramid)
+    {
+        const unsigned int refineSize = 2 * (PYRAMID_SEARCH_RADIUS
+                                             + (unsigned int) std::ceil(fitRadius)) + 1;
+        Point estimate;
+        if ((mapWidth > refineSize || mapHeight > refineSize)
+                && pyramidSearch(point, frameIndex, mapWidth, mapHeight,
+                                 context, estimate))
+            return locatePeak(estimate, frameIndex,
+                              std::min(mapWidth, refineSize),
+                              std::min(mapHeight, refineSize), context);
+    }
+
+    ImageD *&correlationMap = context->correlationMap;
+    if (correlationMap == nullptr
+            || correlationMap->width != mapWidth
+            || correlationMap->height != mapHeight)
+    {
+        delete correlationMap;
+        correlationMap = new ImageD(mapWidth, mapHeight);
+    }
+    calcCorrelationMap(point, frameIndex, correlationMap, context);
+    const PointD newPoint = subPixelRes(correlationMap, context);
+    context->peakPixel.setPos(point.x - (mapWidth / 2) + context->peakPixel.x,
+                              point.y - (mapHeight / 2) + context->peakPixel.y);
+
+    const double x = point.x - (mapWidth / 2) + newPoint.x;
+    const double y = point.y - (mapHeight / 2) + newPoint.y;
+    return PointD(x, y);
+}
+
+bool CorrTrackAnalyser::adaptWindow(const Point point,
+                                    WorkerContext * const context,
+                                    Window &window) const
+{
+    // With adaptive windows, checks the peak that the localizer of the
+    // context found in window,
+    // centred on point.  If the peak is too close to the edges for the fit,
+    // or much lower than in the previous frame, the particle may have left
+    // the window: the window is enlarged and true is returned, for the frame
+    // to be searched again.  Otherwise, the window shrinks by one pixel on
+    // each side per frame, down to a margin of twice the displacement of
+    // the peak from the centre.
+    if (!useAdaptiveWindows)
+        return false;
+
+    const int fitMargin = (int) std::ceil(fitRadius);
+    const Localizer * const localizer = context->localizer;
+    const int dx = (int) localizer->peakPixel.x - (int) point.x;
+    const int dy = (int) localizer->peakPixel.y - (int) point.y;
+    // Distance of the peak to the window edges
+    const int margin = std::min({(int) (window.width / 2) + dx,
+                                 (int) (window.width - 1 - window.width / 2) - dx,
+                                 (int) (window.height / 2) + dy,
+                                 (int) (window.height - 1 - window.height / 2) - dy});
+    const bool isFull = window.width >= windowWidth
+                        && window.height >= windowHeight;
+    const bool isWeak = window.peak > 0.0
+                        && localizer->peakValue < PEAK_QUALITY_DROP * window.peak;
+    if (!isFull && (margin < fitMargin || isWeak))
+    {
+        window.width = std::min(2 * window.width + 1, windowWidth);
+        window.height = std::min(2 * window.height + 1, windowHeight);
+        return true;
+    }
+
+    window.peak = localizer->peakValue;
+    const unsigned int minWidth = 2 * (fitMargin + 2 * std::abs(dx) + 1) + 1;
+    const unsigned int minHeight = 2 * (fitMargin + 2 * std::abs(dy) + 1) + 1;
+    if (window.width > minWidth)
+        window.width -= std::min(2u, window.width - minWidth);
+    if (window.height > minHeight)
+        window.height -= std::min(2u, window.height - minHeight);
+    return false;
+}
+
+bool CorrTrackAnalyser::isUnchanged(const Point point, const Window &window,
+                                    const Measurement &measurement,
+                                    const size_t frameIndex) const
+{
+    // Whether the particle can keep the position of the last measurement in
+    // the given frame: the window is centred on the same pixel, and the mean
+    // absolute difference of the region covered by the filter from that of
+    // the measurement frame is below unchangedThreshold.  Comparing with the
+    // measurement frame rather than the previous one keeps slow motions from
+    // going unnoticed.  The cost is that of reading the region once from both
+    // frames.  The region is the window, with the margin of the filter for
+    // the correlation.
+    if (unchangedThreshold <= 0.0 || !measurement.isSet
+            || point.x != measurement.point.x || point.y != measurement.point.y)
+        return false;
+
+    unsigned int iMin, jMin;
+    outerRegion(point, window.width, window.height,
+                footprintWidth, footprintHeight, iMin, jMin);
+    const unsigned int width = window.width + footprintWidth - 1;
+    const unsigned int height = window.height + footprintHeight - 1;
+    uint64_t difference = 0;
+    if (movie->bitsPerSample == 8)
+    {
+        const ImageView<uint8_t> region = ImageView<uint8_t>(movie->frames8.at(frameIndex))
+                                          .region(iMin, jMin, width, height);
+        const ImageView<uint8_t> reference = ImageView<uint8_t>(movie->frames8.at(measurement.frame))
+                                             .region(iMin, jMin, width, height);
+        for (unsigned int j = 0; j < height; j++)
+            difference += kernels::absoluteDifference8(region.row(j), reference.row(j), width);
+    }
+    else
+    {
+        const ImageView<uint16_t> region = ImageView<uint16_t>(movie->frames16.at(frameIndex))
+                                           .region(iMin, jMin, width, height);
+        const ImageView<uint16_t> reference = ImageView<uint16_t>(movie->frames16.at(measurement.frame))
+                                              .region(iMin, jMin, width, height);
+        for (unsigned int j = 0; j < height; j++)
+            difference += kernels::absoluteDifference16(region.row(j), reference.row(j), width);
+    }
+    return (double) difference < unchangedThreshold * width * height;
+}
+
+bool CorrTrackAnalyser::pyramidSearch(const Point point, const size_t frameIndex,
+                                      const unsigned int mapWidth,
+                                      const unsigned int mapHeight,
+                                      WorkerContext * const context,
+                                      Point &estimate) const
+{
+    // Coarse-to-fine search of the correlation peak in the map centred on
+    // point.  The region covered by the filter is binned 2 x 2 repeatedly,
+    // as the filter was by prepareCorrelation().  The whole map is searched
+    // on the coarsest level that still has a few positions, and each finer
+    // level only around the peak of the coarser one.  Returns false if the
+    // map is too small for a downsampled level.
+    //
+    // The cost is that of the binning, plus that of the coarse map, which is
+    // 16^L times smaller than the full map for L levels.
+    unsigned int iMin, jMin;
+    outerRegion(point, mapWidth, mapHeight, filterWidth, filterHeight, iMin, jMin);
+    std::vector<PyramidLevel> &levels = context->regionLevels;
+    levels.resize(filterLevels.size());
+    PyramidLevel &base = levels[0];
+    base.width = mapWidth + filterWidth - 1;
+    base.height = mapHeight + filterHeight - 1;
+    base.data.resize((size_t) base.width * base.height);
+    if (movie->bitsPerSample == 8)
+        ImageView<uint8_t>(movie->frames8.at(frameIndex))
+            .region(iMin, jMin, base.width, base.height)
+            .convert(base.data.data(), base.width);
+    else
+        ImageView<uint16_t>(movie->frames16.at(frameIndex))
+            .region(iMin, jMin, base.width, base.height)
+            .convert(base.data.data(), base.width);
+
+    // Coarsest level with at least 3 x 3 positions
+    const unsigned int minPositions = 3;
+    size_t top = 0;
+    for (size_t l = 1; l < filterLevels.size(); l++)
+    {
+        downsample(levels[l - 1].data, levels[l - 1].width, levels[l - 1].height,
+                   false, levels[l].data, levels[l].width, levels[l].height);
+        if (levels[l].width < filterLevels[l].width + minPositions - 1
+                || levels[l].height < filterLevels[l].height + minPositions - 1)
+            break;
+        top = l;
+    }
+    if (top == 0)
+        return false;
+
+    // Peak position on the current level, and range of the searched
+    // positions
+    unsigned int uPeak = 0, vPeak = 0;
+    unsigned int uMin = 0, vMin = 0;
+    unsigned int uMax = levels[top].width - filterLevels[top].width;
+    unsigned int vMax = levels[top].height - filterLevels[top].height;
+    for (size_t l = top; l > 0; l--)
+    {
+        const PyramidLevel &image = levels[l];
+        const PyramidLevel &levelFilter = filterLevels[l];
+        if (l < top)
+        {
+            const unsigned int uLast = image.width - levelFilter.width;
+            const unsigned int vLast = image.height - levelFilter.height;
+            uMin = std::min(2 * uPeak > PYRAMID_SEARCH_RADIUS
+                            ? 2 * uPeak - PYRAMID_SEARCH_RADIUS : 0, uLast);
+            vMin = std::min(2 * vPeak > PYRAMID_SEARCH_RADIUS
+                            ? 2 * vPeak - PYRAMID_SEARCH_RADIUS : 0, vLast);
+            uMax = std::min(2 * uPeak + PYRAMID_SEARCH_RADIUS, uLast);
+            vMax = std::min(2 * vPeak + PYRAMID_SEARCH_RADIUS, vLast);
+        }
+        const unsigned int nU = uMax - uMin + 1;
+        context->levelRow.resize(nU);
+        double best = -HUGE_VAL;
+        for (unsigned int v = vMin; v <= vMax; v++)
+        {
+            kernels::correlationRow(image.data.data() + (size_t) v * image.width + uMin,
+                                    image.width,
+                                    levelFilter.data.data(),
+                                    levelFilter.width, levelFilter.height,
+                                    nU, context->levelRow.data());
+            for (unsigned int u = 0; u < nU; u++)
             {
-                xVector.push_back(x - shift_x);
-                yVector.push_back(y - shift_y);
-                corrVector.push_back(correlationMap->getPixelIntensity(i, j));
+                if (context->levelRow[u] > best)
+                {
+                    best = context->levelRow[u];
+                    uPeak = uMin + u;
+                    vPeak = v;
+                }
             }
         }
     }
 
-    // Converts vectors to arrays.  It works because vector elements are stored
-    // contiguously.
-    double *x_data = &xVector[0];
-    double *y_data = &yVector[0];
-    double *corr_data = &corrVector[0];
+    // Full resolution position of the window centre
+    estimate.setPos(point.x - mapWidth / 2 + std::min(2 * uPeak, mapWidth - 1),
+                    point.y - mapHeight / 2 + std::min(2 * vPeak, mapHeight - 1));
+    return true;
+}
+
+void CorrTrackAnalyser::trackChunk(const size_t k, const size_t c,
+                                   WorkerContext * const context,
+                                   TrackingState &state) const
+{
+    // Tracks particle k over chunk c of the current block, from chunk.start,
+    // chunk.predictor, chunk.window and chunk.measurement.  Except for the
+    // last chunk, the particle is also located at the first step of the next
+    // chunk, as that chunk does, without reusing the last measurement.
+    //
+    // The motion model predicts the positions relative to the global drift,
+    // and the windows are centred on the predicted positions moved by it.
 
-    const size_t n = xVector.size();
-    const int N_COEFFS = 6;
+    Chunk &chunk = state.chunks[k * state.nChunks + c];
+    chunk.hasOverlap = false;
+    chunk.failedStep = state.nSteps;
+    chunk.failure = nullptr;
+    if (!chunk.seeded)
+        return;
 
-    if (n < N_COEFFS)
+    const size_t from = state.first + c * state.chunkSize;
+    const size_t to = std::min(from + state.chunkSize, state.end);
+    const size_t last = c + 1 < state.nBlockChunks ? to : to - 1;
+    Point point = chunk.start;
+    MotionPredictor predictor = chunk.predictor;
+    Window window = chunk.window;
+    Measurement measurement = chunk.measurement;
+    // Steps after a lost particle are not needed.
+    for (size_t i = from; i <= last && i <= state.firstFailedStep; i++)
     {
-        std::string message("Intersection between pixels within fit radius and correlation window only has ");
-        message += std::to_string(n);
-        message += " point(s), while at least ";
-        message += std::to_string(N_COEFFS);
-        message += " are required.";
-        throw AnalyseException(message);
+        const PointD drift = state.drift(i);
+        const PointD predicted = shifted(predictor.predict(), drift);
+        bool unchanged = false;
+        try
+        {
+            // Otherwise, the last measurement is reused.
+            unchanged = i != to
+                        && isUnchanged(point, window, measurement, state.frame(i));
+            if (!unchanged)
+            {
+                PointD found;
+                do
+                    found = locate(point, state.frame(i),
+                                   window.width, window.height, context);
+                while (adaptWindow(point, context, window));
+                measurement = Measurement{true, state.frame(i), point, found,
+                                          context->templateIndex,
+                                          context->localizer->peakValue};
+            }
+        }
+        catch (...)
+        {
+            chunk.failedStep = i;
+            chunk.failure = std::current_exception();
+            // Only the first chunk is known to follow the actual trajectory.
+            if (c == 0)
+                state.fail(k, i, chunk.failure);
+            return;
+        }
+        const PointD position = measurement.position;
+        const double residual = std::hypot(position.x - predicted.x,
+                                           position.y - predicted.y);
+        predictor.update(PointD(position.x - drift.x, position.y - drift.y));
+        point = windowCentre(shifted(predictor.predict(), state.drift(i + 1)));
+        const Sample sample{position, residual, unchanged,
+                            measurement.templateIndex, measurement.score};
+        if (i == to)
+        {
+            chunk.overlap = sample;
+            chunk.overlapNext = point;
+            chunk.hasOverlap = true;
+            return;
+        }
+        state.samples[(i - state.first) * state.nPoints + k] = sample;
+        if (i == from)
+            chunk.second = point;
+        chunk.end = point;
+        chunk.endPredictor = predictor;
+        chunk.endWindow = window;
+        chunk.endMeasurement = measurement;
     }
+}
 
-    double chisq;
-
-    gsl_vector *y, *coeffs;
-    gsl_matrix *X, *cov;
+void CorrTrackAnalyser::seedChunks(const size_t k,
+                                   WorkerContext * const context,
+                                   TrackingState &state) const
+{
+    // Coarse pass that finds the starting positions of the chunks of particle
+    // k, by searching a wide window at the first step of each chunk around
+    // the previous seed.  The chunks whose seed cannot be found are tracked
+    // from the end of the previous chunk by stitchChunks().
+    //
+    // With a motion model, the particle is also located one step before the
+    // seed, for the initial velocity of the chunk.
+    const unsigned int width = std::max(seedWindowWidth, windowWidth);
+    const unsigned int height = std::max(seedWindowHeight, windowHeight);
+    // Seed positions relative to the global drift
+    PointD seed = state.chunks[k * state.nChunks].predictor.predict();
+    for (size_t c = 1; c < state.nBlockChunks; c++)
+    {
+        Chunk &chunk = state.chunks[k * state.nChunks + c];
+        try
+        {
+            const size_t step = state.first + c * state.chunkSize;
+            const PointD drift = state.drift(step);
+            const PointD position = locate(windowCentre(shifted(seed, drift)),
+                                           state.frame(step),
+                                           width, height, context);
+            seed = PointD(position.x - drift.x, position.y - drift.y);
+            PointD before = seed;
+            if (motionModel != MotionPredictor::Model::None)
+            {
+                const PointD beforeDrift = state.drift(step - 1);
+                before = locate(windowCentre(shifted(seed, beforeDrift)),
+                                state.frame(step - 1), width, height, context);
+                before = PointD(before.x - beforeDrift.x, before.y - beforeDrift.y);
+            }
+            chunk.start = windowCentre(position);
+            chunk.window = Window{windowWidth, windowHeight, 0.0};
+            chunk.measurement.isSet = false;
+            chunk.predictor = MotionPredictor(motionModel, before,
+                                              PointD(seed.x - before.x,
+                                                     seed.y - before.y));
+            chunk.seeded = true;
+        }
+        catch (...)
+        {
+            chunk.seeded = false;
+        }
+    }
+}
 
-    y = gsl_vector_alloc(n);
-    coeffs = gsl_vector_alloc(N_COEFFS);
-    X = gsl_matrix_alloc(n, N_COEFFS);
-    cov = gsl_matrix_alloc(N_COEFFS, N_COEFFS);
+void CorrTrackAnalyser::stitchChunks(const size_t k,
+                                     WorkerContext * const context,
+                                     TrackingState &state) const
+{
+    // Joins the chunks of particle k, in order.  A chunk is kept if the
+    // previous chunk, extended by one step, centres the window of the next
+    // step on the same pixel as the chunk does after its first step: the
+    // next steps are then the same as those of a frame by frame analysis
+    // (with a motion model, as long as the correlation peak lies in the
+    // windows of both).  Otherwise, the chunk boundary is reported as a
+    // discontinuity, and the chunk is tracked again from the end of the
+    // previous one.
 
-    for (unsigned int i = 0; i < n; i++)
+    for (size_t c = 1; c < state.nBlockChunks; c++)
     {
-        gsl_matrix_set(X, i, 0, x_data[i] * x_data[i]);
-        gsl_matrix_set(X, i, 1, x_data[i] * y_data[i]);
-        gsl_matrix_set(X, i, 2, y_data[i] * y_data[i]);
-        gsl_matrix_set(X, i, 3, x_data[i]);
-        gsl_matrix_set(X, i, 4, y_data[i]);
-        gsl_matrix_set(X, i, 5, 1.0);
+        Chunk &previous = state.chunks[k * state.nChunks + c - 1];
+        Chunk &chunk = state.chunks[k * state.nChunks + c];
+        const size_t from = state.first + c * state.chunkSize;
+        if (previous.failedStep < state.nSteps)
+        {
+            state.fail(k, previous.failedStep, previous.failure);
+            return;
+        }
+        if (from > state.firstFailedStep)
+            return;
 
-        gsl_vector_set(y, i, corr_data[i]);
+        Sample &sample = state.samples[(from - state.first) * state.nPoints + k];
+        const bool isTracked = chunk.seeded && chunk.failedStep != from;
+        if (isTracked && previous.hasOverlap
+                && previous.overlapNext.x == chunk.second.x
+                && previous.overlapNext.y == chunk.second.y)
+        {
+            sample = previous.overlap;
+            continue;
+        }
+
+        std::ostringstream warning;
+        warning << "particle " << k + 1 << ", frame " << state.frame(from) + 1 << ": ";
+        if (!chunk.seeded)
+            warning << "seed not found";
+        else if (isTracked && previous.hasOverlap)
+            warning << "discontinuity of "
+                    << std::hypot(sample.position.x - previous.overlap.position.x,
+                                  sample.position.y - previous.overlap.position.y)
+                    << " px at chunk boundary";
+        else
+            warning << "chunk lost from its seed";
+        warning << ", tracked again from the previous chunk.";
+        state.warnings[k].push_back(warning.str());
+
+        chunk.start = previous.end;
+        chunk.predictor = previous.endPredictor;
+        chunk.window = previous.endWindow;
+        chunk.measurement = previous.endMeasurement;
+        chunk.seeded = true;
+        trackChunk(k, c, context, state);
     }
 
-    gsl_multifit_linear_workspace *work = gsl_multifit_linear_alloc(n, N_COEFFS);
-    gsl_multifit_linear(X, y, coeffs, cov, &chisq, work);
-    gsl_multifit_linear_free(work);
+    const Chunk &last = state.chunks[k * state.nChunks + state.nBlockChunks - 1];
+    if (last.failedStep < state.nSteps)
+        state.fail(k, last.failedStep, last.failure);
+}
+
+PointD CorrTrackAnalyser::subPixelRes(const ImageD * const correlationMap,
+                                      WorkerContext * const context) const
+{
+    const size_t shift = correlationMap->width * correlationMap->height;
+
+    // Position of maximum correlation
+    const size_t k = std::distance(correlationMap->pixelsData,
+                                   std::max_element(correlationMap->pixelsData,
+                                                    correlationMap->pixelsData + shift));
+    const unsigned int jMax = (unsigned int) (k) / correlationMap->width;
+    const unsigned int iMax = (unsigned int) (k) - jMax * correlationMap->width;
 
-    const double a = gsl_vector_get(coeffs, 0);
-    const double b = gsl_vector_get(coeffs, 1);
-    const double c = gsl_vector_get(coeffs, 2);
-    const double d = gsl_vector_get(coeffs, 3);
-    const double e = gsl_vector_get(coeffs, 4);
-    // const double f = gsl_vector_get(coeffs, 5);
+    const double shift_x = (double) iMax;
+    const double shift_y = (double) jMax;
+    context->peakPixel.setPos(iMax, jMax);
+    context->peakValue = correlationMap->pixelsData[k];
+
+    // 3-point interpolation along each axis, or upsampled DFT, if the peak is
+    // not on an edge of the map.
+    const bool isInside = iMax > 0 && iMax + 1 < correlationMap->width
+                          && jMax > 0 && jMax + 1 < correlationMap->height;
+    if (subPixelMethod == SubPixelMethod::UpsampledDFT && isInside)
+        return context->upsampledDFT->refine(correlationMap->pixelsData,
+                                             correlationMap->width,
+                                             correlationMap->height,
+                                             iMax, jMax);
+    if (subPixelMethod != SubPixelMethod::QuadraticFit && isInside)
+    {
+        const bool isGaussian = subPixelMethod == SubPixelMethod::Gaussian;
+        const double * const peak = correlationMap->pixelsData + k;
+        const size_t width = correlationMap->width;
+        return PointD(shift_x + peakOffset(peak[-1], peak[0], peak[1], isGaussian),
+                      shift_y + peakOffset(*(peak - width), peak[0], peak[width], isGaussian));
+    }
+
+    // Quadratic fit around the maximum, with a cached pseudo-inverse of the
+    // design matrix.
+    double coeffs[QuadraticFit::N_COEFFS];
+    const size_t n = context->quadraticFit->fit(correlationMap->pixelsData,
+                                                correlationMap->width,
+                                                correlationMap->height,
+                                                iMax, jMax, coeffs);
+    if (n < QuadraticFit::N_COEFFS)
+    {
+        std::string message("Intersection between pixels within fit radius and correlation window only has ");
+        message += std::to_string(n);
+        message += " point(s), while at least ";
+        message += std::to_string(QuadraticFit::N_COEFFS);
+        message += " are required.";
+        throw AnalyseException(message);
+    }
 
-    gsl_vector_free(y);
-    gsl_vector_free(coeffs);
-    gsl_matrix_free(X);
-    gsl_matrix_free(cov);
+    const double a = coeffs[0];
+    const double b = coeffs[1];
+    const double c = coeffs[2];
+    const double d = coeffs[3];
+    const double e = coeffs[4];
+    // const double f = coeffs[5];
 
     // Position in correlationMap coordinates:
     double xPos, yPos;
@@ -360,4 +1895,280 @@ void CorrTrackAnalyser::copyFilter() const
     filterData = filter->filter;
     filterWidth = filter->width;
     filterHeight = filter->height;
+    nTemplates = filter->nTemplates;
+}
+
+void CorrTrackAnalyser::prepareCorrelation()
+{
+    // Chooses the correlation method and sets up what it needs, for the main
+    // thread and for each worker thread.  The full-frame correlator (and the
+    // filter spectrum it uses) is only rebuilt when the filter or frame size
+    // changed.
+    //
+    // In automatic mode, the whole frame is correlated at once when this
+    // costs less than correlating the windows of all the particles
+    // separately, which happens for many particles with overlapping windows.
+    //
+    // The other localizers only read the windows, one at a time.
+
+    copyFilter();
+    const bool isCorrelation = localizationMethod == LocalizationMethod::Correlation;
+    footprintWidth = isCorrelation ? filterWidth : 1;
+    footprintHeight = isCorrelation ? filterHeight : 1;
+    filterRowKernel = kernels::correlationRowKernel(kernels::instructionSet, filterWidth);
+
+    // Separable approximation of the filter for the direct kernels, when it
+    // keeps the requested energy at a lower cost than the full filter.
+    directCost = FFTCorrelator::directCost(filterWidth, filterHeight,
+                                           windowWidth, windowHeight);
+    separableRank = 0;
+    if (separableEnergy > 0.0)
+    {
+        const unsigned int rank = filter->separableRank(separableEnergy);
+        const double separableCost = FFTCorrelator::separableCost(filterWidth, filterHeight,
+                                                                  windowWidth, windowHeight,
+                                                                  rank);
+        if (separableCost < directCost)
+        {
+            separableRank = rank;
+            directCost = separableCost;
+        }
+    }
+    // Sparse form of the filter, if it is even cheaper.
+    filter->sparseRuns(sparseThreshold, filterRuns, runWeights);
+    const double sparseFraction = (SPARSE_COEFFICIENT_COST * runWeights.size()
+                                   + SPARSE_RUN_COST * filterRuns.size())
+                                  / ((double) filterWidth * filterHeight);
+    const double sparseCost = sparseFraction * FFTCorrelator::directCost(filterWidth, filterHeight,
+                                                                         windowWidth, windowHeight);
+    useSparse = sparseCost < directCost;
+    // A bank of templates is only correlated with the dense direct kernels,
+    // or in batched mode, as is a filter in single precision.
+    isSparseDropped = singlePrecision && nTemplates == 1 && useSparse;
+    isSeparableDropped = singlePrecision && nTemplates == 1 && !useSparse
+                         && separableRank > 0;
+    if (nTemplates > 1 || singlePrecision)
+    {
+        separableRank = 0;
+        useSparse = false;
+    }
+    if (singlePrecision)
+        directCost = SINGLE_PRECISION_COST * FFTCorrelator::directCost(filterWidth, filterHeight,
+                                                                       windowWidth, windowHeight);
+    if (useSparse)
+    {
+        separableRank = 0;
+        directCost = sparseCost;
+    }
+    const double fftCost = FFTCorrelator::cost(filterWidth, filterHeight,
+                                               windowWidth, windowHeight);
+    useFFT = false;
+    useFrameFFT = false;
+    useInteger = false;
+    useBatch = false;
+    switch (correlationMethod)
+    {
+    case CorrelationMethod::Auto:
+        useFFT = fftCost < directCost;
+        // The pyramid search is cheaper than the full-frame correlation of
+        // full windows, which it does not use.
+        useFrameFFT = (pyramidLevels == 0 || normalizedCorrelation)
+                      && FrameCorrelator::cost(filterWidth, filterHeight,
+                                            movie->width, movie->height,
+                                            *pointsList,
+                                            windowWidth, windowHeight)
+                      < pointsList->size() * std::min(directCost, fftCost);
+        break;
+    case CorrelationMethod::Direct:
+        break;
+    case CorrelationMethod::FFT:
+        useFFT = true;
+        break;
+    case CorrelationMethod::FrameFFT:
+        useFrameFFT = true;
+        break;
+    case CorrelationMethod::Integer:
+        useInteger = true;
+        break;
+    case CorrelationMethod::Batch:
+        useBatch = true;
+        break;
+    }
+    if (nTemplates > 1 || !isCorrelation)
+    {
+        useFFT = false;
+        useFrameFFT = false;
+        useInteger = false;
+    }
+    if (!isCorrelation)
+        useBatch = false;
+    useSinglePrecision = singlePrecision && !useFFT && !useFrameFFT
+                         && !useInteger && !useBatch && isCorrelation;
+    floatFilterData.clear();
+    if (useSinglePrecision)
+        floatFilterData.assign(filterData,
+                               filterData + (size_t) nTemplates * filterWidth * filterHeight);
+
+    if (useFrameFFT)
+    {
+        useFFT = false;
+        prepareFrameCorrelator();
+    }
+    // The batch correlator only copies the filter, and is rebuilt each time
+    // in case it changed.
+    delete batchCorrelator;
+    batchCorrelator = nullptr;
+    if (useBatch)
+        batchCorrelator = new BatchCorrelator(filter, movie->width, movie->height);
+
+    // Like the batched one, the full-frame method computes the whole windows
+    // anyway.
+    useAdaptiveWindows = adaptiveWindows && !useFrameFFT && !useBatch;
+
+    // Filter levels of the pyramid search, down to a single pixel at most.
+    // The full-frame and batched methods always compute the whole windows.
+    // The coarse levels search the plain correlation, whose peak may not be
+    // that of the normalized one.
+    usePyramid = pyramidLevels > 0 && !useFrameFFT && !useBatch && nTemplates == 1
+                 && isCorrelation && !normalizedCorrelation;
+    filterLevels.clear();
+    if (usePyramid)
+    {
+        filterLevels.resize(1);
+        filterLevels[0].data.assign(filterData, filterData + (size_t) filterWidth * filterHeight);
+        filterLevels[0].width = filterWidth;
+        filterLevels[0].height = filterHeight;
+        while (filterLevels.size() <= pyramidLevels
+               && (filterLevels.back().width > 1 || filterLevels.back().height > 1))
+        {
+            const PyramidLevel &finer = filterLevels.back();
+            PyramidLevel coarser;
+            downsample(finer.data, finer.width, finer.height, true,
+                       coarser.data, coarser.width, coarser.height);
+            filterLevels.push_back(coarser);
+        }
+        usePyramid = filterLevels.size() > 1;
+    }
+
+    if (threadPool == nullptr)
+        threadPool = new ThreadPool(std::thread::hardware_concurrency());
+    while (contexts.size() < threadPool->nThreads)
+        contexts.push_back(new WorkerContext());
+
+    for (WorkerContext *context : contexts)
+    {
+        if (context->quadraticFit == nullptr
+                || context->quadraticFit->fitRadius != fitRadius)
+        {
+            delete context->quadraticFit;
+            context->quadraticFit = new QuadraticFit(fitRadius);
+        }
+        if (context->upsampledDFT == nullptr
+                || context->upsampledDFT->upsamplingFactor != upsamplingFactor)
+        {
+            delete context->upsampledDFT;
+            context->upsampledDFT = new UpsampledDFT(upsamplingFactor);
+        }
+
+        // The correlators are cheap to build, and rebuilt each time in case
+        // the filter or the movie changed.  This also makes the filter cache
+        // its spectrum for the window size here, before the worker threads
+        // read it concurrently.
+        delete context->integerCorrelator;
+        context->integerCorrelator = nullptr;
+        if (useInteger)
+            context->integerCorrelator = new IntegerCorrelator(filter, movie);
+        delete context->fftCorrelator;
+        context->fftCorrelator = nullptr;
+        if (useFFT)
+            context->fftCorrelator = new FFTCorrelator(filter,
+                                                       windowWidth, windowHeight);
+        delete context->driftEstimator;
+        context->driftEstimator = nullptr;
+        if (driftCorrection)
+            context->driftEstimator = new DriftEstimator(movie->width,
+                                                         movie->height);
+
+        delete context->localizer;
+        switch (localizationMethod)
+        {
+        case LocalizationMethod::Correlation:
+            context->localizer = new CorrelationLocalizer(this, context);
+            break;
+        case LocalizationMethod::Centroid:
+            context->localizer = new CentroidLocalizer(movie);
+            break;
+        case LocalizationMethod::RadialSymmetry:
+            context->localizer = new RadialSymmetryLocalizer(movie);
+            break;
+        }
+    }
+}
+
+void CorrTrackAnalyser::prepareFrameCorrelator()
+{
+    // Builds the full-frame correlator.  Its tile correlators copy the
+    // spectrum of the filter, so that it is rebuilt in case the filter was
+    // reloaded.
+    delete frameCorrelator;
+    frameCorrelator = new FrameCorrelator(filter,
+                                          movie->width, movie->height);
+}
+
+void CorrTrackAnalyser::correlateFrame(const std::vector<Point> &points)
+{
+    // In full-frame and batched modes, correlates the current frame for the
+    // windows of all points at once.  Nothing to do in the other modes.
+
+    if (useFrameFFT)
+    {
+        for (Point const& point : points)
+            frameCorrelator->markWindow(point, windowWidth, windowHeight);
+        if (movie->bitsPerSample == 8)
+            frameCorrelator->correlate(ImageView<uint8_t>(movie->frames8.at(currFrameIndex)),
+                                       threadPool);
+        else
+            frameCorrelator->correlate(ImageView<uint16_t>(movie->frames16.at(currFrameIndex)),
+                                       threadPool);
+    }
+    else if (useBatch)
+    {
+        for (Point const& point : points)
+            batchCorrelator->markWindow(point, windowWidth, windowHeight);
+        if (movie->bitsPerSample == 8)
+            batchCorrelator->correlate(ImageView<uint8_t>(movie->frames8.at(currFrameIndex)));
+        else
+            batchCorrelator->correlate(ImageView<uint16_t>(movie->frames16.at(currFrameIndex)));
+    }
+}
+
+std::string CorrTrackAnalyser::correlationMethodDescription() const
+{
+    // Correlation method chosen by prepareCorrelation(), as written in the
+    // output file header.
+    std::ostringstream description;
+    if (useInteger)
+        description << "integer (filter scale "
+                    << contexts[0]->integerCorrelator->scale
+                    << ", relative quantization error "
+                    << contexts[0]->integerCorrelator->quantizationError << ")";
+    else if (useFrameFFT)
+        description << "full-frame FFT";
+    else if (useFFT)
+        description << "FFT";
+    else if (useBatch)
+        description << "batched matrix product";
+    else
+        description << "direct";
+    if (useSinglePrecision)
+        description << ", single precision";
+    if (normalizedCorrelation)
+        description << ", zero-mean normalized";
+    if (usePyramid)
+        description << ", " << filterLevels.size() - 1 << "-level pyramid search";
+    else if (pyramidLevels > 0 && normalizedCorrelation)
+        description << ", without pyramid search";
+    if (nTemplates > 1)
+        description << ", bank of " << nTemplates << " templates";
+    return description.str();
 }
@@ -22,8 +22,24 @@
 #pragma once
 
 
+#include <atomic>
 #include <exception>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "batchcorrelator.h"
 #include "corrfilter.h"
+#include "driftestimator.h"
+#include "fftcorrelator.h"
+#include "framecorrelator.h"
+#include "imageview.h"
+#include "integercorrelator.h"
+#include "localizer.h"
+#include "motionpredictor.h"
+#include "quadraticfit.h"
+#include "threadpool.h"
+#include "upsampleddft.h"
 #include "movie/movie.h"
 #include "movie/base/frame.h"
 #include "point.h"
@@ -33,23 +49,340 @@
 
 class CorrTrackAnalyser
 {
+public:
+    enum class CorrelationMethod {
+        Auto,
+        Direct,
+        FFT,
+        FrameFFT,
+        Integer,
+        Batch,
+    };
+
+    // Localization of the particles in their windows: peak of the
+    // correlation with the filter, centroid of the intensity above the mean
+    // of the window, or centre of radial symmetry of the intensity gradient.
+    enum class LocalizationMethod {
+        Correlation,
+        Centroid,
+        RadialSymmetry,
+    };
+
+    // Sub-pixel position of the correlation peak: least-squares fit of a
+    // paraboloid within the fit radius, 3-point interpolation of the peak
+    // along each axis, by a parabola or a Gaussian, or maximum of the
+    // upsampled DFT of the map
+    enum class SubPixelMethod {
+        QuadraticFit,
+        Parabolic,
+        Gaussian,
+        UpsampledDFT,
+    };
+
 private:
-    double correlationValue(const unsigned int i0, const unsigned int j0) const;
-    ImageD* calcCorrelationMap(const Point point) const;
-    PointD subPixelRes(const ImageD * const correlationMap) const;
+    // Image or filter downsampled by a power of 2, for the pyramid search.
+    struct PyramidLevel
+    {
+        std::vector<double> data;
+        unsigned int width;
+        unsigned int height;
+    };
+
+    // Correlation window of a particle in adaptive mode, with the value of
+    // the last correlation peak found in it (0 if none).
+    struct Window
+    {
+        unsigned int width;
+        unsigned int height;
+        double peak;
+    };
+
+    // Last frame in which a particle was located, with the window centre
+    // and the position found there.  Unset at the start of the tracking and
+    // of the seeded chunks.
+    struct Measurement
+    {
+        bool isSet;
+        size_t frame;
+        Point point;
+        PointD position;
+        unsigned int templateIndex;
+        double score;
+    };
+
+    // Tracking result of a particle at a step: position, distance from the
+    // predicted position, whether the position of the last measurement was
+    // reused because the window region did not change, and best template of
+    // a filter bank with its correlation peak.
+    struct Sample
+    {
+        PointD position;
+        double residual;
+        bool isUnchanged;
+        unsigned int templateIndex;
+        double score;
+    };
+
+    // Per-thread correlation state.  The correlators and the fit keep scratch
+    // buffers and caches, so that each worker thread has its own.
+    struct WorkerContext
+    {
+        WorkerContext();
+        ~WorkerContext();
+        WorkerContext(const WorkerContext&) =delete;
+        WorkerContext& operator=(const WorkerContext&) =delete;
+        WorkerContext(WorkerContext&&) =delete;
+        WorkerContext& operator=(WorkerContext&&) =delete;
+
+        FFTCorrelator *fftCorrelator;
+        IntegerCorrelator *integerCorrelator;
+        QuadraticFit *quadraticFit;
+        UpsampledDFT *upsampledDFT;
+        DriftEstimator *driftEstimator;
+        // Localizer of the particles, that may use the state below
+        Localizer *localizer;
+        // Correlated region of the frame, converted to double
+        std::vector<double> patch;
+        // Same, converted to float for the single-precision kernels
+        std::vector<float> floatPatch;
+        // Column pass of a separable term over a row of the region, and its
+        // row pass
+        std::vector<double> columnPass;
+        std::vector<double> termRow;
+        // Correlation map of a template of a filter bank, and index of the
+        // template of the last map computed
+        std::vector<double> templateMap;
+        unsigned int templateIndex;
+        // Reused by locatePeak()
+        ImageD *correlationMap;
+        // Pixel (in the frame) and value of the maximum of the last map
+        // searched by locatePeak()
+        Point peakPixel;
+        double peakValue;
+        // Summed-area tables of the correlated region and of its square
+        std::vector<double> sums;
+        std::vector<double> squareSums;
+        // Pyramid of the searched region, and correlation values of a level
+        std::vector<PyramidLevel> regionLevels;
+        std::vector<double> levelRow;
+    };
+
+    // Correlation with the filter and sub-pixel peak search, in the context
+    // of a worker thread, as a localizer.
+    class CorrelationLocalizer : public Localizer
+    {
+    private:
+        const CorrTrackAnalyser * const analyser;
+        WorkerContext * const context;
+
+    public:
+        explicit CorrelationLocalizer(const CorrTrackAnalyser * const analyser,
+                                      WorkerContext * const context);
+
+        PointD locate(const Point point, const size_t frameIndex,
+                      const unsigned int width,
+                      const unsigned int height) override;
+    };
+
+    // Part of the trajectory of a particle, tracked by one worker thread.
+    // The frames are split into chunks only in chunked mode, in which all
+    // the chunks but the first one of each block start from a seed position.
+    struct Chunk
+    {
+        // Window positions in the first and second frames, and after the
+        // last frame.
+        Point start;
+        Point second;
+        Point end;
+        // Motion of the particle before the first frame and after the last
+        MotionPredictor predictor;
+        MotionPredictor endPredictor;
+        // Window sizes in the first frame and after the last one
+        Window window;
+        Window endWindow;
+        // Last measurement before the first frame and after the last one
+        Measurement measurement;
+        Measurement endMeasurement;
+        // Sample in the first frame of the next chunk, and window position
+        // in the second one, to check that they are consistent with the seed
+        // of that chunk.
+        Sample overlap;
+        Point overlapNext;
+        bool hasOverlap;
+        bool seeded;
+        size_t failedStep;
+        std::exception_ptr failure;
+    };
+
+    // State of analyse() in one direction of time, from the seed frame.
+    // The frames are counted in steps from the first one, origin.
+    struct TrackingState
+    {
+        explicit TrackingState(const std::vector<Point> &points,
+                               const size_t origin, const bool isForward,
+                               const size_t nSteps, const size_t blockSize,
+                               const size_t nChunks,
+                               const MotionPredictor::Model motionModel);
+        size_t frame(const size_t step) const;
+        PointD drift(const size_t step) const;
+        bool isDone() const;
+        void fail(const size_t k, const size_t step,
+                  const std::exception_ptr failure);
+
+        const size_t nPoints;
+        const size_t origin;
+        const bool isForward;
+        const size_t nSteps;
+        const size_t blockSize;
+        const size_t nChunks;
+        const size_t chunkSize;
+        // Current block of steps
+        size_t first;
+        size_t end;
+        size_t nBlockChunks;
+        // Window positions and motions at the start of the current block
+        std::vector<Point> points;
+        std::vector<MotionPredictor> predictors;
+        std::vector<Window> windows;
+        std::vector<Measurement> measurements;
+        // samples[(s - first) * nPoints + k]: particle k at step s
+        std::vector<Sample> samples;
+        // drifts[s - first]: global drift at step s from the seed frame, up
+        // to step end (empty without drift correction)
+        std::vector<PointD> drifts;
+        // chunks[k * nChunks + c]
+        std::vector<Chunk> chunks;
+        // Step at which each particle was lost, and why
+        std::vector<size_t> failedSteps;
+        std::vector<std::exception_ptr> failures;
+        std::atomic<size_t> firstFailedStep;
+        // Chunk boundary discontinuities, per particle
+        std::vector<std::vector<std::string>> warnings;
+    };
+
+    void calcCorrelationMap(const Point point, const size_t frameIndex,
+                            ImageD * const correlationMap,
+                            WorkerContext * const context) const;
+    template<typename PixelDataType>
+        void correlateRegion(const ImageView<PixelDataType> &frame,
+                             const unsigned int iMin, const unsigned int jMin,
+                             const bool isWindow,
+                             ImageD * const correlationMap,
+                             WorkerContext * const context) const;
+    template<typename PixelDataType>
+        void correlateBank(const ImageView<PixelDataType> &region,
+                           const unsigned int iMin, const unsigned int jMin,
+                           const bool isPixelMaximum,
+                           ImageD * const correlationMap,
+                           WorkerContext * const context) const;
+    template<typename PixelDataType>
+        void correlateBand(const ImageView<PixelDataType> &frame,
+                           const unsigned int jMin,
+                           ImageD * const correlationMap,
+                           WorkerContext * const context) const;
+    void correlateSeparable(const double * const patch,
+                            const unsigned int patchWidth,
+                            ImageD * const correlationMap,
+                            WorkerContext * const context) const;
+    template<typename PixelDataType>
+        void sumRegion(const ImageView<PixelDataType> &region,
+                       WorkerContext * const context) const;
+    void normalizeCorrelation(const unsigned int regionWidth,
+                              const unsigned int templateIndex,
+                              double * const map,
+                              const unsigned int mapWidth,
+                              const unsigned int mapHeight,
+                              WorkerContext * const context) const;
+    PointD subPixelRes(const ImageD * const correlationMap,
+                       WorkerContext * const context) const;
+    PointD locatePeak(const Point point, const size_t frameIndex,
+                      const unsigned int mapWidth, const unsigned int mapHeight,
+                      WorkerContext * const context) const;
+    PointD locate(const Point point, const size_t frameIndex,
+                  const unsigned int mapWidth, const unsigned int mapHeight,
+                  WorkerContext * const context) const;
+    void outerRegion(const Point point,
+                     const unsigned int mapWidth, const unsigned int mapHeight,
+                     const unsigned int readWidth,
+                     const unsigned int readHeight,
+                     unsigned int &iMin, unsigned int &jMin) const;
+    bool adaptWindow(const Point point, WorkerContext * const context,
+                     Window &window) const;
+    bool isUnchanged(const Point point, const Window &window,
+                     const Measurement &measurement,
+                     const size_t frameIndex) const;
+    bool pyramidSearch(const Point point, const size_t frameIndex,
+                       const unsigned int mapWidth, const unsigned int mapHeight,
+                       WorkerContext * const context, Point &estimate) const;
+    void trackChunk(const size_t k, const size_t c,
+                    WorkerContext * const context,
+                    TrackingState &state) const;
+    void seedChunks(const size_t k, WorkerContext * const context,
+                    TrackingState &state) const;
+    void stitchChunks(const size_t k, WorkerContext * const context,
+                      TrackingState &state) const;
+    void runTasks(const std::vector<TrackingState*> &states,
+                  const std::function<size_t(const TrackingState&)> &nTasks,
+                  const std::function<void(TrackingState&, const size_t,
+                                           WorkerContext * const)> &task);
+    void estimateDrift(const std::vector<TrackingState*> &states);
+    PointD frameShift(const size_t previousFrame, const size_t frame,
+                      WorkerContext * const context) const;
+    void trackBlock(const std::vector<TrackingState*> &states);
+    void writePositions(std::ostream &outputFile,
+                        const size_t first, const size_t end,
+                        const Sample * const samples,
+                        const PointD * const drifts) const;
     void copyFilter() const;
+    void prepareCorrelation();
+    void prepareFrameCorrelator();
+    void correlateFrame(const std::vector<Point> &points);
+    std::string correlationMethodDescription() const;
 
-    // filterData and currImageData allow for faster access than filter->filter,
-    // and than using an ImageD.
+    // filterData allows for faster access than filter->filter.
     mutable double *filterData;
     mutable unsigned int filterWidth;
     mutable unsigned int filterHeight;
-    //
-    double *currImageData;
-    unsigned int currImageWidth;
-    unsigned int currImageHeight;
+    mutable unsigned int nTemplates;
     //
     std::vector<Point> *pointsList;
+    //
+    FrameCorrelator *frameCorrelator;
+    BatchCorrelator *batchCorrelator;
+    ThreadPool *threadPool;
+    std::vector<WorkerContext*> contexts;
+    bool useFFT;
+    bool useFrameFFT;
+    bool useInteger;
+    bool useBatch;
+    bool usePyramid;
+    bool useAdaptiveWindows;
+    // Size of the region read around each pixel of a window by the
+    // localizer: the filter for the correlation, the pixel itself otherwise
+    unsigned int footprintWidth;
+    unsigned int footprintHeight;
+    // Row kernel specialized for the filter width, if any
+    kernels::CorrelationRowKernel filterRowKernel;
+    // Direct correlation in single precision, with the filter (all the
+    // templates of a bank) converted to float
+    bool useSinglePrecision;
+    std::vector<float> floatFilterData;
+    // Whether single precision gave up a cheaper sparse or separable form of
+    // the filter, whose kernels are double only
+    bool isSparseDropped;
+    bool isSeparableDropped;
+    // Number of separable terms of the filter used by the direct kernels (0
+    // for the full filter)
+    unsigned int separableRank;
+    // Sparse form of the filter, used by the direct kernels if useSparse
+    bool useSparse;
+    std::vector<kernels::FilterRun> filterRuns;
+    std::vector<double> runWeights;
+    // Cost of the correlation of a window by the direct kernels chosen, in
+    // the units of FFTCorrelator::cost()
+    double directCost;
+    // filterLevels[l]: filter downsampled by 2^l
+    std::vector<PyramidLevel> filterLevels;
 
 public:
     CorrTrackAnalyser();
@@ -65,6 +398,7 @@ public:
     void removeLastPoint();
     void clearPoints();
     void selectImage(size_t frameIndex);
+    void detectPoints();
     void analyse();
     bool isFilterSet() const;
     std::vector<ImageD*>* testCorrelation();
@@ -74,8 +408,60 @@ public:
     Movie *movie;
     unsigned int windowWidth;
     unsigned int windowHeight;
+    // Per-particle windows, at most windowWidth x windowHeight, that shrink
+    // while the particle stays near their centre
+    bool adaptiveWindows;
     double fitRadius;
+    LocalizationMethod localizationMethod;
+    SubPixelMethod subPixelMethod;
+    // Precision of the upsampled DFT, in fractions of a pixel
+    unsigned int upsamplingFactor;
+    CorrelationMethod correlationMethod;
+    // Zero-mean normalized cross-correlation (ZNCC) instead of the plain
+    // correlation
+    bool normalizedCorrelation;
+    // Direct correlation of float pixels and filter, whose rows are summed
+    // in double, instead of double ones: about twice as fast with the SIMD
+    // kernels, but with the full filter only (not its separable or sparse
+    // forms)
+    bool singlePrecision;
+    // Fraction of the energy of the filter kept by its approximation as a
+    // sum of separable terms, which the direct kernels use when it is
+    // cheaper than the full filter (0 to always use the full filter)
+    double separableEnergy;
+    // Filter coefficients whose magnitude is at most this fraction of the
+    // largest one are skipped by the direct kernels, which then use a sparse
+    // form of the filter if few enough coefficients are left (0 to only skip
+    // the zeros)
+    double sparseThreshold;
+    // Length of the temporal chunks that are tracked concurrently (0 to
+    // disable them), and size of the window searched for their seeds.
+    size_t chunkLength;
+    unsigned int seedWindowWidth;
+    unsigned int seedWindowHeight;
+    // Number of downsampled levels of the coarse-to-fine search (0 to
+    // search the whole window at full resolution).  Not used with the
+    // normalized correlation.
+    unsigned int pyramidLevels;
+    // Centre of the correlation windows: previous position, or position
+    // predicted from the past motion of each particle
+    MotionPredictor::Model motionModel;
+    // Estimation of the global drift of the frames, that moves all the
+    // windows
+    bool driftCorrection;
+    // Mean absolute difference per pixel, in grey levels, below which the
+    // region of a window is considered unchanged since the last frame in
+    // which the particle was located, whose position is then reused (0 to
+    // always locate the particles)
+    double unchangedThreshold;
+    // Particle detection by detectPoints(): fraction of the highest
+    // correlation value of the frame that the maxima must reach, and
+    // distance along each axis within which they must be the highest
+    double detectionThreshold;
+    unsigned int detectionRadius;
     size_t currFrameIndex;
+    // Progress of analyse(), in frames
+    size_t nAnalysedFrames;
 
     class AnalyseException : public std::exception
     {
@@ -0,0 +1,167 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include "math/driftestimator.h"
+
+
+namespace
+{
+    unsigned int binningFactor(const unsigned int imageWidth,
+                               const unsigned int imageHeight)
+    {
+        unsigned int binning = 1;
+        while (std::max(imageWidth, imageHeight) / binning > DriftEstimator::MAX_SIZE)
+            binning *= 2;
+        return binning;
+    }
+
+    std::vector<double> hann(const unsigned int n)
+    {
+        const double pi = std::acos(-1.0);
+        std::vector<double> weights(n);
+        for (unsigned int i = 0; i < n; i++)
+            weights[i] = 0.5 - 0.5 * std::cos(2.0 * pi * (i + 0.5) / n);
+        return weights;
+    }
+}
+
+
+const unsigned int DriftEstimator::MAX_SIZE = 256;
+
+DriftEstimator::DriftEstimator(const unsigned int imageWidth,
+                               const unsigned int imageHeight)
+    : binning{binningFactor(imageWidth, imageHeight)},
+      binnedWidth{std::max(imageWidth / binning, 1u)},
+      binnedHeight{std::max(imageHeight / binning, 1u)}
+{
+    fft = new FFT2D(FFT2D::goodSize(binnedWidth), FFT2D::goodSize(binnedHeight));
+    previousSpectrum.resize(2 * (size_t) fft->width * fft->height);
+    spectrum.resize(2 * (size_t) fft->width * fft->height);
+    binned.resize((size_t) binnedWidth * binnedHeight);
+    hannX = hann(binnedWidth);
+    hannY = hann(binnedHeight);
+}
+
+DriftEstimator::~DriftEstimator()
+{
+    delete fft;
+}
+
+PointD DriftEstimator::estimate(const ImageView<uint8_t> &previous,
+                                const ImageView<uint8_t> &current)
+{
+    transform(previous, previousSpectrum);
+    transform(current, spectrum);
+    return peak();
+}
+
+PointD DriftEstimator::estimate(const ImageView<uint16_t> &previous,
+                                const ImageView<uint16_t> &current)
+{
+    transform(previous, previousSpectrum);
+    transform(current, spectrum);
+    return peak();
+}
+
+template<typename PixelDataType>
+void DriftEstimator::transform(const ImageView<PixelDataType> &image,
+                               std::vector<double> &output)
+{
+    // Spectrum of the binned image, without its mean and weighted by the
+    // Hann window.  The incomplete bins of the last row and column are
+    // dropped.
+    std::fill(binned.begin(), binned.end(), 0.0);
+    for (unsigned int j = 0; j < binnedHeight * binning && j < image.height; j++)
+    {
+        const PixelDataType * const pixels = image.row(j);
+        double * const binnedRow = binned.data() + (size_t) (j / binning) * binnedWidth;
+        for (unsigned int i = 0; i < binnedWidth * binning && i < image.width; i++)
+            binnedRow[i / binning] += (double) pixels[i];
+    }
+    double mean = 0.0;
+    for (double const& value : binned)
+        mean += value;
+    mean /= binned.size();
+
+    std::fill(output.begin(), output.end(), 0.0);
+    for (unsigned int j = 0; j < binnedHeight; j++)
+    {
+        const double * const binnedRow = binned.data() + (size_t) j * binnedWidth;
+        double * const outputRow = output.data() + 2 * (size_t) j * fft->width;
+        for (unsigned int i = 0; i < binnedWidth; i++)
+            outputRow[2 * i] = (binnedRow[i] - mean) * hannX[i] * hannY[j];
+    }
+    fft->forward(output.data(), binnedHeight);
+}
+
+PointD DriftEstimator::peak()
+{
+    // Shift of the current frame from the previous one, from the peak of
+    // the phase correlation of their spectra.
+    const size_t nValues = (size_t) fft->width * fft->height;
+    for (size_t k = 0; k < nValues; k++)
+    {
+        // Current spectrum times the complex conjugate of the previous one,
+        // normalized
+        const double a = spectrum[2 * k];
+        const double b = spectrum[2 * k + 1];
+        const double c = previousSpectrum[2 * k];
+        const double d = previousSpectrum[2 * k + 1];
+        const double re = a * c + b * d;
+        const double im = b * c - a * d;
+        const double norm = std::hypot(re, im);
+        spectrum[2 * k] = norm > 0.0 ? re / norm : 0.0;
+        spectrum[2 * k + 1] = norm > 0.0 ? im / norm : 0.0;
+    }
+    fft->inverse(spectrum.data());
+
+    const unsigned int width = fft->width;
+    const unsigned int height = fft->height;
+    size_t kMax = 0;
+    for (size_t k = 1; k < nValues; k++)
+        if (spectrum[2 * k] > spectrum[2 * kMax])
+            kMax = k;
+    const unsigned int iMax = (unsigned int) (kMax % width);
+    const unsigned int jMax = (unsigned int) (kMax / width);
+
+    // Parabola through the peak and its (periodic) neighbours
+    auto value = [&](const unsigned int i, const unsigned int j)
+    {
+        return spectrum[2 * ((size_t) (j % height) * width + i % width)];
+    };
+    auto vertex = [](const double before, const double centre, const double after)
+    {
+        const double curvature = before - 2.0 * centre + after;
+        return curvature < 0.0 ? 0.5 * (before - after) / curvature : 0.0;
+    };
+    double x = iMax + vertex(value(iMax + width - 1, jMax), value(iMax, jMax),
+                             value(iMax + 1, jMax));
+    double y = jMax + vertex(value(iMax, jMax + height - 1), value(iMax, jMax),
+                             value(iMax, jMax + 1));
+    // Negative shifts wrap around.
+    if (x > width / 2.0)
+        x -= width;
+    if (y > height / 2.0)
+        y -= height;
+    return PointD(x * binning, y * binning);
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <vector>
+#include "fft2d.h"
+#include "imageview.h"
+#include "pointd.h"
+
+
+// Estimates the global shift between two frames by phase correlation.
+//
+// The frames are binned by a power of 2, so that their largest side is at
+// most MAX_SIZE pixels, and weighted by a Hann window against the edge
+// discontinuities of the periodic transform.  The peak of the inverse
+// transform of the normalized cross-power spectrum gives the shift, refined
+// to sub-pixel by a parabola along each axis.  Shifts up to half the frame
+// size can be found, with an accuracy of a fraction of the binning.
+class DriftEstimator
+{
+private:
+    FFT2D *fft;
+    std::vector<double> previousSpectrum;
+    std::vector<double> spectrum;
+    std::vector<double> binned;
+    std::vector<double> hannX;
+    std::vector<double> hannY;
+
+    template<typename PixelDataType>
+        void transform(const ImageView<PixelDataType> &image,
+                       std::vector<double> &output);
+    PointD peak();
+
+public:
+    explicit DriftEstimator(const unsigned int imageWidth,
+                            const unsigned int imageHeight);
+    ~DriftEstimator();
+    DriftEstimator(const DriftEstimator&) =delete;
+    DriftEstimator& operator=(const DriftEstimator&) =delete;
+    DriftEstimator(DriftEstimator&&) =delete;
+    DriftEstimator& operator=(DriftEstimator&&) =delete;
+
+    PointD estimate(const ImageView<uint8_t> &previous,
+                    const ImageView<uint8_t> &current);
+    PointD estimate(const ImageView<uint16_t> &previous,
+                    const ImageView<uint16_t> &current);
+
+    static const unsigned int MAX_SIZE;
+    const unsigned int binning;
+    const unsigned int binnedWidth;
+    const unsigned int binnedHeight;
+};
@@ -0,0 +1,101 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <cmath>
+#include <gsl/gsl_fft_complex.h>
+#include "math/fft2d.h"
+
+
+FFT2D::FFT2D(const unsigned int width, const unsigned int height)
+    : rowWavetable{gsl_fft_complex_wavetable_alloc(width)},
+      columnWavetable{gsl_fft_complex_wavetable_alloc(height)},
+      rowWorkspace{gsl_fft_complex_workspace_alloc(width)},
+      columnWorkspace{gsl_fft_complex_workspace_alloc(height)},
+      width{width}, height{height}
+{}
+
+FFT2D::~FFT2D()
+{
+    gsl_fft_complex_wavetable_free(rowWavetable);
+    gsl_fft_complex_wavetable_free(columnWavetable);
+    gsl_fft_complex_workspace_free(rowWorkspace);
+    gsl_fft_complex_workspace_free(columnWorkspace);
+}
+
+void FFT2D::forward(double * const data, const unsigned int nRows)
+{
+    // Forward transform of data where only the first nRows rows may be
+    // non-zero.  The transforms of the other (zero) rows are skipped.
+    for (unsigned int j = 0; j < nRows; j++)
+        gsl_fft_complex_forward(data + 2 * (size_t) j * width, 1, width,
+                                rowWavetable, rowWorkspace);
+    for (unsigned int i = 0; i < width; i++)
+        gsl_fft_complex_forward(data + 2 * (size_t) i, width, height,
+                                columnWavetable, columnWorkspace);
+}
+
+void FFT2D::forward(double * const data)
+{
+    forward(data, height);
+}
+
+void FFT2D::inverse(double * const data, const unsigned int nRows)
+{
+    // Normalized inverse transform, where only the first nRows rows of the
+    // result are needed.  The other rows are left partially transformed.
+    for (unsigned int i = 0; i < width; i++)
+        gsl_fft_complex_inverse(data + 2 * (size_t) i, width, height,
+                                columnWavetable, columnWorkspace);
+    for (unsigned int j = 0; j < nRows; j++)
+        gsl_fft_complex_inverse(data + 2 * (size_t) j * width, 1, width,
+                                rowWavetable, rowWorkspace);
+}
+
+void FFT2D::inverse(double * const data)
+{
+    inverse(data, height);
+}
+
+unsigned int FFT2D::goodSize(const unsigned int n)
+{
+    // Smallest size >= n whose only prime factors are 2, 3 and 5, for which
+    // the GSL mixed-radix transforms are efficient.
+    unsigned int size = n > 1 ? n : 1;
+    while (true)
+    {
+        unsigned int m = size;
+        while (m % 2 == 0) m /= 2;
+        while (m % 3 == 0) m /= 3;
+        while (m % 5 == 0) m /= 5;
+        if (m == 1)
+            return size;
+        size++;
+    }
+}
+
+double FFT2D::cost(const unsigned int width, const unsigned int height)
+{
+    // Approximate number of floating point operations of a full 2D complex
+    // transform (5 N log2 N per 1D transform of length N).
+    const double w = (double) width;
+    const double h = (double) height;
+    return 5.0 * w * h * (std::log2(w > 1.0 ? w : 2.0) + std::log2(h > 1.0 ? h : 2.0));
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <gsl/gsl_fft_complex.h>
+
+
+// Two-dimensional complex FFT of a fixed size.
+//
+// The GSL wavetables and workspaces are allocated once in the constructor, so
+// that an instance can be reused for many transforms of the same size.  Data
+// are packed complex arrays (real and imaginary parts interleaved) stored row
+// by row.
+class FFT2D
+{
+private:
+    gsl_fft_complex_wavetable *rowWavetable;
+    gsl_fft_complex_wavetable *columnWavetable;
+    gsl_fft_complex_workspace *rowWorkspace;
+    gsl_fft_complex_workspace *columnWorkspace;
+
+public:
+    explicit FFT2D(const unsigned int width, const unsigned int height);
+    ~FFT2D();
+    FFT2D(const FFT2D&) =delete;
+    FFT2D& operator=(const FFT2D&) =delete;
+    FFT2D(FFT2D&&) =delete;
+    FFT2D& operator=(FFT2D&&) =delete;
+
+    void forward(double * const data, const unsigned int nRows);
+    void forward(double * const data);
+    void inverse(double * const data, const unsigned int nRows);
+    void inverse(double * const data);
+
+    static unsigned int goodSize(const unsigned int n);
+    static double cost(const unsigned int width, const unsigned int height);
+
+    const unsigned int width;
+    const unsigned int height;
+};
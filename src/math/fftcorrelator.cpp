@@ -0,0 +1,131 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include "math/fftcorrelator.h"
+#include "math/corrfilter.h"
+#include "math/fft2d.h"
+
+
+FFTCorrelator::FFTCorrelator(const CorrFilter * const filter,
+                             const unsigned int windowWidth,
+                             const unsigned int windowHeight)
+    : fft{new FFT2D(FFT2D::goodSize(windowWidth + filter->width - 1),
+                    FFT2D::goodSize(windowHeight + filter->height - 1))},
+      buffer(2 * (size_t) fft->width * fft->height),
+      filterWidth{filter->width}, filterHeight{filter->height},
+      windowWidth{windowWidth}, windowHeight{windowHeight}
+{
+    const double * const spectrum = filter->getSpectrum(fft->width, fft->height);
+    filterSpectrum.assign(spectrum, spectrum + buffer.size());
+}
+
+FFTCorrelator::~FFTCorrelator()
+{
+    delete fft;
+}
+
+void FFTCorrelator::correlate(const double * const image,
+                              const size_t imageStride,
+                              double * const output)
+{
+    // Computes the windowWidth x windowHeight correlation map of the image
+    // region whose top-left pixel is pointed by image, and whose size is that
+    // of the window enlarged by the filter footprint.
+    //
+    // As the transform size is at least that of this region, the circular
+    // correlation does not wrap around for the requested output values.
+
+    const unsigned int outerWidth = windowWidth + filterWidth - 1;
+    const unsigned int outerHeight = windowHeight + filterHeight - 1;
+    const size_t fftWidth = fft->width;
+    const size_t nValues = fftWidth * fft->height;
+    std::fill(buffer.begin(), buffer.end(), 0.0);
+    for (unsigned int j = 0; j < outerHeight; j++)
+    {
+        const double * const imageRow = image + j * imageStride;
+        double * const bufferRow = buffer.data() + 2 * j * fftWidth;
+        for (unsigned int i = 0; i < outerWidth; i++)
+            bufferRow[2 * i] = imageRow[i];
+    }
+
+    fft->forward(buffer.data(), outerHeight);
+
+    // Multiply by the complex conjugate of the filter spectrum
+    for (size_t k = 0; k < nValues; k++)
+    {
+        const double a = buffer[2 * k];
+        const double b = buffer[2 * k + 1];
+        const double c = filterSpectrum[2 * k];
+        const double d = filterSpectrum[2 * k + 1];
+        buffer[2 * k] = a * c + b * d;
+        buffer[2 * k + 1] = b * c - a * d;
+    }
+
+    fft->inverse(buffer.data(), windowHeight);
+
+    for (unsigned int j = 0; j < windowHeight; j++)
+    {
+        const double * const bufferRow = buffer.data() + 2 * j * fftWidth;
+        for (unsigned int i = 0; i < windowWidth; i++)
+            output[j * windowWidth + i] = bufferRow[2 * i];
+    }
+}
+
+double FFTCorrelator::cost(const unsigned int filterWidth,
+                          const unsigned int filterHeight,
+                          const unsigned int windowWidth,
+                          const unsigned int windowHeight)
+{
+    // Approximate number of operations of correlate(): forward and inverse
+    // transforms, and product of the spectra.
+    const unsigned int fftWidth = FFT2D::goodSize(windowWidth + filterWidth - 1);
+    const unsigned int fftHeight = FFT2D::goodSize(windowHeight + filterHeight - 1);
+    return 2.0 * FFT2D::cost(fftWidth, fftHeight) + 6.0 * fftWidth * fftHeight;
+}
+
+double FFTCorrelator::directCost(const unsigned int filterWidth,
+                                const unsigned int filterHeight,
+                                const unsigned int windowWidth,
+                                const unsigned int windowHeight)
+{
+    // Cost of the direct kernels, in the same units as cost().  They need 2
+    // operations per filter coefficient and output value, but run several
+    // times faster per operation than the (scalar) GSL transforms thanks to
+    // SIMD.
+    const double DIRECT_SPEEDUP = 4.0;
+    return 2.0 * windowWidth * windowHeight
+           * filterWidth * filterHeight / DIRECT_SPEEDUP;
+}
+
+double FFTCorrelator::separableCost(const unsigned int filterWidth,
+                                    const unsigned int filterHeight,
+                                    const unsigned int windowWidth,
+                                    const unsigned int windowHeight,
+                                    const unsigned int rank)
+{
+    // Cost of the direct kernels with a sum of rank separable terms: for each
+    // term, a column pass over the full width of the region covered by the
+    // filter, and a row pass over the window.
+    return rank * (directCost(1, filterHeight,
+                              windowWidth + filterWidth - 1, windowHeight)
+                   + directCost(filterWidth, 1, windowWidth, windowHeight));
+}
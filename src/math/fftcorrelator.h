@@ -0,0 +1,77 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <cstddef>
+#include <vector>
+#include "corrfilter.h"
+#include "fft2d.h"
+
+
+// Computes correlation maps in the frequency domain.
+//
+// The FFT plans, the scratch buffer and the filter spectrum are set up once
+// for a given filter and window size, and reused for all the particles and
+// frames.  The spectrum is copied from the cache of the CorrFilter, which is
+// not thread-safe, so that several correlators may run concurrently, and a
+// correlator must be rebuilt when the filter is reloaded.  The maps are the
+// same as those of the direct-space kernels, up to rounding errors of the
+// order of 1e-15 times sum |image * filter|.
+class FFTCorrelator
+{
+private:
+    FFT2D *fft;
+    std::vector<double> filterSpectrum;
+    std::vector<double> buffer;
+
+public:
+    explicit FFTCorrelator(const CorrFilter * const filter,
+                           const unsigned int windowWidth,
+                           const unsigned int windowHeight);
+    ~FFTCorrelator();
+    FFTCorrelator(const FFTCorrelator&) =delete;
+    FFTCorrelator& operator=(const FFTCorrelator&) =delete;
+    FFTCorrelator(FFTCorrelator&&) =delete;
+    FFTCorrelator& operator=(FFTCorrelator&&) =delete;
+
+    void correlate(const double * const image, const size_t imageStride,
+                   double * const output);
+    static double cost(const unsigned int filterWidth,
+                       const unsigned int filterHeight,
+                       const unsigned int windowWidth,
+                       const unsigned int windowHeight);
+    static double directCost(const unsigned int filterWidth,
+                             const unsigned int filterHeight,
+                             const unsigned int windowWidth,
+                             const unsigned int windowHeight);
+    static double separableCost(const unsigned int filterWidth,
+                                const unsigned int filterHeight,
+                                const unsigned int windowWidth,
+                                const unsigned int windowHeight,
+                                const unsigned int rank);
+
+    const unsigned int filterWidth;
+    const unsigned int filterHeight;
+    const unsigned int windowWidth;
+    const unsigned int windowHeight;
+};
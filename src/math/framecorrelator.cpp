@@ -0,0 +1,266 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include "math/framecorrelator.h"
+#include "math/fftcorrelator.h"
+#include "math/fft2d.h"
+
+
+FrameCorrelator::FrameCorrelator(const CorrFilter * const filter,
+                                 const unsigned int imageWidth,
+                                 const unsigned int imageHeight)
+    : filter{filter},
+      nTilesX{0}, nTilesY{0},
+      filterWidth{filter->width}, filterHeight{filter->height},
+      imageWidth{imageWidth}, imageHeight{imageHeight},
+      tileWidth{tileSize(filter->width, imageWidth)},
+      tileHeight{tileSize(filter->height, imageHeight)},
+      correlation((size_t) imageWidth * imageHeight, 0.0)
+{
+    if (imageWidth >= filterWidth)
+        nTilesX = (imageWidth - filterWidth + tileWidth) / tileWidth;
+    if (imageHeight >= filterHeight)
+        nTilesY = (imageHeight - filterHeight + tileHeight) / tileHeight;
+
+    tileNeeded.assign((size_t) nTilesX * nTilesY, false);
+}
+
+FrameCorrelator::~FrameCorrelator()
+{
+    for (TileWorker &worker : workers)
+        delete worker.correlator;
+}
+
+unsigned int FrameCorrelator::tileSize(const unsigned int filterSize,
+                                       const unsigned int imageSize)
+{
+    // Number of output values per tile along one dimension.  The transform
+    // size is chosen to minimize the cost per output value of the
+    // overlap-save method, N log N / (N - filterSize + 1).
+    const unsigned int nValid = imageSize >= filterSize ? imageSize - filterSize + 1 : 1;
+    const unsigned int maxSize = std::max(64u, 8 * filterSize);
+    unsigned int bestSize = FFT2D::goodSize(filterSize + 1);
+    double bestCost = HUGE_VAL;
+    for (unsigned int n = bestSize; n <= maxSize; n = FFT2D::goodSize(n + 1))
+    {
+        const double cost = n * std::log2((double) n) / (n - filterSize + 1);
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            bestSize = n;
+        }
+    }
+    return std::min(bestSize - filterSize + 1, nValid);
+}
+
+void FrameCorrelator::windowTiles(const Point point,
+                                  const unsigned int windowWidth,
+                                  const unsigned int windowHeight,
+                                  const unsigned int filterWidth,
+                                  const unsigned int filterHeight,
+                                  const unsigned int tileWidth,
+                                  const unsigned int tileHeight,
+                                  const unsigned int nTilesX,
+                                  const unsigned int nTilesY,
+                                  unsigned int &txMin, unsigned int &txMax,
+                                  unsigned int &tyMin, unsigned int &tyMax)
+{
+    // Range of the tiles that intersect the correlation window of point.
+    // The range is empty (min > max) if none does.
+    const int uMin = (int) point.x - (int) (windowWidth / 2) - (int) (filterWidth / 2);
+    const int vMin = (int) point.y - (int) (windowHeight / 2) - (int) (filterHeight / 2);
+    const int uMax = uMin + (int) windowWidth - 1;
+    const int vMax = vMin + (int) windowHeight - 1;
+    const int uLast = (int) (nTilesX * tileWidth) - 1;
+    const int vLast = (int) (nTilesY * tileHeight) - 1;
+    txMin = 1;
+    txMax = 0;
+    tyMin = 1;
+    tyMax = 0;
+    if (uMax < 0 || vMax < 0 || uMin > uLast || vMin > vLast)
+        return;
+    txMin = (unsigned int) std::max(uMin, 0) / tileWidth;
+    txMax = (unsigned int) std::min(uMax, uLast) / tileWidth;
+    tyMin = (unsigned int) std::max(vMin, 0) / tileHeight;
+    tyMax = (unsigned int) std::min(vMax, vLast) / tileHeight;
+}
+
+void FrameCorrelator::markWindow(const Point point,
+                                 const unsigned int windowWidth,
+                                 const unsigned int windowHeight)
+{
+    // Requests the correlation values of the window of point for the next
+    // call to correlate().
+    unsigned int txMin, txMax, tyMin, tyMax;
+    windowTiles(point, windowWidth, windowHeight, filterWidth, filterHeight,
+                tileWidth, tileHeight, nTilesX, nTilesY,
+                txMin, txMax, tyMin, tyMax);
+    for (unsigned int ty = tyMin; ty <= tyMax; ty++)
+        for (unsigned int tx = txMin; tx <= txMax; tx++)
+            tileNeeded[ty * nTilesX + tx] = true;
+}
+
+void FrameCorrelator::markAll()
+{
+    // Requests the correlation values of the whole frame for the next call
+    // to correlate().
+    std::fill(tileNeeded.begin(), tileNeeded.end(), true);
+}
+
+void FrameCorrelator::correlate(const ImageView<uint8_t> &image,
+                                ThreadPool * const threadPool)
+{
+    correlateTiles(image, threadPool);
+}
+
+void FrameCorrelator::correlate(const ImageView<uint16_t> &image,
+                                ThreadPool * const threadPool)
+{
+    correlateTiles(image, threadPool);
+}
+
+template<typename PixelDataType>
+void FrameCorrelator::correlateTiles(const ImageView<PixelDataType> &image,
+                                     ThreadPool * const threadPool)
+{
+    // Correlates the marked tiles of image (of size imageWidth x imageHeight)
+    // and clears the marks.  The tiles write disjoint parts of correlation,
+    // and are correlated concurrently by the threads of threadPool, if not
+    // null.
+
+    std::vector<size_t> tiles;
+    for (size_t tile = 0; tile < tileNeeded.size(); tile++)
+    {
+        if (tileNeeded[tile])
+            tiles.push_back(tile);
+    }
+    std::fill(tileNeeded.begin(), tileNeeded.end(), false);
+
+    // The correlators are built here, in the calling thread, as they make the
+    // filter cache its spectrum.
+    const unsigned int nWorkers = threadPool != nullptr ? threadPool->nThreads : 1;
+    while (workers.size() < nWorkers)
+    {
+        TileWorker worker;
+        worker.correlator = new FFTCorrelator(filter, tileWidth, tileHeight);
+        worker.paddedTile.resize((size_t) (tileWidth + filterWidth - 1)
+                                 * (tileHeight + filterHeight - 1));
+        worker.tileOutput.resize((size_t) tileWidth * tileHeight);
+        workers.push_back(worker);
+    }
+
+    if (threadPool != nullptr)
+    {
+        threadPool->run(tiles.size(), [&](const size_t task, const unsigned int worker)
+        {
+            correlateTile(image, tiles[task], workers[worker]);
+        });
+    }
+    else
+    {
+        for (size_t tile : tiles)
+            correlateTile(image, tile, workers[0]);
+    }
+}
+
+template<typename PixelDataType>
+void FrameCorrelator::correlateTile(const ImageView<PixelDataType> &image,
+                                    const size_t tile, TileWorker &worker)
+{
+    // Correlates the tile of index ty * nTilesX + tx into correlation.
+
+    const unsigned int outerWidth = tileWidth + filterWidth - 1;
+    const unsigned int outerHeight = tileHeight + filterHeight - 1;
+    const unsigned int nValidX = imageWidth - filterWidth + 1;
+    const unsigned int nValidY = imageHeight - filterHeight + 1;
+    std::vector<double> &paddedTile = worker.paddedTile;
+    std::vector<double> &tileOutput = worker.tileOutput;
+
+    const unsigned int u0 = (unsigned int) (tile % nTilesX) * tileWidth;
+    const unsigned int v0 = (unsigned int) (tile / nTilesX) * tileHeight;
+    const unsigned int copyWidth = std::min(outerWidth, imageWidth - u0);
+    const unsigned int copyHeight = std::min(outerHeight, imageHeight - v0);
+    // The last tiles overlap the frame edges: zero-pad them.
+    if (copyWidth < outerWidth || copyHeight < outerHeight)
+        std::fill(paddedTile.begin(), paddedTile.end(), 0.0);
+    image.region(u0, v0, copyWidth, copyHeight).convert(paddedTile.data(),
+                                                        outerWidth);
+    worker.correlator->correlate(paddedTile.data(), outerWidth,
+                                 tileOutput.data());
+
+    const unsigned int validWidth = std::min(tileWidth, nValidX - u0);
+    const unsigned int validHeight = std::min(tileHeight, nValidY - v0);
+    for (unsigned int j = 0; j < validHeight; j++)
+        std::copy(tileOutput.begin() + (size_t) j * tileWidth,
+                  tileOutput.begin() + (size_t) j * tileWidth + validWidth,
+                  correlation.begin() + (size_t) (v0 + j) * imageWidth + u0);
+}
+
+double FrameCorrelator::cost(const unsigned int filterWidth,
+                             const unsigned int filterHeight,
+                             const unsigned int imageWidth,
+                             const unsigned int imageHeight,
+                             const std::vector<Point> &points,
+                             const unsigned int windowWidth,
+                             const unsigned int windowHeight)
+{
+    // Approximate number of operations of correlate() for the windows of
+    // points, in the units of FFTCorrelator::cost().
+    const unsigned int tileWidth = tileSize(filterWidth, imageWidth);
+    const unsigned int tileHeight = tileSize(filterHeight, imageHeight);
+    const unsigned int nTilesX = imageWidth >= filterWidth
+                                 ? (imageWidth - filterWidth + tileWidth) / tileWidth : 0;
+    const unsigned int nTilesY = imageHeight >= filterHeight
+                                 ? (imageHeight - filterHeight + tileHeight) / tileHeight : 0;
+
+    std::vector<bool> needed((size_t) nTilesX * nTilesY, false);
+    for (Point const& point : points)
+    {
+        unsigned int txMin, txMax, tyMin, tyMax;
+        windowTiles(point, windowWidth, windowHeight, filterWidth, filterHeight,
+                    tileWidth, tileHeight, nTilesX, nTilesY,
+                    txMin, txMax, tyMin, tyMax);
+        for (unsigned int ty = tyMin; ty <= tyMax; ty++)
+            for (unsigned int tx = txMin; tx <= txMax; tx++)
+                needed[ty * nTilesX + tx] = true;
+    }
+    const size_t nTiles = std::count(needed.begin(), needed.end(), true);
+    return nTiles * FFTCorrelator::cost(filterWidth, filterHeight,
+                                        tileWidth, tileHeight);
+}
+
+double FrameCorrelator::cost(const unsigned int filterWidth,
+                             const unsigned int filterHeight,
+                             const unsigned int imageWidth,
+                             const unsigned int imageHeight)
+{
+    // Same, for the whole frame.
+    const unsigned int tileWidth = tileSize(filterWidth, imageWidth);
+    const unsigned int tileHeight = tileSize(filterHeight, imageHeight);
+    const unsigned int nTilesX = imageWidth >= filterWidth
+                                 ? (imageWidth - filterWidth + tileWidth) / tileWidth : 0;
+    const unsigned int nTilesY = imageHeight >= filterHeight
+                                 ? (imageHeight - filterHeight + tileHeight) / tileHeight : 0;
+    return (double) nTilesX * nTilesY * FFTCorrelator::cost(filterWidth, filterHeight,
+                                                             tileWidth, tileHeight);
+}
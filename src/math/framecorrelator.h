@@ -0,0 +1,121 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <vector>
+#include "corrfilter.h"
+#include "fftcorrelator.h"
+#include "imageview.h"
+#include "point.h"
+#include "threadpool.h"
+
+
+// Correlates a whole frame with the filter, once for all particles.
+//
+// The frame is covered by tiles that are correlated in the frequency domain
+// (overlap-save).  Only the tiles that intersect the correlation windows
+// marked with markWindow() are computed, so that the cost per frame is
+// bounded by the frame area, whatever the number of particles.  The frame
+// pixels are read directly, and only those of these tiles are converted to
+// double.  The tiles are independent, and are spread over the threads of
+// the pool passed to correlate(), if any.
+//
+// correlation[v * imageWidth + u] is the correlation of the filter with the
+// image region whose top-left pixel is (u, v).  It is only set for the marked
+// windows, or for the whole frame after markAll().
+class FrameCorrelator
+{
+private:
+    // Correlator and scratch buffers of a thread
+    struct TileWorker
+    {
+        FFTCorrelator *correlator;
+        std::vector<double> paddedTile;
+        std::vector<double> tileOutput;
+    };
+
+    const CorrFilter * const filter;
+    std::vector<TileWorker> workers;
+    std::vector<bool> tileNeeded;
+    unsigned int nTilesX;
+    unsigned int nTilesY;
+
+    template<typename PixelDataType>
+        void correlateTiles(const ImageView<PixelDataType> &image,
+                            ThreadPool * const threadPool);
+    template<typename PixelDataType>
+        void correlateTile(const ImageView<PixelDataType> &image,
+                           const size_t tile, TileWorker &worker);
+    static unsigned int tileSize(const unsigned int filterSize,
+                                 const unsigned int imageSize);
+    static void windowTiles(const Point point,
+                            const unsigned int windowWidth,
+                            const unsigned int windowHeight,
+                            const unsigned int filterWidth,
+                            const unsigned int filterHeight,
+                            const unsigned int tileWidth,
+                            const unsigned int tileHeight,
+                            const unsigned int nTilesX,
+                            const unsigned int nTilesY,
+                            unsigned int &txMin, unsigned int &txMax,
+                            unsigned int &tyMin, unsigned int &tyMax);
+
+public:
+    explicit FrameCorrelator(const CorrFilter * const filter,
+                             const unsigned int imageWidth,
+                             const unsigned int imageHeight);
+    ~FrameCorrelator();
+    FrameCorrelator(const FrameCorrelator&) =delete;
+    FrameCorrelator& operator=(const FrameCorrelator&) =delete;
+    FrameCorrelator(FrameCorrelator&&) =delete;
+    FrameCorrelator& operator=(FrameCorrelator&&) =delete;
+
+    void markWindow(const Point point,
+                    const unsigned int windowWidth,
+                    const unsigned int windowHeight);
+    void markAll();
+    void correlate(const ImageView<uint8_t> &image,
+                   ThreadPool * const threadPool);
+    void correlate(const ImageView<uint16_t> &image,
+                   ThreadPool * const threadPool);
+    static double cost(const unsigned int filterWidth,
+                       const unsigned int filterHeight,
+                       const unsigned int imageWidth,
+                       const unsigned int imageHeight,
+                       const std::vector<Point> &points,
+                       const unsigned int windowWidth,
+                       const unsigned int windowHeight);
+    static double cost(const unsigned int filterWidth,
+                       const unsigned int filterHeight,
+                       const unsigned int imageWidth,
+                       const unsigned int imageHeight);
+
+    const unsigned int filterWidth;
+    const unsigned int filterHeight;
+    const unsigned int imageWidth;
+    const unsigned int imageHeight;
+    const unsigned int tileWidth;
+    const unsigned int tileHeight;
+    std::vector<double> correlation;
+};
@@ -0,0 +1,79 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#pragma once
+
+
+#include <cstddef>
+#include "movie/base/frame.h"
+
+
+// Non-owning view of a rectangular region of an image, such as the pixels of
+// a Frame.  Rows are stride pixels apart, so that a region can be viewed
+// without copying it.
+template<typename PixelDataType>
+class ImageView
+{
+public:
+    ImageView(const PixelDataType * const data,
+              const unsigned int width, const unsigned int height,
+              const size_t stride)
+        : data{data}, width{width}, height{height}, stride{stride}
+    {}
+
+    explicit ImageView(const Frame<PixelDataType> &frame)
+        : data{frame.pixelsData}, width{frame.width}, height{frame.height},
+          stride{frame.width}
+    {}
+
+    const PixelDataType* row(const unsigned int j) const
+    {
+        return data + j * stride;
+    }
+
+    ImageView region(const unsigned int x, const unsigned int y,
+                     const unsigned int regionWidth,
+                     const unsigned int regionHeight) const
+    {
+        // The region must be inside the view.
+        return ImageView(data + y * stride + x, regionWidth, regionHeight,
+                         stride);
+    }
+
+    template<typename OutputType>
+    void convert(OutputType * const output, const size_t outputStride) const
+    {
+        // Copies the pixels to output, as double or float.
+        for (unsigned int j = 0; j < height; j++)
+        {
+            const PixelDataType * const pixels = row(j);
+            OutputType * const outputRow = output + j * outputStride;
+            for (unsigned int i = 0; i < width; i++)
+                outputRow[i] = (OutputType) pixels[i];
+        }
+    }
+
+    const PixelDataType *data;
+    unsigned int width;
+    unsigned int height;
+    size_t stride;
+};
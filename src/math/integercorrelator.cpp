@@ -0,0 +1,112 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include "math/integercorrelator.h"
+#include "math/correlationkernels.h"
+
+
+IntegerCorrelator::IntegerCorrelator(const CorrFilter * const filter,
+                                     const Movie * const movie)
+    : filterStride{filter->width + filter->width % 2},
+      pixelOffset{0},
+      offsetCorrection{0},
+      filterWidth{filter->width}, filterHeight{filter->height},
+      bitsPerSample{movie->bitsPerSample},
+      scale{1.0},
+      quantizationError{0.0}
+{
+    // Largest magnitude of the pixels as seen by the kernels.  Pixels that do
+    // not fit in an int16 are shifted by -32768.
+    const int64_t maxPixel = ((int64_t) 1 << bitsPerSample) - 1;
+    if (maxPixel > 32767)
+        pixelOffset = 0x8000;
+    const int64_t maxPixelMagnitude = std::max(maxPixel - (int64_t) pixelOffset,
+                                               (int64_t) pixelOffset);
+
+    // Largest quantized coefficient such that the int32 sums of a filter row
+    // do not overflow.
+    const int64_t maxCoefficient = std::min<int64_t>(32767,
+                                                     INT32_MAX / (filterStride * std::max<int64_t>(maxPixelMagnitude, 1)));
+
+    double maxAbs = 0.0;
+    for (unsigned int k = 0; k < filterWidth * filterHeight; k++)
+        maxAbs = std::max(maxAbs, std::fabs(filter->filter[k]));
+    if (maxAbs > 0.0)
+        scale = (double) maxCoefficient / maxAbs;
+
+    quantizedFilter.assign((size_t) filterStride * filterHeight, 0);
+    int64_t coefficientsSum = 0;
+    for (unsigned int y = 0; y < filterHeight; y++)
+    {
+        for (unsigned int x = 0; x < filterWidth; x++)
+        {
+            const double value = filter->getFilterValue(x, y);
+            const int16_t q = (int16_t) std::lround(value * scale);
+            quantizedFilter[y * filterStride + x] = q;
+            coefficientsSum += q;
+            if (maxAbs > 0.0)
+                quantizationError = std::max(quantizationError,
+                                             std::fabs(value - q / scale) / maxAbs);
+        }
+    }
+    offsetCorrection = (int64_t) pixelOffset * coefficientsSum;
+}
+
+void IntegerCorrelator::correlate(const uint8_t * const image,
+                                  const size_t imageStride,
+                                  const unsigned int windowWidth,
+                                  const unsigned int windowHeight,
+                                  double * const output)
+{
+    // Computes the windowWidth x windowHeight correlation map of the image
+    // region whose top-left pixel is pointed by image, and whose size is that
+    // of the window enlarged by the filter footprint.
+    row.resize(windowWidth);
+    for (unsigned int j = 0; j < windowHeight; j++)
+    {
+        kernels::integerCorrelationRow8(image + j * imageStride, imageStride,
+                                        quantizedFilter.data(),
+                                        filterWidth, filterStride, filterHeight,
+                                        windowWidth, row.data());
+        for (unsigned int i = 0; i < windowWidth; i++)
+            output[j * windowWidth + i] = (double) row[i] / scale;
+    }
+}
+
+void IntegerCorrelator::correlate(const uint16_t * const image,
+                                  const size_t imageStride,
+                                  const unsigned int windowWidth,
+                                  const unsigned int windowHeight,
+                                  double * const output)
+{
+    row.resize(windowWidth);
+    for (unsigned int j = 0; j < windowHeight; j++)
+    {
+        kernels::integerCorrelationRow16(image + j * imageStride, imageStride,
+                                         pixelOffset, quantizedFilter.data(),
+                                         filterWidth, filterStride, filterHeight,
+                                         windowWidth, row.data());
+        for (unsigned int i = 0; i < windowWidth; i++)
+            output[j * windowWidth + i] = (double) (row[i] + offsetCorrection) / scale;
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "corrfilter.h"
+#include "movie/movie.h"
+
+
+// Computes correlation maps directly on the 8 or 16-bit frame data.
+//
+// The filter is quantized to int16, with the largest scale for which the
+// integer kernels cannot overflow given the size of the pixel samples.  The
+// declared bit depth of the movie is not used, as nothing keeps the pixels of,
+// say, a 12-bit movie stored in 16 bits below 4096.  The correlation is then exact for the quantized filter: the only difference with
+// the double path comes from the quantization, whose relative error on the
+// filter coefficients is quantizationError (at most 0.5 / (scale * max|filter|)).
+class IntegerCorrelator
+{
+private:
+    std::vector<int16_t> quantizedFilter;
+    unsigned int filterStride;
+    uint16_t pixelOffset;
+    int64_t offsetCorrection;
+    std::vector<int64_t> row;
+
+public:
+    explicit IntegerCorrelator(const CorrFilter * const filter,
+                               const Movie * const movie);
+
+    void correlate(const uint8_t * const image, const size_t imageStride,
+                   const unsigned int windowWidth, const unsigned int windowHeight,
+                   double * const output);
+    void correlate(const uint16_t * const image, const size_t imageStride,
+                   const unsigned int windowWidth, const unsigned int windowHeight,
+                   double * const output);
+
+    const unsigned int filterWidth;
+    const unsigned int filterHeight;
+    const unsigned int bitsPerSample;
+    double scale;
+    double quantizationError;
+};
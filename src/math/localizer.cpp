@@ -0,0 +1,61 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include <algorithm>
+#include <cmath>
+#include "math/localizer.h"
+
+
+Localizer::Localizer()
+    : peakValue{0.0}
+{}
+
+Localizer::~Localizer()
+{}
+
+WindowLocalizer::WindowLocalizer(const Movie * const movie)
+    : movie{movie}
+{}
+
+PointD WindowLocalizer::locate(const Point point, const size_t frameIndex,
+                               const unsigned int width,
+                               const unsigned int height)
+{
+    // The window must be inside the frame.
+    const unsigned int iMin = point.x - width / 2;
+    const unsigned int jMin = point.y - height / 2;
+    PointD position;
+    if (movie->bitsPerSample == 8)
+        position = locateInWindow(ImageView<uint8_t>(movie->frames8.at(frameIndex))
+                                  .region(iMin, jMin, width, height));
+    else
+        position = locateInWindow(ImageView<uint16_t>(movie->frames16.at(frameIndex))
+                                  .region(iMin, jMin, width, height));
+
+    // A position outside the window (possible with some localizers) has its
+    // peak on the nearest edge.
+    const double x = std::min(std::max(std::round(position.x), 0.0), width - 1.0);
+    const double y = std::min(std::max(std::round(position.y), 0.0), height - 1.0);
+    peakPixel.setPos(iMin + (unsigned int) x, jMin + (unsigned int) y);
+    return PointD(iMin + position.x, jMin + position.y);
+}
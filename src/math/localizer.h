@@ -0,0 +1,80 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include "imageview.h"
+#include "movie/movie.h"
+#include "point.h"
+#include "pointd.h"
+
+
+// Finds a particle in a window of a frame.
+//
+// CorrTrackAnalyser chooses the windows (their centres, and their sizes with
+// adaptive windows), checks that they are inside the frames with the margin
+// that the localizer reads around them, and writes the positions found,
+// whatever the localizer.  Each worker thread has its own localizer, which
+// can keep scratch buffers.
+class Localizer
+{
+public:
+    Localizer();
+    virtual ~Localizer();
+
+    // Position, in frame pixels, of the particle in the window of width x
+    // height pixels centred on point in the given frame.  Also sets
+    // peakPixel, the pixel of the frame nearest to the position, and
+    // peakValue, the strength of the particle there, that adaptive windows
+    // compare between frames.
+    virtual PointD locate(const Point point, const size_t frameIndex,
+                          const unsigned int width,
+                          const unsigned int height) =0;
+
+    Point peakPixel;
+    double peakValue;
+};
+
+
+// Localizer that only reads the pixels of the windows.
+class WindowLocalizer : public Localizer
+{
+private:
+    const Movie * const movie;
+
+protected:
+    // Position of the particle in window, relative to its top-left pixel.
+    // Sets peakValue.
+    virtual PointD locateInWindow(const ImageView<uint8_t> &window) =0;
+    virtual PointD locateInWindow(const ImageView<uint16_t> &window) =0;
+
+public:
+    explicit WindowLocalizer(const Movie * const movie);
+
+    PointD locate(const Point point, const size_t frameIndex,
+                  const unsigned int width,
+                  const unsigned int height) override;
+};
@@ -0,0 +1,94 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "math/motionpredictor.h"
+
+
+// In pixels per step^2, pixels, and pixels per step
+const double MotionPredictor::ACCELERATION_NOISE = 0.5;
+const double MotionPredictor::MEASUREMENT_NOISE = 0.1;
+const double MotionPredictor::INITIAL_VELOCITY_NOISE = 2.0;
+
+MotionPredictor::MotionPredictor()
+    : MotionPredictor(Model::None, PointD(0.0, 0.0))
+{}
+
+MotionPredictor::MotionPredictor(const Model model, const PointD position,
+                                 const PointD velocity)
+    : model{model},
+      xAxis{position.x, velocity.x, MEASUREMENT_NOISE * MEASUREMENT_NOISE,
+            0.0, INITIAL_VELOCITY_NOISE * INITIAL_VELOCITY_NOISE},
+      yAxis{position.y, velocity.y, MEASUREMENT_NOISE * MEASUREMENT_NOISE,
+            0.0, INITIAL_VELOCITY_NOISE * INITIAL_VELOCITY_NOISE}
+{}
+
+PointD MotionPredictor::predict() const
+{
+    // Position at the next step
+    if (model == Model::None)
+        return PointD(xAxis.position, yAxis.position);
+    return PointD(xAxis.position + xAxis.velocity,
+                  yAxis.position + yAxis.velocity);
+}
+
+void MotionPredictor::update(const PointD measured)
+{
+    // Moves to the next step, where the particle was found at measured.
+    switch (model)
+    {
+    case Model::None:
+        xAxis.position = measured.x;
+        yAxis.position = measured.y;
+        break;
+    case Model::ConstantVelocity:
+        xAxis.velocity = measured.x - xAxis.position;
+        yAxis.velocity = measured.y - yAxis.position;
+        xAxis.position = measured.x;
+        yAxis.position = measured.y;
+        break;
+    case Model::Kalman:
+        updateAxis(xAxis, measured.x);
+        updateAxis(yAxis, measured.y);
+        break;
+    }
+}
+
+void MotionPredictor::updateAxis(Axis &axis, const double measured) const
+{
+    // Prediction, with the process noise of a random acceleration a over the
+    // step (position a / 2, velocity a)
+    const double q = ACCELERATION_NOISE * ACCELERATION_NOISE;
+    const double pp = axis.pp + 2.0 * axis.pv + axis.vv + q / 4.0;
+    const double pv = axis.pv + axis.vv + q / 2.0;
+    const double vv = axis.vv + q;
+    const double position = axis.position + axis.velocity;
+
+    // Correction by the measured position
+    const double s = pp + MEASUREMENT_NOISE * MEASUREMENT_NOISE;
+    const double kp = pp / s;
+    const double kv = pv / s;
+    const double residual = measured - position;
+    axis.position = position + kp * residual;
+    axis.velocity += kv * residual;
+    axis.pp = (1.0 - kp) * pp;
+    axis.pv = (1.0 - kp) * pv;
+    axis.vv = vv - kv * pv;
+}
@@ -0,0 +1,72 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include "math/pointd.h"
+
+
+// Prediction of the position of a particle in the next frame from its past
+// positions, used to centre the correlation window.  The steps are frames in
+// either direction of time.
+//
+// - None: the next position is the last one.
+// - ConstantVelocity: the last displacement is repeated.
+// - Kalman: constant velocity model with random accelerations, filtered
+//   independently along x and y.  The measurement noise accounts for the
+//   sub-pixel accuracy of the correlation, so that the velocity is
+//   smoothed over a few frames.
+class MotionPredictor
+{
+public:
+    enum class Model {None, ConstantVelocity, Kalman};
+
+private:
+    // Kalman state along one axis, with its covariance matrix
+    struct Axis
+    {
+        double position;
+        double velocity;
+        double pp;
+        double pv;
+        double vv;
+    };
+
+    void updateAxis(Axis &axis, const double measured) const;
+
+    Model model;
+    Axis xAxis;
+    Axis yAxis;
+
+public:
+    MotionPredictor();
+    explicit MotionPredictor(const Model model, const PointD position,
+                             const PointD velocity = PointD(0.0, 0.0));
+
+    PointD predict() const;
+    void update(const PointD measured);
+
+    // Standard deviations of the Kalman filter
+    static const double ACCELERATION_NOISE;
+    static const double MEASUREMENT_NOISE;
+    static const double INITIAL_VELOCITY_NOISE;
+};
@@ -0,0 +1,132 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_linalg.h>
+#include <gsl/gsl_machine.h>
+#include "math/quadraticfit.h"
+
+
+QuadraticFit::QuadraticFit(const double fitRadius)
+    : radius{fitRadius < 65536.0 ? (unsigned int) fitRadius : 65536u},
+      fitRadius{fitRadius}
+{}
+
+const QuadraticFit::Pattern& QuadraticFit::getPattern(const PatternKey &key)
+{
+    // Returns the cached pattern, after building it if needed.
+
+    std::map<PatternKey, Pattern>::const_iterator it = patterns.find(key);
+    if (it != patterns.end())
+        return it->second;
+
+    Pattern &pattern = patterns[key];
+    const double fitRadius2 = fitRadius * fitRadius;
+    for (int x = -(int) key[0]; x <= (int) key[1]; x++)
+    {
+        for (int y = -(int) key[2]; y <= (int) key[3]; y++)
+        {
+            if ((double) (x * x + y * y) <= fitRadius2)
+            {
+                pattern.dx.push_back(x);
+                pattern.dy.push_back(y);
+            }
+        }
+    }
+
+    const size_t n = pattern.dx.size();
+    if (n < N_COEFFS)
+        return pattern;
+
+    // Pseudo-inverse V S^-1 U^T from the SVD X = U S V^T of the design
+    // matrix.  As in gsl_multifit_linear, negligible singular values are
+    // discarded.
+    gsl_matrix *U = gsl_matrix_alloc(n, N_COEFFS);
+    gsl_matrix *V = gsl_matrix_alloc(N_COEFFS, N_COEFFS);
+    gsl_vector *S = gsl_vector_alloc(N_COEFFS);
+    gsl_vector *work = gsl_vector_alloc(N_COEFFS);
+    for (size_t m = 0; m < n; m++)
+    {
+        const double x = (double) pattern.dx[m];
+        const double y = (double) pattern.dy[m];
+        gsl_matrix_set(U, m, 0, x * x);
+        gsl_matrix_set(U, m, 1, x * y);
+        gsl_matrix_set(U, m, 2, y * y);
+        gsl_matrix_set(U, m, 3, x);
+        gsl_matrix_set(U, m, 4, y);
+        gsl_matrix_set(U, m, 5, 1.0);
+    }
+    gsl_linalg_SV_decomp(U, V, S, work);
+
+    const double sMax = gsl_vector_get(S, 0);
+    pattern.pseudoInverse.assign(N_COEFFS * n, 0.0);
+    for (int l = 0; l < N_COEFFS; l++)
+    {
+        const double s = gsl_vector_get(S, l);
+        if (s <= GSL_DBL_EPSILON * sMax)
+            continue;
+        for (int k = 0; k < N_COEFFS; k++)
+        {
+            const double v = gsl_matrix_get(V, k, l) / s;
+            for (size_t m = 0; m < n; m++)
+                pattern.pseudoInverse[k * n + m] += v * gsl_matrix_get(U, m, l);
+        }
+    }
+
+    gsl_matrix_free(U);
+    gsl_matrix_free(V);
+    gsl_vector_free(S);
+    gsl_vector_free(work);
+
+    return pattern;
+}
+
+size_t QuadraticFit::fit(const double * const map,
+                         const unsigned int width, const unsigned int height,
+                         const unsigned int i0, const unsigned int j0,
+                         double * const coeffs)
+{
+    // Fits the map (of size width x height) around (i0, j0) and sets the
+    // N_COEFFS coefficients.  Returns the number of fitted pixels.  If it is
+    // lower than N_COEFFS, the coefficients are not set.
+
+    const PatternKey key = {{std::min(i0, radius),
+                             std::min(width - 1 - i0, radius),
+                             std::min(j0, radius),
+                             std::min(height - 1 - j0, radius)}};
+    const Pattern &pattern = getPattern(key);
+
+    const size_t n = pattern.dx.size();
+    if (n < N_COEFFS)
+        return n;
+
+    for (int k = 0; k < N_COEFFS; k++)
+        coeffs[k] = 0.0;
+    for (size_t m = 0; m < n; m++)
+    {
+        const double z = map[(j0 + pattern.dy[m]) * width + i0 + pattern.dx[m]];
+        for (int k = 0; k < N_COEFFS; k++)
+            coeffs[k] += pattern.pseudoInverse[k * n + m] * z;
+    }
+    return n;
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <array>
+#include <map>
+#include <vector>
+
+
+// Least-squares fit of a paraboloid around a pixel (i0, j0) of a map:
+//
+//   z = c0 x^2 + c1 x y + c2 y^2 + c3 x + c4 y + c5,   x = i - i0, y = j - j0,
+//
+// using the pixels within fitRadius of the central pixel.
+//
+// The design matrix only depends on fitRadius and on how the disk of radius
+// fitRadius is clipped by the map edges.  Its pseudo-inverse is computed (by
+// SVD) once per clipping pattern and cached, so that each fit is a small
+// matrix-vector product without any memory allocation.
+class QuadraticFit
+{
+private:
+    struct Pattern
+    {
+        std::vector<int> dx;
+        std::vector<int> dy;
+        // N_COEFFS x n pseudo-inverse of the design matrix, row-major
+        std::vector<double> pseudoInverse;
+    };
+
+    // Available extent around the central pixel (left, right, top, bottom),
+    // clipped to the fit radius.
+    typedef std::array<unsigned int, 4> PatternKey;
+
+    std::map<PatternKey, Pattern> patterns;
+    unsigned int radius;
+
+    const Pattern& getPattern(const PatternKey &key);
+
+public:
+    explicit QuadraticFit(const double fitRadius);
+
+    size_t fit(const double * const map,
+               const unsigned int width, const unsigned int height,
+               const unsigned int i0, const unsigned int j0,
+               double * const coeffs);
+
+    static const int N_COEFFS = 6;
+    const double fitRadius;
+};
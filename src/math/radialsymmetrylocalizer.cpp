@@ -0,0 +1,172 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include <algorithm>
+#include <cmath>
+#include "math/correlationkernels.h"
+#include "math/radialsymmetrylocalizer.h"
+
+
+namespace
+{
+    // Smallest distance of a corner to the centroid of the squared gradients
+    // in the weights, in pixels, so that the corners near the centroid do
+    // not dominate the fit.
+    const float MIN_CENTROID_DISTANCE = 0.5f;
+}
+
+
+RadialSymmetryLocalizer::RadialSymmetryLocalizer(const Movie * const movie)
+    : WindowLocalizer(movie)
+{}
+
+PointD RadialSymmetryLocalizer::locateInWindow(const ImageView<uint8_t> &window)
+{
+    return centre(window);
+}
+
+PointD RadialSymmetryLocalizer::locateInWindow(const ImageView<uint16_t> &window)
+{
+    return centre(window);
+}
+
+void RadialSymmetryLocalizer::smooth(const std::vector<float> &gradient,
+                                     const unsigned int width,
+                                     const unsigned int height,
+                                     std::vector<float> &smoothed)
+{
+    // Means over 3 x 3 values of gradient (width x height), for the
+    // (width - 2) x (height - 2) values whose neighbourhood is complete
+    const unsigned int smoothedWidth = width - 2;
+    const unsigned int smoothedHeight = height - 2;
+    rowSums.resize((size_t) smoothedWidth * height);
+    for (unsigned int j = 0; j < height; j++)
+    {
+        const float * const row = gradient.data() + (size_t) j * width;
+        float * const sums = rowSums.data() + (size_t) j * smoothedWidth;
+        for (unsigned int i = 0; i < smoothedWidth; i++)
+            sums[i] = row[i] + row[i + 1] + row[i + 2];
+    }
+    smoothed.resize((size_t) smoothedWidth * smoothedHeight);
+    for (unsigned int j = 0; j < smoothedHeight; j++)
+    {
+        const float * const sums = rowSums.data() + (size_t) j * smoothedWidth;
+        float * const row = smoothed.data() + (size_t) j * smoothedWidth;
+        for (unsigned int i = 0; i < smoothedWidth; i++)
+            row[i] = (sums[i] + sums[i + smoothedWidth] + sums[i + 2 * smoothedWidth])
+                     * (1.0f / 9.0f);
+    }
+}
+
+template<typename PixelDataType>
+PointD RadialSymmetryLocalizer::centre(const ImageView<PixelDataType> &window)
+{
+    // The window centre is returned if the lines do not meet (uniform
+    // window, or too small for a smoothed gradient).
+    const unsigned int width = window.width;
+    const unsigned int height = window.height;
+    const PointD windowCentre(0.5 * (width - 1), 0.5 * (height - 1));
+    peakValue = 0.0;
+    if (width < 4 || height < 4)
+        return windowCentre;
+
+    // Gradients at the corners: corner (i, j) is at (i + 0.5, j + 0.5) in
+    // window pixels.
+    pixels.resize((size_t) width * height);
+    window.convert(pixels.data(), width);
+    const unsigned int cornersWidth = width - 1;
+    const unsigned int cornersHeight = height - 1;
+    gradientX.resize((size_t) cornersWidth * cornersHeight);
+    gradientY.resize((size_t) cornersWidth * cornersHeight);
+    for (unsigned int j = 0; j < cornersHeight; j++)
+    {
+        const float * const top = pixels.data() + (size_t) j * width;
+        const float * const bottom = top + width;
+        float * const gx = gradientX.data() + (size_t) j * cornersWidth;
+        float * const gy = gradientY.data() + (size_t) j * cornersWidth;
+        for (unsigned int i = 0; i < cornersWidth; i++)
+        {
+            gx[i] = 0.5f * (top[i + 1] - top[i] + bottom[i + 1] - bottom[i]);
+            gy[i] = 0.5f * (bottom[i] - top[i] + bottom[i + 1] - top[i + 1]);
+        }
+    }
+    smooth(gradientX, cornersWidth, cornersHeight, smoothX);
+    smooth(gradientY, cornersWidth, cornersHeight, smoothY);
+    // Smoothed corner (i, j) is at (i + 1.5, j + 1.5).
+    const unsigned int fitWidth = cornersWidth - 2;
+    const unsigned int fitHeight = cornersHeight - 2;
+
+    // Centroid of the squared gradients.  Each row is summed in float, and
+    // the rows in double.
+    double sum = 0.0;
+    double sumX = 0.0;
+    double sumY = 0.0;
+    for (unsigned int j = 0; j < fitHeight; j++)
+    {
+        const float * const gx = smoothX.data() + (size_t) j * fitWidth;
+        const float * const gy = smoothY.data() + (size_t) j * fitWidth;
+        float rowSum = 0.0f;
+        float rowSumX = 0.0f;
+        for (unsigned int i = 0; i < fitWidth; i++)
+        {
+            const float g2 = gx[i] * gx[i] + gy[i] * gy[i];
+            rowSum += g2;
+            rowSumX += g2 * (float) i;
+        }
+        sum += rowSum;
+        sumX += rowSumX;
+        sumY += (double) rowSum * j;
+    }
+    if (!(sum > 0.0))
+        return windowCentre;
+    const float centroidX = (float) (sumX / sum);
+    const float centroidY = (float) (sumY / sum);
+
+    // Normal equations of the weighted distances to the lines.  With the
+    // normal n = (gy, -gx) to the gradient at corner p, they are
+    //
+    //   sum n n^T / d  c = sum n (n . p) / d,
+    //
+    // where d is the distance of p to the centroid, summed row by row by the
+    // SIMD kernels.  The corners are taken relative to the first one.
+    double aa = 0.0, ab = 0.0, bb = 0.0, ar = 0.0, br = 0.0;
+    double sums[5];
+    for (unsigned int j = 0; j < fitHeight; j++)
+    {
+        kernels::radialSymmetryRow(smoothX.data() + (size_t) j * fitWidth,
+                                   smoothY.data() + (size_t) j * fitWidth,
+                                   fitWidth, (float) j, centroidX, centroidY,
+                                   MIN_CENTROID_DISTANCE, sums);
+        aa += sums[0];
+        ab += sums[1];
+        bb += sums[2];
+        ar += sums[3];
+        br += sums[4];
+    }
+    const double determinant = aa * bb - ab * ab;
+    if (!(determinant > 1e-12 * (aa + bb) * (aa + bb)))
+        return windowCentre;
+    peakValue = std::sqrt(sum / ((double) fitWidth * fitHeight));
+    return PointD(1.5 + (bb * ar - ab * br) / determinant,
+                  1.5 + (aa * br - ab * ar) / determinant);
+}
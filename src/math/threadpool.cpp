@@ -0,0 +1,143 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include "math/threadpool.h"
+
+
+ThreadPool::ThreadPool(const unsigned int nThreads)
+    : queues(std::max(nThreads, 1u)),
+      task{nullptr},
+      batch{0},
+      nRunning{0},
+      stopping{false},
+      cancelled{false},
+      nThreads{std::max(nThreads, 1u)}
+{
+    for (unsigned int worker = 0; worker < this->nThreads; worker++)
+        threads.push_back(std::thread(&ThreadPool::workerLoop, this, worker));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startCondition.notify_all();
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+void ThreadPool::run(const size_t nTasks, const Task &task)
+{
+    // Runs task(k, worker) for k = 0, ..., nTasks - 1, where worker is the
+    // index (smaller than nThreads) of the thread that runs it.  Blocks until
+    // all the tasks are done.
+
+    if (nTasks == 0)
+        return;
+
+    for (unsigned int worker = 0; worker < nThreads; worker++)
+    {
+        const size_t first = nTasks * worker / nThreads;
+        const size_t last = nTasks * (worker + 1) / nThreads;
+        for (size_t k = first; k < last; k++)
+            queues[worker].tasks.push_back(k);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    this->task = &task;
+    exception = nullptr;
+    cancelled = false;
+    nRunning = nThreads;
+    batch++;
+    startCondition.notify_all();
+    doneCondition.wait(lock, [this]{ return nRunning == 0; });
+    this->task = nullptr;
+
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+bool ThreadPool::popTask(const unsigned int worker, size_t &task)
+{
+    // Takes the next task of the worker's own queue, or else steals the last
+    // task of another queue.  Returns false when all the queues are empty.
+    for (unsigned int n = 0; n < nThreads; n++)
+    {
+        Queue &queue = queues[(worker + n) % nThreads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+        if (n == 0)
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        else
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(const unsigned int worker)
+{
+    size_t lastBatch = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCondition.wait(lock, [this, lastBatch]{ return stopping || batch != lastBatch; });
+            if (stopping)
+                return;
+            lastBatch = batch;
+        }
+
+        // No task is added during a batch, so that the batch is over for this
+        // worker once all the queues are empty.
+        size_t k;
+        while (popTask(worker, k))
+        {
+            if (cancelled)
+                continue;
+            try
+            {
+                (*task)(k, worker);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!exception)
+                    exception = std::current_exception();
+                cancelled = true;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--nRunning == 0)
+            doneCondition.notify_all();
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Pool of worker threads that run batches of independent tasks.
+//
+// run() splits the tasks 0, ..., nTasks - 1 into contiguous blocks, one per
+// worker queue, and returns when all of them are done.  A worker whose queue
+// is empty steals tasks from the back of the other queues, so that tasks of
+// uneven durations keep all the threads busy.  If a task throws, the tasks
+// that were not started yet are skipped and run() rethrows the first
+// exception.
+class ThreadPool
+{
+public:
+    typedef std::function<void(const size_t task,
+                               const unsigned int worker)> Task;
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    void workerLoop(const unsigned int worker);
+    bool popTask(const unsigned int worker, size_t &task);
+
+    std::vector<std::thread> threads;
+    std::vector<Queue> queues;
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable doneCondition;
+    const Task *task;
+    size_t batch;
+    unsigned int nRunning;
+    bool stopping;
+    std::exception_ptr exception;
+    std::atomic<bool> cancelled;
+
+public:
+    explicit ThreadPool(const unsigned int nThreads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) =delete;
+    ThreadPool& operator=(const ThreadPool&) =delete;
+    ThreadPool(ThreadPool&&) =delete;
+    ThreadPool& operator=(ThreadPool&&) =delete;
+
+    void run(const size_t nTasks, const Task &task);
+
+    const unsigned int nThreads;
+};
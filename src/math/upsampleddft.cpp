@@ -0,0 +1,201 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#include <algorithm>
+#include <cmath>
+#include "math/upsampleddft.h"
+
+
+namespace
+{
+    const double PI = std::acos(-1.0);
+}
+
+
+UpsampledDFT::UpsampledDFT(const unsigned int upsamplingFactor)
+    : upsamplingFactor{std::max(upsamplingFactor, 1u)}
+{
+    const unsigned int n = 2 * GRID_RADIUS + 1;
+    grid.resize(n * n);
+    axes[0].size = 0;
+    axes[1].size = 0;
+}
+
+void UpsampledDFT::Axis::setSize(const unsigned int newSize)
+{
+    // Caches what the kernels use for this size: sin(b_i) and cos(b_i),
+    // b_i = pi i / (2 size) for i <= size, and the weights
+    // sin(b_i + b_i+1) / (2 size).
+
+    if (newSize == size)
+        return;
+    size = newSize;
+    sines.resize(size + 1);
+    cosines.resize(size + 1);
+    for (unsigned int i = 0; i <= size; i++)
+    {
+        sines[i] = std::sin(PI * i / (2.0 * size));
+        cosines[i] = std::cos(PI * i / (2.0 * size));
+    }
+    weights.resize(size);
+    for (unsigned int i = 0; i < size; i++)
+        weights[i] = std::sin(PI * (2.0 * i + 1.0) / (2.0 * size)) / (2.0 * size);
+    kernels.resize((size_t) (2 * GRID_RADIUS + 1) * size);
+}
+
+void UpsampledDFT::Axis::setKernels(const double origin, const double step)
+{
+    // kernels[i * nx + p]: weight of the value i of a signal of this size
+    // in its interpolation at x = origin + p * step,
+    //
+    //   D(x - i) + D(x + i + 1),
+    //
+    // with the Dirichlet kernel of the signal extended by its mirror image,
+    // of even size n = 2 size,
+    //
+    //   D(t) = sin(pi t) cos(pi t / n) / (n sin(pi t / n))
+    //
+    // (the Nyquist frequency being split between the positive and negative
+    // frequencies, so that the interpolation is real).  With a = pi x / n,
+    // the sum of the two terms is
+    //
+    //   (-1)^i sin(pi x) weights[i] / (sin(a - b_i) sin(a + b_i+1)),
+    //
+    // so that each position only takes three trigonometric functions.  At
+    // the pixels, the kernel is 1 at the pixel and 0 elsewhere.
+
+    const unsigned int n = 2 * GRID_RADIUS + 1;
+    for (unsigned int p = 0; p < n; p++)
+    {
+        const double x = origin + p * step;
+        const double pixel = std::round(x);
+        if (std::fabs(x - pixel) < 1e-12)
+        {
+            for (unsigned int i = 0; i < size; i++)
+                kernels[(size_t) i * n + p] = (double) i == pixel ? 1.0 : 0.0;
+            continue;
+        }
+        const double sinA = std::sin(PI * x / (2.0 * size));
+        const double cosA = std::cos(PI * x / (2.0 * size));
+        double numerator = std::sin(PI * x);
+        for (unsigned int i = 0; i < size; i++)
+        {
+            const double sinDifference = sinA * cosines[i] - cosA * sines[i];
+            const double sinSum = sinA * cosines[i + 1] + cosA * sines[i + 1];
+            kernels[(size_t) i * n + p] = numerator * weights[i] / (sinDifference * sinSum);
+            numerator = -numerator;
+        }
+    }
+}
+
+void UpsampledDFT::evaluateGrid(const double * const map,
+                                const double x0, const double y0,
+                                const double step)
+{
+    // Interpolated map on the grid centred on (x0, y0) with the given step.
+
+    const unsigned int n = 2 * GRID_RADIUS + 1;
+    const Axis &axisX = axes[0];
+    const Axis &axisY = axes[1];
+    axes[0].setKernels(x0 - GRID_RADIUS * step, step);
+    axes[1].setKernels(y0 - GRID_RADIUS * step, step);
+    const unsigned int width = axisX.size;
+    const unsigned int height = axisY.size;
+
+    // The grid positions are the innermost loops, for independent sums.
+    for (unsigned int j = 0; j < height; j++)
+    {
+        const double * const row = map + (size_t) j * width;
+        double sums[n] = {};
+        for (unsigned int i = 0; i < width; i++)
+        {
+            const double * const kernel = axisX.kernels.data() + (size_t) i * n;
+            for (unsigned int p = 0; p < n; p++)
+                sums[p] += row[i] * kernel[p];
+        }
+        std::copy(sums, sums + n, product.begin() + (size_t) j * n);
+    }
+    double values[n * n] = {};
+    for (unsigned int j = 0; j < height; j++)
+    {
+        const double * const kernel = axisY.kernels.data() + (size_t) j * n;
+        const double * const productRow = product.data() + (size_t) j * n;
+        for (unsigned int q = 0; q < n; q++)
+            for (unsigned int p = 0; p < n; p++)
+                values[q * n + p] += kernel[q] * productRow[p];
+    }
+    std::copy(values, values + n * n, grid.begin());
+}
+
+PointD UpsampledDFT::refine(const double * const map,
+                            const unsigned int mapWidth,
+                            const unsigned int mapHeight,
+                            const unsigned int i0, const unsigned int j0)
+{
+    // Position of the peak of the interpolated map (of size mapWidth x
+    // mapHeight), whose maximum pixel is (i0, j0).
+
+    const unsigned int n = 2 * GRID_RADIUS + 1;
+    axes[0].setSize(mapWidth);
+    axes[1].setSize(mapHeight);
+    product.resize((size_t) mapHeight * n);
+    const double finalStep = 1.0 / upsamplingFactor;
+    double x0 = i0;
+    double y0 = j0;
+    double step = std::max(0.5, finalStep);
+    unsigned int nFinalStages = 0;
+    while (true)
+    {
+        evaluateGrid(map, x0, y0, step);
+        const unsigned int k = (unsigned int) std::distance(grid.begin(),
+                                                            std::max_element(grid.begin(),
+                                                                             grid.end()));
+        const unsigned int q = k / n;
+        const unsigned int p = k - q * n;
+        x0 += ((double) p - GRID_RADIUS) * step;
+        y0 += ((double) q - GRID_RADIUS) * step;
+        const bool isInside = p > 0 && p + 1 < n && q > 0 && q + 1 < n;
+        // At the final step, a maximum on the edge of the grid is searched
+        // again in a grid centred on it, a few times at most.
+        if (step <= finalStep
+                && (isInside || ++nFinalStages > MAX_FINAL_STAGES))
+        {
+            // Parabolic interpolation of the last grid around its maximum
+            const double * const peak = grid.data() + k;
+            if (p > 0 && p + 1 < n)
+            {
+                const double curvature = peak[-1] - 2.0 * peak[0] + peak[1];
+                if (curvature < 0.0)
+                    x0 += 0.5 * step * (peak[-1] - peak[1]) / curvature;
+            }
+            if (q > 0 && q + 1 < n)
+            {
+                const double curvature = *(peak - n) - 2.0 * peak[0] + peak[n];
+                if (curvature < 0.0)
+                    y0 += 0.5 * step * (*(peak - n) - peak[n]) / curvature;
+            }
+            return PointD(x0, y0);
+        }
+        step = std::max(step / (2 * GRID_RADIUS), finalStep);
+    }
+}
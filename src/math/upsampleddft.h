@@ -0,0 +1,93 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+#pragma once
+
+
+#include <vector>
+#include "pointd.h"
+
+
+// Sub-pixel position of the peak of a correlation map, from its upsampled
+// discrete Fourier transform (Guizar-Sicairos, Thurman and Fienup, Opt.
+// Lett. 33, 156, 2008).
+//
+// The band-limited interpolation of the map at any position (x, y) is the
+// inverse DFT of its spectrum evaluated there.  As a correlation map is not
+// periodic, it is extended by its mirror images (which makes it continuous,
+// the interpolation of a DCT), so that the edges of the map do not ring
+// into the peak.  The interpolation is then a sum of the map values
+// weighted by kernels K_w(x, i) K_h(y, j), and its values on a grid of
+// nx x ny positions are the matrix product
+//
+//   Ky M Kx^T,   Kx[p][i] = K_w(x_p, i),   Ky[q][j] = K_h(y_q, j),
+//
+// which costs w h nx + h ny nx products without computing the spectrum.
+// Instead of upsampling a whole neighbourhood of the peak, whose cost would
+// grow with the upsampling factor, a grid of a fixed size is evaluated around
+// the current estimate, starting from the maximum pixel with a step of half a
+// pixel.  The step is divided by the grid radius times 2 at each stage, down
+// to 1 / upsamplingFactor, and the maximum of the last grid, once inside it,
+// is refined by parabolic interpolation.  Each stage has the same cost, and
+// the number of stages grows with the logarithm of the factor (4 for a
+// factor of 100).
+class UpsampledDFT
+{
+private:
+    // Interpolation kernels along x or y, for a map dimension of size
+    struct Axis
+    {
+        void setSize(const unsigned int newSize);
+        void setKernels(const double origin, const double step);
+
+        unsigned int size;
+        std::vector<double> sines;
+        std::vector<double> cosines;
+        std::vector<double> weights;
+        // kernels[i * nx + p] for the nx = 2 * GRID_RADIUS + 1 grid positions
+        std::vector<double> kernels;
+    };
+
+    Axis axes[2];
+    // Product of the map with the kernels along x (height x nx), and values
+    // of the grid (ny x nx)
+    std::vector<double> product;
+    std::vector<double> grid;
+
+    void evaluateGrid(const double * const map,
+                      const double x0, const double y0, const double step);
+
+public:
+    explicit UpsampledDFT(const unsigned int upsamplingFactor);
+
+    PointD refine(const double * const map,
+                  const unsigned int mapWidth, const unsigned int mapHeight,
+                  const unsigned int i0, const unsigned int j0);
+
+    // Number of grid positions on each side of the estimate
+    static const unsigned int GRID_RADIUS = 2;
+    // Number of grids evaluated at the final step after the first one, when
+    // the maximum is on their edge
+    static const unsigned int MAX_FINAL_STAGES = 4;
+    const unsigned int upsamplingFactor;
+};
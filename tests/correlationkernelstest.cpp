@@ -0,0 +1,115 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <vector>
+#include "tests.h"
+#include "math/correlationkernels.h"
+
+
+namespace
+{
+    // Filter widths below, inside and above the specialized ones
+    const unsigned int FILTER_WIDTHS[] = {3, 5, 7, 9, 11, 13, 15, 17, 21};
+
+    // Numbers of outputs that are not all multiples of the vector widths
+    const unsigned int N_OUTPUTS[] = {1, 3, 7, 13, 16, 37};
+
+    int compareWithScalar(const kernels::InstructionSet instructionSet,
+                          const bool isSpecialized,
+                          const unsigned int filterWidth,
+                          const unsigned int filterHeight,
+                          const unsigned int nOutputs,
+                          std::mt19937 &generator)
+    {
+        // Correlates random values of both signs with the given kernel and
+        // the generic scalar one.  The results must be equal for the scalar
+        // and SSE2 kernels, and within the bound of the fused multiply-adds
+        // for the others.
+        const kernels::CorrelationRowKernel kernel
+            = isSpecialized ? kernels::correlationRowKernel(instructionSet, filterWidth)
+                            : kernels::correlationRowKernel(instructionSet);
+        const kernels::CorrelationRowKernel scalarKernel
+            = kernels::correlationRowKernel(kernels::InstructionSet::Scalar);
+        // Padding at the end of the image rows, not read by the kernels
+        const size_t imageStride = nOutputs + filterWidth - 1 + 3;
+        std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+        std::vector<double> image(imageStride * filterHeight);
+        for (double &value : image)
+            value = distribution(generator);
+        std::vector<double> filter((size_t) filterWidth * filterHeight);
+        for (double &value : filter)
+            value = distribution(generator);
+
+        std::vector<double> output(nOutputs);
+        std::vector<double> reference(nOutputs);
+        kernel(image.data(), imageStride, filter.data(), filterWidth, filterHeight,
+               nOutputs, output.data());
+        scalarKernel(image.data(), imageStride, filter.data(), filterWidth, filterHeight,
+                     nOutputs, reference.data());
+
+        const bool isExact = instructionSet == kernels::InstructionSet::Scalar
+                             || instructionSet == kernels::InstructionSet::SSE2;
+        size_t nAboveBound = 0;
+        for (unsigned int i = 0; i < nOutputs; i++)
+        {
+            double absoluteSum = 0.0;
+            for (unsigned int y = 0; y < filterHeight; y++)
+                for (unsigned int x = 0; x < filterWidth; x++)
+                    absoluteSum += std::fabs(image[y * imageStride + i + x]
+                                             * filter[y * filterWidth + x]);
+            const double bound = isExact ? 0.0
+                                         : filterWidth * filterHeight
+                                           * std::ldexp(1.0, -52) * absoluteSum;
+            if (std::fabs(output[i] - reference[i]) > bound)
+                nAboveBound++;
+        }
+        std::ostringstream description;
+        description << kernels::instructionSetName(instructionSet)
+                    << (isSpecialized ? " specialized" : " generic") << " row kernel, filter "
+                    << filterWidth << " x " << filterHeight << ", " << nOutputs
+                    << " outputs: " << nAboveBound << " values differ from the scalar kernel";
+        return check(nAboveBound == 0, description.str());
+    }
+}
+
+
+int testCorrelationKernels()
+{
+    // Compares the row kernels of each instruction set supported by the CPU,
+    // generic and specialized for the filter width, with the generic scalar
+    // kernel.
+    std::mt19937 generator(1);
+    int nFailed = 0;
+    for (int set = 0; set <= (int) kernels::instructionSet; set++)
+        for (const bool isSpecialized : {false, true})
+            for (const unsigned int filterWidth : FILTER_WIDTHS)
+                for (const unsigned int filterHeight : {filterWidth, filterWidth - 2})
+                    for (const unsigned int nOutputs : N_OUTPUTS)
+                        nFailed += compareWithScalar((kernels::InstructionSet) set,
+                                                     isSpecialized,
+                                                     filterWidth, filterHeight, nOutputs,
+                                                     generator);
+    return nFailed;
+}
@@ -0,0 +1,144 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "tests.h"
+#include "math/corrfilter.h"
+#include "math/correlationkernels.h"
+#include "math/integercorrelator.h"
+#include "movie/movie.h"
+
+
+namespace
+{
+    template<typename PixelDataType>
+    int compareWithDouble(const unsigned int bitDepth,
+                          const unsigned int pixelsBitDepth)
+    {
+        // Correlates random pixels of pixelsBitDepth bits, and a band of
+        // pixels at the maximum value, with the integer and double paths, for
+        // a movie declared with bitDepth bits.  The difference must be within
+        // the bound set by the quantization of the filter, 0.5 / scale per
+        // coefficient, times the sum of the pixels under the filter.
+        const unsigned int filterWidth = 9;
+        const unsigned int filterHeight = 9;
+        const unsigned int imageWidth = 48;
+        const unsigned int imageHeight = 40;
+        const unsigned int mapWidth = imageWidth - filterWidth + 1;
+        const unsigned int mapHeight = imageHeight - filterHeight + 1;
+        const uint32_t maxPixel = ((uint32_t) 1 << pixelsBitDepth) - 1;
+
+        // Gaussian spot on a negative background, so that the quantized
+        // coefficients have both signs
+        std::vector<double> filterValues((size_t) filterWidth * filterHeight);
+        for (unsigned int y = 0; y < filterHeight; y++)
+        {
+            for (unsigned int x = 0; x < filterWidth; x++)
+            {
+                const double dx = (double) x - 4.0;
+                const double dy = (double) y - 4.0;
+                filterValues[y * filterWidth + x] = std::exp(-(dx * dx + dy * dy) / 6.0) - 0.3;
+            }
+        }
+        CorrFilter filter;
+        const std::string filterFile = writeFilterFile(filterValues, filterWidth, filterHeight);
+        filter.setFilter(filterFile);
+        boost::filesystem::remove(filterFile);
+
+        std::mt19937 generator(pixelsBitDepth);
+        std::uniform_int_distribution<uint32_t> distribution(0, maxPixel);
+        std::vector<PixelDataType> image((size_t) imageWidth * imageHeight);
+        for (unsigned int j = 0; j < imageHeight; j++)
+            for (unsigned int i = 0; i < imageWidth; i++)
+                image[j * imageWidth + i] = (PixelDataType) (j < filterHeight ? maxPixel
+                                                                                : distribution(generator));
+
+        Movie movie;
+        movie.bitsPerSample = 8 * sizeof(PixelDataType);
+        movie.bitDepth = bitDepth;
+        IntegerCorrelator correlator(&filter, &movie);
+        std::vector<double> map((size_t) mapWidth * mapHeight);
+        correlator.correlate(image.data(), imageWidth, mapWidth, mapHeight, map.data());
+
+        const std::vector<double> pixels(image.begin(), image.end());
+        std::vector<double> reference((size_t) mapWidth * mapHeight);
+        for (unsigned int j = 0; j < mapHeight; j++)
+            kernels::correlationRow(pixels.data() + (size_t) j * imageWidth, imageWidth,
+                                    filter.filter, filterWidth, filterHeight,
+                                    mapWidth, reference.data() + (size_t) j * mapWidth);
+
+        size_t nAboveBound = 0;
+        double maxDifference = 0.0;
+        double maxValue = 0.0;
+        for (unsigned int j = 0; j < mapHeight; j++)
+        {
+            for (unsigned int i = 0; i < mapWidth; i++)
+            {
+                double pixelsSum = 0.0;
+                for (unsigned int y = 0; y < filterHeight; y++)
+                    for (unsigned int x = 0; x < filterWidth; x++)
+                        pixelsSum += pixels[(j + y) * imageWidth + i + x];
+                const double bound = 0.5 / correlator.scale * pixelsSum * (1.0 + 1e-9);
+                const double difference = std::fabs(map[j * mapWidth + i] - reference[j * mapWidth + i]);
+                maxDifference = std::max(maxDifference, difference);
+                maxValue = std::max(maxValue, std::fabs(reference[j * mapWidth + i]));
+                if (difference > bound)
+                    nAboveBound++;
+            }
+        }
+        int nFailed = 0;
+        std::ostringstream boundDescription;
+        boundDescription << bitDepth << "-bit integer correlation of "
+                         << pixelsBitDepth << "-bit pixels: " << nAboveBound
+                         << " values above the quantization bound";
+        nFailed += check(nAboveBound == 0, boundDescription.str());
+        std::ostringstream description;
+        description << bitDepth << "-bit integer correlation of "
+                    << pixelsBitDepth << "-bit pixels: relative difference "
+                    << maxDifference / maxValue << " above 1e-3";
+        nFailed += check(maxDifference <= 1e-3 * maxValue, description.str());
+        return nFailed;
+    }
+}
+
+
+int testIntegerCorrelator()
+{
+    // The 16-bit pixels above 32767 are shifted by the kernels, so that the
+    // maximum band checks the offset correction.  The pixels of a 12-bit
+    // movie may still use the 16 bits of the samples.
+    int nFailed = 0;
+    nFailed += compareWithDouble<uint8_t>(8, 8);
+    nFailed += compareWithDouble<uint16_t>(12, 12);
+    nFailed += compareWithDouble<uint16_t>(12, 16);
+    nFailed += compareWithDouble<uint16_t>(16, 16);
+    return nFailed;
+}
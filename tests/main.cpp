@@ -0,0 +1,76 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <boost/filesystem.hpp>
+#include "tests.h"
+
+
+int check(const bool condition, const std::string &description)
+{
+    if (condition)
+        return 0;
+    std::printf("FAILED: %s\n", description.c_str());
+    return 1;
+}
+
+std::string writeFilterFile(const std::vector<double> &filter,
+                            const unsigned int width,
+                            const unsigned int height)
+{
+    const boost::filesystem::path path = boost::filesystem::temp_directory_path()
+                                         / boost::filesystem::unique_path("corrtrack-%%%%-%%%%.dat");
+    std::ofstream file(path.string());
+    file << std::setprecision(17);
+    for (unsigned int y = 0; y < height; y++)
+    {
+        for (unsigned int x = 0; x < width; x++)
+        {
+            file << filter[y * width + x];
+            if (x + 1 < width)
+                file << "\t";
+        }
+        file << "\n";
+    }
+    return path.string();
+}
+
+int main()
+{
+    int nFailed = 0;
+    nFailed += testCorrelationKernels();
+    nFailed += testIntegerCorrelator();
+    nFailed += testSinglePrecision();
+
+    if (nFailed > 0)
+    {
+        std::printf("%d check(s) failed\n", nFailed);
+        return 1;
+    }
+    std::printf("All tests passed\n");
+    return 0;
+}
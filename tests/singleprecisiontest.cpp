@@ -0,0 +1,165 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "tests.h"
+#include "math/corrtrackanalyser.h"
+
+
+namespace
+{
+    const unsigned int MOVIE_WIDTH = 120;
+    const unsigned int MOVIE_HEIGHT = 80;
+    const size_t N_FRAMES = 40;
+    const unsigned int N_PARTICLES = 3;
+
+    PointD particlePosition(const unsigned int p, const size_t f)
+    {
+        return PointD(25.0 + 35.0 * p + 4.0 * std::sin(0.1 * f + p),
+                      40.0 + 3.0 * std::cos(0.13 * f + p));
+    }
+
+    std::vector<PointD> track(const std::string &filterFile, const bool singlePrecision,
+                              std::string &header)
+    {
+        // Positions of the particles in each frame, tracked in the given
+        // precision by the direct correlation, and the header of the output
+        // file.  The analyser is not deleted, as its destructor frees the
+        // filter data twice.
+        CorrTrackAnalyser *analyser = new CorrTrackAnalyser();
+        const boost::filesystem::path path = boost::filesystem::temp_directory_path()
+                                             / boost::filesystem::unique_path("corrtrack-%%%%-%%%%");
+        Movie *movie = analyser->movie;
+        movie->fileName = path.string() + ".avi";
+        movie->bitsPerSample = 8;
+        movie->bitDepth = 8;
+        movie->width = MOVIE_WIDTH;
+        movie->height = MOVIE_HEIGHT;
+        movie->nFrames = N_FRAMES;
+        movie->frames8 = std::vector<Frame<uint8_t>>(N_FRAMES);
+        std::vector<uint8_t> pixels((size_t) MOVIE_WIDTH * MOVIE_HEIGHT);
+        for (size_t f = 0; f < N_FRAMES; f++)
+        {
+            for (unsigned int j = 0; j < MOVIE_HEIGHT; j++)
+            {
+                for (unsigned int i = 0; i < MOVIE_WIDTH; i++)
+                {
+                    // Gaussian spots on a textured background
+                    double value = 10.0 + 0.3 * ((i * 7 + j * 13 + f * 5) % 11);
+                    for (unsigned int p = 0; p < N_PARTICLES; p++)
+                    {
+                        const PointD position = particlePosition(p, f);
+                        const double dx = i - position.x;
+                        const double dy = j - position.y;
+                        value += 200.0 * std::exp(-(dx * dx + dy * dy) / 6.0);
+                    }
+                    pixels[j * MOVIE_WIDTH + i] = (uint8_t) std::min(value, 255.0);
+                }
+            }
+            movie->frames8[f].load(pixels.data(), MOVIE_WIDTH, MOVIE_HEIGHT, f);
+            movie->timestamps.push_back(f);
+        }
+
+        analyser->filter->setFilter(filterFile);
+        for (unsigned int p = 0; p < N_PARTICLES; p++)
+        {
+            const PointD position = particlePosition(p, 0);
+            analyser->addPoint(Point((unsigned int) (position.x + 0.5),
+                                     (unsigned int) (position.y + 0.5)));
+        }
+        analyser->correlationMethod = CorrTrackAnalyser::CorrelationMethod::Direct;
+        analyser->singlePrecision = singlePrecision;
+        analyser->selectImage(0);
+        analyser->analyse();
+
+        std::vector<PointD> positions;
+        const std::string outputFile = path.string() + ".dat";
+        std::ifstream file(outputFile);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                header += line + "\n";
+                continue;
+            }
+            std::istringstream values(line);
+            size_t frame;
+            double timestamp;
+            values >> frame >> timestamp;
+            for (unsigned int p = 0; p < N_PARTICLES; p++)
+            {
+                double x, y;
+                values >> x >> y;
+                positions.push_back(PointD(x, y));
+            }
+        }
+        file.close();
+        boost::filesystem::remove(outputFile);
+        return positions;
+    }
+}
+
+
+int testSinglePrecision()
+{
+    // Tracks the same movie with the direct correlation in double and single
+    // precision.  The positions must agree within 1e-3 pixel.
+    const unsigned int filterSize = 9;
+    std::vector<double> filterValues((size_t) filterSize * filterSize);
+    for (unsigned int y = 0; y < filterSize; y++)
+    {
+        for (unsigned int x = 0; x < filterSize; x++)
+        {
+            const double dx = (double) x - 4.0;
+            const double dy = (double) y - 4.0;
+            filterValues[y * filterSize + x] = std::exp(-(dx * dx + dy * dy) / 6.0);
+        }
+    }
+    const std::string filterFile = writeFilterFile(filterValues, filterSize, filterSize);
+    std::string doubleHeader;
+    std::string singleHeader;
+    const std::vector<PointD> doublePositions = track(filterFile, false, doubleHeader);
+    const std::vector<PointD> singlePositions = track(filterFile, true, singleHeader);
+    boost::filesystem::remove(filterFile);
+
+    int nFailed = 0;
+    nFailed += check(singleHeader.find("single precision") != std::string::npos,
+                     "single precision: not used by the analyser");
+    nFailed += check(doublePositions.size() == N_FRAMES * N_PARTICLES
+                     && singlePositions.size() == doublePositions.size(),
+                     "single precision: not all the frames tracked");
+    double maxDifference = 0.0;
+    for (size_t i = 0; i < std::min(doublePositions.size(), singlePositions.size()); i++)
+        maxDifference = std::max(maxDifference,
+                                 std::hypot(singlePositions[i].x - doublePositions[i].x,
+                                            singlePositions[i].y - doublePositions[i].y));
+    std::ostringstream description;
+    description << "single precision: positions differ by up to " << maxDifference << " pixel";
+    nFailed += check(maxDifference <= 1e-3, description.str());
+    return nFailed;
+}
@@ -0,0 +1,46 @@
+/*
+ * This file is part of the particle tracking software CorrTrack.
+ *
+ * Copyright 2019 Nicolas Bruot and CNRS
+ *
+ *
+ * CorrTrack is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CorrTrack is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+
+
+
+#pragma once
+
+
+#include <string>
+#include <vector>
+
+
+// Each test prints its failed checks and returns their number.
+int testCorrelationKernels();
+int testIntegerCorrelator();
+int testSinglePrecision();
+
+// Returns 0 if condition is true, and otherwise prints description and
+// returns 1.
+int check(const bool condition, const std::string &description);
+
+// Writes filter (width x height values, row by row) to a temporary file in
+// the format read by CorrFilter::setFilter(), and returns its path.
+std::string writeFilterFile(const std::vector<double> &filter,
+                            const unsigned int width,
+                            const unsigned int height);
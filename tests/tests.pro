@@ -0,0 +1,43 @@
+# This file is part of the particle tracking software CorrTrack.
+#
+# Copyright 2019 Nicolas Bruot and CNRS
+#
+#
+# CorrTrack is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# CorrTrack is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with CorrTrack.  If not, see <http://www.gnu.org/licenses/>.
+
+
+# Tests of the computation code.  Build and run them with
+#
+#   qmake tests.pro && make check
+#
+# The program prints the failed checks and exits with a non-zero status if
+# there are any.
+
+
+TEMPLATE = app
+TARGET = corrtrack_tests
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+include(../corrtrack.pri)
+
+SOURCES += \
+    main.cpp \
+    correlationkernelstest.cpp \
+    integercorrelatortest.cpp \
+    singleprecisiontest.cpp
+
+HEADERS += \
+    tests.h